@@ -24,11 +24,30 @@ void oneStep(int dir, int& xCoord, int& yCoord)
 
 //ACTOR
 Actor::Actor(StudentWorld* world, int startX, int startY, int imageID)
-: GraphObject(imageID, startX, startY, none), m_world(world), m_hp(0), m_alive(true), goodieHeld(false)
+: GraphObject(imageID, startX, startY, none), m_world(world), m_hp(0), m_alive(true), goodieHeld(false),
+  m_serial(0), m_cell(-1), m_layers(0), m_cellPrev(nullptr), m_cellNext(nullptr)
 {
     setVisible(true);
 }
 
+// Mark this actor as dead
+void Actor::setDead()
+{
+    if (m_alive)
+    {
+        m_alive = false;
+        m_world->actorDied(this);
+    }
+    setVisible(false);
+}
+
+// Move the actor, keeping the world's spatial index up to date
+void Actor::moveTo(double x, double y)
+{
+    GraphObject::moveTo(x, y);
+    m_world->actorMoved(this);
+}
+
 // Make the actor sustain damage.  Return true if this kills the
 // actor, and false otherwise.
 bool Actor::tryToBeKilled(int damageAmt)
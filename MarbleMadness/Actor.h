@@ -22,11 +22,14 @@ class Actor : public GraphObject
     bool isAlive() const { return m_alive; };
     
     // Mark this actor as dead
-    void setDead() { m_alive = false; setVisible(false); };
+    void setDead();
     
     // Get this actor's world
     StudentWorld* getWorld() const { return m_world; };
     
+    // Move the actor, keeping the world's spatial index up to date
+    virtual void moveTo(double x, double y);
+    
     // How many hit points does this actor have left?
     int getHitPoints() const { return m_hp; };
     
@@ -68,6 +71,10 @@ class Actor : public GraphObject
     // path to the player.
     virtual bool needsClearShot() const { return false; };
     
+    // Does this actor ever do anything on its turn?  (Actors that don't
+    // are never asked, which matters on boards with huge numbers of walls.)
+    virtual bool isInert() const { return false; };
+    
     // Added for ThiefBot/Goodie dynamic
     //These function will never be called by non-goodie actors
     virtual void setStolen(bool status) {};
@@ -80,6 +87,14 @@ class Actor : public GraphObject
     int m_hp;
     //Added for ThiefBot/Goodie dynamic
     bool goodieHeld;
+    //Links for the world's per-square actor lists (kept in the order
+    //actors were added, so square lookups match the order of m_actors)
+    friend class StudentWorld;
+    long long m_serial;
+    int m_cell;
+    unsigned int m_layers;
+    Actor* m_cellPrev;
+    Actor* m_cellNext;
 };
 
 class Agent : public Actor
@@ -244,6 +259,8 @@ class Exit : public Actor
     Exit(StudentWorld* world, int startX, int startY);
     virtual void doSomething();
     virtual bool allowsAgentColocation() const { return true; };
+    // Show the exit without announcing it (when it's restored revealed)
+    void setRevealed() { revealExit = true; setVisible(true); };
     
   private:
     bool revealExit;
@@ -255,6 +272,7 @@ class Wall : public Actor
     Wall(StudentWorld* world, int startX, int startY);
     virtual void doSomething() {};
     virtual bool stopsPea() const { return true; };
+    virtual bool isInert() const { return true; };
 };
 
 class Marble : public Actor
@@ -290,6 +308,8 @@ class ThiefBotFactory : public Actor
     ThiefBotFactory(StudentWorld* world, int startX, int startY, bool type);
     virtual void doSomething();
     virtual bool stopsPea() const { return true; };
+    // Does this factory make MeanThiefBots?
+    bool makesMeanThiefBots() const { return meanThief; };
     
   private:
     bool meanThief;
@@ -0,0 +1,253 @@
+#include "AssetArchive.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+const char* const AssetArchive::DEFAULT_NAME = "assets.pak";
+
+namespace {
+
+template <typename T>
+bool get(const unsigned char* data, size_t size, size_t& pos, T& value)
+{
+	if (size - pos < sizeof(T))
+		return false;
+	value = 0;
+	for (size_t i = 0; i < sizeof(T); i++)
+		value |= static_cast<T>(data[pos + i]) << (8 * i);
+	pos += sizeof(T);
+	return true;
+}
+
+template <typename T>
+void put(ostream& out, T value)
+{
+	for (size_t i = 0; i < sizeof(T); i++)
+		out.put(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+}  // namespace
+
+AssetArchive::~AssetArchive()
+{
+	unmap();
+}
+
+bool AssetArchive::open(const string& path)
+{
+	unmap();
+	if (!map(path))
+	{
+		cerr << "Cannot read asset archive " << path << endl;
+		return false;
+	}
+	if (!readIndex())
+	{
+		cerr << "Bad asset archive " << path << endl;
+		unmap();
+		return false;
+	}
+	return true;
+}
+
+bool AssetArchive::find(const string& name, const unsigned char*& data, size_t& size) const
+{
+	if (m_data == nullptr)
+		return false;
+	auto it = m_index.find(name);
+	if (it == m_index.end())
+		return false;
+	data = m_data + it->second.offset;
+	size = static_cast<size_t>(it->second.size);
+	return true;
+}
+
+  // Map the file read-only, or if it can't be mapped, read it all in.
+bool AssetArchive::map(const string& path)
+{
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+							  FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file != INVALID_HANDLE_VALUE)
+	{
+		LARGE_INTEGER size;
+		HANDLE mapping = nullptr;
+		if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (mapping != nullptr)
+		{
+			void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+			if (view != nullptr)
+			{
+				m_data = static_cast<const unsigned char*>(view);
+				m_size = static_cast<size_t>(size.QuadPart);
+				m_mapped = true;
+				return true;
+			}
+		}
+	}
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd >= 0)
+	{
+		struct stat statbuf;
+		void* view = MAP_FAILED;
+		if (fstat(fd, &statbuf) == 0 && statbuf.st_size > 0)
+			view = mmap(nullptr, static_cast<size_t>(statbuf.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (view != MAP_FAILED)
+		{
+			m_data = static_cast<const unsigned char*>(view);
+			m_size = static_cast<size_t>(statbuf.st_size);
+			m_mapped = true;
+			return true;
+		}
+	}
+#endif
+
+	ifstream in(path, ios::binary|ios::ate);
+	if (!in)
+		return false;
+	m_copy.resize(static_cast<size_t>(in.tellg()));
+	in.seekg(0);
+	if (m_copy.empty() || !in.read(reinterpret_cast<char*>(m_copy.data()), m_copy.size()))
+	{
+		m_copy.clear();
+		return false;
+	}
+	m_data = m_copy.data();
+	m_size = m_copy.size();
+	m_mapped = false;
+	return true;
+}
+
+void AssetArchive::unmap()
+{
+	if (m_data != nullptr && m_mapped)
+	{
+#if defined(_WIN32)
+		UnmapViewOfFile(m_data);
+#else
+		munmap(const_cast<unsigned char*>(m_data), m_size);
+#endif
+	}
+	m_data = nullptr;
+	m_size = 0;
+	m_mapped = false;
+	m_copy.clear();
+	m_index.clear();
+}
+
+bool AssetArchive::readIndex()
+{
+	size_t pos = 0;
+	uint32_t version, count;
+	if (m_size < 4 || memcmp(m_data, "MMPK", 4) != 0)
+		return false;
+	pos = 4;
+	if (!get(m_data, m_size, pos, version) || version != VERSION || !get(m_data, m_size, pos, count))
+		return false;
+
+	  // Every entry takes at least 20 bytes, so a count the rest of the
+	  // file can't hold is corrupt (and mustn't size the index).
+	if (count > (m_size - pos) / 20)
+		return false;
+	m_index.reserve(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		Entry e;
+		uint32_t nameLength;
+		if (!get(m_data, m_size, pos, e.offset) || !get(m_data, m_size, pos, e.size) ||
+			!get(m_data, m_size, pos, nameLength) || m_size - pos < nameLength ||
+			e.offset > m_size || e.size > m_size - e.offset)
+			return false;
+		m_index[string(reinterpret_cast<const char*>(m_data + pos), nameLength)] = e;
+		pos += nameLength;
+	}
+	return true;
+}
+
+bool AssetArchive::pack(const string& dir, const string& path)
+{
+	static const char* const EXTENSIONS[] = { ".tga", ".wav", ".txt", ".lvc" };
+
+	error_code ec;
+	vector<string> names;
+	for (const filesystem::directory_entry& entry : filesystem::directory_iterator(dir, ec))
+	{
+		string extension = entry.path().extension().string();
+		transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (entry.is_regular_file(ec) &&
+			std::find(begin(EXTENSIONS), end(EXTENSIONS), extension) != end(EXTENSIONS))
+			names.push_back(entry.path().filename().string());
+	}
+	if (ec)
+	{
+		cerr << "Cannot read directory " << dir << endl;
+		return false;
+	}
+	sort(names.begin(), names.end());
+
+	vector<vector<char>> contents;
+	for (const string& name : names)
+	{
+		ifstream in((filesystem::path(dir) / name).string(), ios::binary);
+		if (!in)
+		{
+			cerr << "Cannot open " << name << endl;
+			return false;
+		}
+		contents.emplace_back(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+		if (in.bad())
+		{
+			cerr << "Cannot read " << name << endl;
+			return false;
+		}
+	}
+
+	uint64_t offset = 4 + 2 * 4;
+	for (const string& name : names)
+		offset += 8 + 8 + 4 + name.size();
+
+	ofstream out(path, ios::binary);
+	out.write("MMPK", 4);
+	put(out, VERSION);
+	put(out, static_cast<uint32_t>(names.size()));
+	vector<uint64_t> offsets;
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		offset = (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+		offsets.push_back(offset);
+		put(out, offset);
+		put(out, static_cast<uint64_t>(contents[i].size()));
+		put(out, static_cast<uint32_t>(names[i].size()));
+		out.write(names[i].data(), names[i].size());
+		offset += contents[i].size();
+	}
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		while (static_cast<uint64_t>(out.tellp()) < offsets[i])
+			out.put(0);
+		out.write(contents[i].data(), contents[i].size());
+	}
+	if (!out)
+	{
+		cerr << "Cannot write " << path << endl;
+		return false;
+	}
+	cout << "Packed " << names.size() << " assets (" << offset << " bytes) into " << path << endl;
+	return true;
+}
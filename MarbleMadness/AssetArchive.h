@@ -0,0 +1,156 @@
+#ifndef ASSETARCHIVE_H_
+#define ASSETARCHIVE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+  // One file holding every asset (sprites, sounds, levels), mapped into
+  // memory and read in place: opening the game opens one file instead of
+  // dozens, and an asset is found by name in an index built once.
+  //
+  // File layout (all integers little-endian):
+  //   "MMPK", version, entry count                    (uint32 each)
+  //   index, one entry per asset:
+  //     offset (uint64), byte length (uint64), name length (uint32), name
+  //   asset data, each starting on a 16-byte boundary
+  //
+  // Names are file names relative to the asset directory ("pit.tga").
+
+class AssetArchive
+{
+  public:
+	~AssetArchive();
+
+	static AssetArchive& getInstance()
+	{
+		static AssetArchive instance;
+		return instance;
+	}
+
+	  // Map an archive; on failure, say why on cerr and return false.
+	bool open(const std::string& path);
+
+	bool isOpen() const
+	{
+		return m_data != nullptr;
+	}
+
+	  // Where the named asset's bytes are, valid until the program exits;
+	  // false if the archive isn't open or doesn't have it.
+	bool find(const std::string& name, const unsigned char*& data, std::size_t& size) const;
+
+	  // Write every sprite, sound and level file in directory dir to a new
+	  // archive at path; say what went wrong on cerr.
+	static bool pack(const std::string& dir, const std::string& path);
+
+	  // The archive's name in an asset directory, which is used if present
+	static const char* const DEFAULT_NAME;
+
+  private:
+	static const std::uint32_t VERSION = 1;
+	static const std::size_t ALIGNMENT = 16;
+
+	struct Entry
+	{
+		std::uint64_t	offset;
+		std::uint64_t	size;
+	};
+
+	const unsigned char*	m_data = nullptr;
+	std::size_t				m_size = 0;
+	bool					m_mapped = false;		// else m_data points into m_copy
+	std::vector<unsigned char>	m_copy;
+	std::unordered_map<std::string, Entry>	m_index;
+
+	AssetArchive() = default;
+	AssetArchive(const AssetArchive&) = delete;
+	AssetArchive& operator=(const AssetArchive&) = delete;
+
+	bool map(const std::string& path);
+	void unmap();
+	bool readIndex();
+};
+
+inline AssetArchive& Assets()
+{
+	return AssetArchive::getInstance();
+}
+
+  // A read-only streambuf over bytes in memory (such as an asset in the
+  // archive), with seeking.
+class MemoryStreamBuf : public std::streambuf
+{
+  public:
+	void set(const unsigned char* data, std::size_t size)
+	{
+		char* p = const_cast<char*>(reinterpret_cast<const char*>(data));
+		setg(p, p, p + size);
+	}
+
+  protected:
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+	{
+		if (!(which & std::ios_base::in))
+			return pos_type(off_type(-1));
+		off_type base = (dir == std::ios_base::beg ? 0 : dir == std::ios_base::cur ? gptr() - eback()
+																				   : egptr() - eback());
+		off_type pos = base + off;
+		if (pos < 0 || pos > egptr() - eback())
+			return pos_type(off_type(-1));
+		setg(eback(), eback() + pos, egptr());
+		return pos_type(pos);
+	}
+
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+	{
+		return seekoff(off_type(pos), std::ios_base::beg, which);
+	}
+};
+
+  // An istream over an asset: read in place from the archive if it has
+  // one by that name, otherwise from the file in the asset directory.
+class AssetStream : public std::istream
+{
+  public:
+	AssetStream()
+	 : std::istream(nullptr)
+	{
+	}
+
+	  // pathPrefix is the asset directory with a trailing '/', or empty.
+	bool open(const std::string& pathPrefix, const std::string& name)
+	{
+		close();
+		const unsigned char* data;
+		std::size_t size;
+		if (Assets().find(name, data, size))
+		{
+			m_memoryBuf.set(data, size);
+			rdbuf(&m_memoryBuf);
+		}
+		else if (m_fileBuf.open(pathPrefix + name, std::ios::in|std::ios::binary) != nullptr)
+			rdbuf(&m_fileBuf);
+		else
+			setstate(std::ios::failbit);
+		return static_cast<bool>(*this);
+	}
+
+	void close()
+	{
+		rdbuf(nullptr);
+		if (m_fileBuf.is_open())
+			m_fileBuf.close();
+	}
+
+  private:
+	std::filebuf	m_fileBuf;
+	MemoryStreamBuf	m_memoryBuf;
+};
+
+#endif // ASSETARCHIVE_H_
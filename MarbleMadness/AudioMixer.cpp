@@ -0,0 +1,177 @@
+#include "AudioMixer.h"
+#include <algorithm>
+#include <cstring>
+using namespace std;
+
+namespace {
+
+uint32_t get32(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint16_t get16(const unsigned char* p)
+{
+	return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+}  // namespace
+
+int AudioMixer::addClip(const unsigned char* data, size_t size, string& why)
+{
+	vector<int16_t> samples;
+	if (!decodeWav(data, size, samples, why))
+		return -1;
+	lock_guard<mutex> lock(m_mutex);
+	m_clips.push_back(move(samples));
+	return static_cast<int>(m_clips.size() - 1);
+}
+
+void AudioMixer::play(int clip)
+{
+	lock_guard<mutex> lock(m_mutex);
+	if (clip < 0 || static_cast<size_t>(clip) >= m_clips.size() || m_clips[clip].empty())
+		return;
+	Voice* voice = &m_voices[0];
+	for (Voice& v : m_voices)
+	{
+		if (v.clip < 0)
+		{
+			voice = &v;
+			break;
+		}
+		if (v.position > voice->position)
+			voice = &v;
+	}
+	voice->clip = clip;
+	voice->position = 0;
+}
+
+void AudioMixer::stopAll()
+{
+	lock_guard<mutex> lock(m_mutex);
+	for (Voice& v : m_voices)
+		v.clip = -1;
+}
+
+void AudioMixer::mix(int16_t* out, size_t frames)
+{
+	lock_guard<mutex> lock(m_mutex);
+	const size_t count = frames * CHANNELS;
+	m_sum.assign(count, 0);
+	bool playing = false;
+	for (Voice& v : m_voices)
+	{
+		if (v.clip < 0)
+			continue;
+		const vector<int16_t>& clip = m_clips[v.clip];
+		const size_t n = min(count, clip.size() - v.position * CHANNELS);
+		const int16_t* in = &clip[v.position * CHANNELS];
+		for (size_t i = 0; i < n; i++)
+			m_sum[i] += in[i];
+		v.position += n / CHANNELS;
+		if (v.position * CHANNELS >= clip.size())
+			v.clip = -1;
+		playing = true;
+	}
+
+	if (!playing)
+	{
+		memset(out, 0, count * sizeof(int16_t));
+		return;
+	}
+	for (size_t i = 0; i < count; i++)
+		out[i] = static_cast<int16_t>(max(-32768, min(32767, m_sum[i])));
+}
+
+  // A RIFF file whose "fmt " chunk says PCM and whose "data" chunk holds
+  // the samples, little-endian: 8-bit ones unsigned, 16-bit ones signed.
+  // Other chunks are skipped.
+bool AudioMixer::decodeWav(const unsigned char* data, size_t size, vector<int16_t>& samples, string& why)
+{
+	if (size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0)
+	{
+		why = "Not a WAV file";
+		return false;
+	}
+
+	int channels = 0, rate = 0, bits = 0;
+	const unsigned char* pcm = nullptr;
+	size_t pcmBytes = 0;
+	size_t pos = 12;
+	while (pos + 8 <= size && pcm == nullptr)
+	{
+		const unsigned char* chunk = data + pos;
+		size_t length = get32(chunk + 4);
+		size_t available = size - pos - 8;
+		if (memcmp(chunk, "data", 4) == 0)
+		{
+			pcm = chunk + 8;
+			pcmBytes = min(length, available);	// some files overstate it
+			break;
+		}
+		if (length > available)
+			break;
+		if (memcmp(chunk, "fmt ", 4) == 0 && length >= 16)
+		{
+			int format = get16(chunk + 8);
+			channels = get16(chunk + 10);
+			rate = static_cast<int>(get32(chunk + 12));
+			bits = get16(chunk + 22);
+			if (format != 1 && format != 0xfffe)
+			{
+				why = "WAV file isn't PCM";
+				return false;
+			}
+		}
+		pos += 8 + length + (length & 1);
+	}
+	if (pcm == nullptr || rate <= 0 || (channels != 1 && channels != 2) || (bits != 8 && bits != 16))
+	{
+		why = "Unsupported WAV format";
+		return false;
+	}
+
+	  // To 16-bit stereo at the source rate...
+	const size_t bytesPerFrame = static_cast<size_t>(channels) * bits / 8;
+	const size_t sourceFrames = pcmBytes / bytesPerFrame;
+	vector<int16_t> source(sourceFrames * CHANNELS);
+	if (channels == CHANNELS && bits == 16)
+		memcpy(source.data(), pcm, source.size() * sizeof(int16_t));	// as in memory on a little-endian CPU
+	else
+	{
+		for (size_t i = 0; i < sourceFrames; i++)
+		{
+			const unsigned char* in = pcm + i * bytesPerFrame;
+			for (int c = 0; c < CHANNELS; c++)
+			{
+				const unsigned char* s = in + (channels == 1 ? 0 : c) * (bits / 8);
+				source[i * CHANNELS + c] = (bits == 8 ? static_cast<int16_t>((s[0] - 128) * 256)
+													  : static_cast<int16_t>(get16(s)));
+			}
+		}
+	}
+	if (rate == SAMPLE_RATE)
+	{
+		samples = move(source);
+		return true;
+	}
+
+	  // ...then to SAMPLE_RATE, interpolating linearly between frames.
+	const size_t frames = static_cast<size_t>(static_cast<unsigned long long>(sourceFrames) * SAMPLE_RATE / rate);
+	samples.resize(frames * CHANNELS);
+	for (size_t i = 0; i < frames; i++)
+	{
+		unsigned long long at = static_cast<unsigned long long>(i) * rate;	// source position * SAMPLE_RATE
+		size_t from = static_cast<size_t>(at / SAMPLE_RATE);
+		size_t to = min(from + 1, sourceFrames - 1);
+		int weight = static_cast<int>(at % SAMPLE_RATE);
+		for (int c = 0; c < CHANNELS; c++)
+		{
+			int a = source[from * CHANNELS + c];
+			int b = source[to * CHANNELS + c];
+			samples[i * CHANNELS + c] = static_cast<int16_t>(a + static_cast<long long>(b - a) * weight / SAMPLE_RATE);
+		}
+	}
+	return true;
+}
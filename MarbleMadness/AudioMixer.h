@@ -0,0 +1,54 @@
+#ifndef AUDIOMIXER_H_
+#define AUDIOMIXER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+  // Plays any number of sound clips at once, in process: every clip is
+  // decoded from its WAV file once, when it is added, and converted to the
+  // mixer's own format (16-bit stereo at SAMPLE_RATE), so playing one is
+  // just pointing a voice at it, and mixing is adding samples.  Up to
+  // VOICES clips sound at a time; starting another when all are busy cuts
+  // off the one that has been playing longest.
+  //
+  // Whatever plays the mix (see AudioSink) pulls it with mix, on its own
+  // thread if it likes; play and stopAll may be called from any thread.
+
+class AudioMixer
+{
+  public:
+	static const int SAMPLE_RATE = 44100;
+	static const int CHANNELS = 2;
+	static const int VOICES = 16;
+
+	  // Decode WAV data (PCM, 8 or 16 bits, mono or stereo, any sample
+	  // rate) into a new clip.  Returns its number, or -1 after setting why.
+	int addClip(const unsigned char* data, std::size_t size, std::string& why);
+
+	void play(int clip);
+	void stopAll();
+
+	  // Fill out with the next frames of the mix (interleaved stereo,
+	  // silence where nothing is playing).
+	void mix(std::int16_t* out, std::size_t frames);
+
+  private:
+	struct Voice
+	{
+		int				clip = -1;		// -1 if the voice is free
+		std::size_t		position = 0;	// in frames
+	};
+
+	std::mutex							m_mutex;
+	std::vector<std::vector<std::int16_t>>	m_clips;	// interleaved stereo
+	Voice								m_voices[VOICES];
+	std::vector<std::int32_t>			m_sum;			// scratch for mix
+
+	static bool decodeWav(const unsigned char* data, std::size_t size, std::vector<std::int16_t>& samples,
+						  std::string& why);
+};
+
+#endif // AUDIOMIXER_H_
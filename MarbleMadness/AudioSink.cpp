@@ -0,0 +1,426 @@
+#include "AudioSink.h"
+#include "AudioMixer.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#if defined(_WIN32)
+#include <windows.h>
+#include <mmsystem.h>
+#pragma comment(lib, "winmm.lib")
+#elif defined(__APPLE__)
+#include <AudioToolbox/AudioToolbox.h>
+#elif defined(__linux__)
+#include <dlfcn.h>
+#endif
+using namespace std;
+
+namespace {
+
+  // Frames mixed at a time by the device sinks: about 12ms
+const size_t PERIOD_FRAMES = 512;
+const size_t BYTES_PER_FRAME = AudioMixer::CHANNELS * sizeof(int16_t);
+
+void put32(unsigned char* p, uint32_t value)
+{
+	for (int i = 0; i < 4; i++)
+		p[i] = static_cast<unsigned char>(value >> (8 * i));
+}
+
+void put16(unsigned char* p, uint16_t value)
+{
+	p[0] = static_cast<unsigned char>(value);
+	p[1] = static_cast<unsigned char>(value >> 8);
+}
+
+#if defined(_WIN32)
+
+  // Keeps a few buffers queued on the wave mapper, refilling each as it
+  // comes back.
+class WaveOutSink : public AudioSink
+{
+  public:
+	WaveOutSink()
+	 : m_device(nullptr), m_event(nullptr), m_mixer(nullptr), m_running(false)
+	{
+	}
+
+	~WaveOutSink()
+	{
+		stop();
+	}
+
+	bool start(AudioMixer& mixer) override
+	{
+		WAVEFORMATEX format = {};
+		format.wFormatTag = WAVE_FORMAT_PCM;
+		format.nChannels = AudioMixer::CHANNELS;
+		format.nSamplesPerSec = AudioMixer::SAMPLE_RATE;
+		format.wBitsPerSample = 16;
+		format.nBlockAlign = static_cast<WORD>(BYTES_PER_FRAME);
+		format.nAvgBytesPerSec = AudioMixer::SAMPLE_RATE * static_cast<DWORD>(BYTES_PER_FRAME);
+		m_event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		if (m_event == nullptr ||
+			waveOutOpen(&m_device, WAVE_MAPPER, &format, reinterpret_cast<DWORD_PTR>(m_event), 0, CALLBACK_EVENT) !=
+				MMSYSERR_NOERROR)
+		{
+			cerr << "Cannot open the sound device" << endl;
+			if (m_event != nullptr)
+				CloseHandle(m_event);
+			m_event = nullptr;
+			m_device = nullptr;
+			return false;
+		}
+		for (int i = 0; i < BUFFERS; i++)
+		{
+			m_buffers[i].resize(PERIOD_FRAMES * AudioMixer::CHANNELS);
+			m_headers[i] = WAVEHDR();
+			m_headers[i].lpData = reinterpret_cast<LPSTR>(m_buffers[i].data());
+			m_headers[i].dwBufferLength = static_cast<DWORD>(PERIOD_FRAMES * BYTES_PER_FRAME);
+			waveOutPrepareHeader(m_device, &m_headers[i], sizeof(WAVEHDR));
+		}
+		m_mixer = &mixer;
+		m_running = true;
+		m_thread = thread(&WaveOutSink::run, this);
+		return true;
+	}
+
+	void stop() override
+	{
+		if (m_device == nullptr)
+			return;
+		m_running = false;
+		SetEvent(m_event);
+		m_thread.join();
+		waveOutReset(m_device);
+		for (WAVEHDR& header : m_headers)
+			waveOutUnprepareHeader(m_device, &header, sizeof(WAVEHDR));
+		waveOutClose(m_device);
+		CloseHandle(m_event);
+		m_device = nullptr;
+		m_event = nullptr;
+	}
+
+  private:
+	static const int BUFFERS = 4;
+
+	HWAVEOUT				m_device;
+	HANDLE					m_event;	// set by the device as each buffer comes back
+	AudioMixer*				m_mixer;
+	atomic<bool>			m_running;
+	thread					m_thread;
+	WAVEHDR					m_headers[BUFFERS];
+	vector<int16_t>			m_buffers[BUFFERS];
+
+	void run()
+	{
+		while (m_running)
+		{
+			for (int i = 0; i < BUFFERS; i++)
+			{
+				if (m_headers[i].dwFlags & WHDR_INQUEUE)
+					continue;
+				m_mixer->mix(m_buffers[i].data(), PERIOD_FRAMES);
+				waveOutWrite(m_device, &m_headers[i], sizeof(WAVEHDR));
+			}
+			WaitForSingleObject(m_event, 100);
+		}
+	}
+};
+
+#elif defined(__APPLE__)
+
+  // An audio queue calls back on its own thread for each buffer to refill.
+class AudioQueueSink : public AudioSink
+{
+  public:
+	AudioQueueSink()
+	 : m_queue(nullptr), m_mixer(nullptr)
+	{
+	}
+
+	~AudioQueueSink()
+	{
+		stop();
+	}
+
+	bool start(AudioMixer& mixer) override
+	{
+		AudioStreamBasicDescription format = {};
+		format.mSampleRate = AudioMixer::SAMPLE_RATE;
+		format.mFormatID = kAudioFormatLinearPCM;
+		format.mFormatFlags = kLinearPCMFormatFlagIsSignedInteger | kLinearPCMFormatFlagIsPacked;
+		format.mBytesPerPacket = BYTES_PER_FRAME;
+		format.mFramesPerPacket = 1;
+		format.mBytesPerFrame = BYTES_PER_FRAME;
+		format.mChannelsPerFrame = AudioMixer::CHANNELS;
+		format.mBitsPerChannel = 16;
+		m_mixer = &mixer;
+		if (AudioQueueNewOutput(&format, refillCallback, this, nullptr, nullptr, 0, &m_queue) != noErr)
+		{
+			cerr << "Cannot open the sound device" << endl;
+			m_queue = nullptr;
+			return false;
+		}
+		for (int i = 0; i < BUFFERS; i++)
+		{
+			AudioQueueBufferRef buffer;
+			if (AudioQueueAllocateBuffer(m_queue, PERIOD_FRAMES * BYTES_PER_FRAME, &buffer) == noErr)
+				refill(buffer);
+		}
+		if (AudioQueueStart(m_queue, nullptr) != noErr)
+		{
+			cerr << "Cannot start the sound device" << endl;
+			stop();
+			return false;
+		}
+		return true;
+	}
+
+	void stop() override
+	{
+		if (m_queue == nullptr)
+			return;
+		AudioQueueStop(m_queue, true);
+		AudioQueueDispose(m_queue, true);
+		m_queue = nullptr;
+	}
+
+  private:
+	static const int BUFFERS = 3;
+
+	AudioQueueRef	m_queue;
+	AudioMixer*		m_mixer;
+
+	static void refillCallback(void* sink, AudioQueueRef, AudioQueueBufferRef buffer)
+	{
+		static_cast<AudioQueueSink*>(sink)->refill(buffer);
+	}
+
+	void refill(AudioQueueBufferRef buffer)
+	{
+		m_mixer->mix(static_cast<int16_t*>(buffer->mAudioData), PERIOD_FRAMES);
+		buffer->mAudioDataByteSize = static_cast<UInt32>(PERIOD_FRAMES * BYTES_PER_FRAME);
+		AudioQueueEnqueueBuffer(m_queue, buffer, 0, nullptr);
+	}
+};
+
+#elif defined(__linux__)
+
+  // Blocking writes to ALSA's default device from a thread of its own.
+  // libasound is opened at run time rather than linked, so the game
+  // neither needs its headers to build nor the library to run.
+class AlsaSink : public AudioSink
+{
+  public:
+	AlsaSink()
+	 : m_library(nullptr), m_pcm(nullptr), m_mixer(nullptr), m_running(false)
+	{
+	}
+
+	~AlsaSink()
+	{
+		stop();
+		if (m_library != nullptr)
+			dlclose(m_library);
+	}
+
+	  // Find the functions used; false if there is no libasound.
+	bool load()
+	{
+		m_library = dlopen("libasound.so.2", RTLD_NOW);
+		if (m_library == nullptr)
+			return false;
+		m_open = reinterpret_cast<OpenFunction>(dlsym(m_library, "snd_pcm_open"));
+		m_setParams = reinterpret_cast<SetParamsFunction>(dlsym(m_library, "snd_pcm_set_params"));
+		m_write = reinterpret_cast<WriteFunction>(dlsym(m_library, "snd_pcm_writei"));
+		m_recover = reinterpret_cast<RecoverFunction>(dlsym(m_library, "snd_pcm_recover"));
+		m_drop = reinterpret_cast<CloseFunction>(dlsym(m_library, "snd_pcm_drop"));
+		m_close = reinterpret_cast<CloseFunction>(dlsym(m_library, "snd_pcm_close"));
+		return m_open != nullptr && m_setParams != nullptr && m_write != nullptr && m_recover != nullptr &&
+			   m_drop != nullptr && m_close != nullptr;
+	}
+
+	bool start(AudioMixer& mixer) override
+	{
+		if (m_open(&m_pcm, "default", STREAM_PLAYBACK, 0) < 0)
+		{
+			cerr << "Cannot open the sound device" << endl;
+			m_pcm = nullptr;
+			return false;
+		}
+		if (m_setParams(m_pcm, FORMAT_S16_LE, ACCESS_RW_INTERLEAVED, AudioMixer::CHANNELS, AudioMixer::SAMPLE_RATE,
+						1, LATENCY_US) < 0)
+		{
+			cerr << "Cannot set up the sound device" << endl;
+			m_close(m_pcm);
+			m_pcm = nullptr;
+			return false;
+		}
+		m_mixer = &mixer;
+		m_running = true;
+		m_thread = thread(&AlsaSink::run, this);
+		return true;
+	}
+
+	void stop() override
+	{
+		if (m_pcm == nullptr)
+			return;
+		m_running = false;
+		m_thread.join();
+		m_drop(m_pcm);
+		m_close(m_pcm);
+		m_pcm = nullptr;
+	}
+
+  private:
+	  // From alsa/pcm.h
+	static const int STREAM_PLAYBACK = 0;
+	static const int FORMAT_S16_LE = 2;
+	static const int ACCESS_RW_INTERLEAVED = 3;
+	static const unsigned int LATENCY_US = 50000;
+
+	using OpenFunction = int (*)(void** pcm, const char* name, int stream, int mode);
+	using SetParamsFunction = int (*)(void* pcm, int format, int access, unsigned int channels, unsigned int rate,
+									  int softResample, unsigned int latencyUs);
+	using WriteFunction = long (*)(void* pcm, const void* buffer, unsigned long frames);
+	using RecoverFunction = int (*)(void* pcm, int error, int silent);
+	using CloseFunction = int (*)(void* pcm);
+
+	void*				m_library;
+	void*				m_pcm;
+	OpenFunction		m_open = nullptr;
+	SetParamsFunction	m_setParams = nullptr;
+	WriteFunction		m_write = nullptr;
+	RecoverFunction		m_recover = nullptr;
+	CloseFunction		m_drop = nullptr;
+	CloseFunction		m_close = nullptr;
+	AudioMixer*			m_mixer;
+	atomic<bool>		m_running;
+	thread				m_thread;
+
+	  // Each write waits until the device has room, which paces the loop.
+	void run()
+	{
+		vector<int16_t> buffer(PERIOD_FRAMES * AudioMixer::CHANNELS);
+		while (m_running)
+		{
+			m_mixer->mix(buffer.data(), PERIOD_FRAMES);
+			size_t done = 0;
+			while (done < PERIOD_FRAMES && m_running)
+			{
+				long written = m_write(m_pcm, &buffer[done * AudioMixer::CHANNELS], PERIOD_FRAMES - done);
+				if (written >= 0)
+					done += static_cast<size_t>(written);
+				else if (m_recover(m_pcm, static_cast<int>(written), 1) < 0)
+				{
+					cerr << "Lost the sound device" << endl;
+					return;
+				}
+			}
+		}
+	}
+};
+
+#endif
+
+}  // namespace
+
+unique_ptr<AudioSink> AudioSink::openDevice()
+{
+#if defined(_WIN32)
+	return unique_ptr<AudioSink>(new WaveOutSink);
+#elif defined(__APPLE__)
+	return unique_ptr<AudioSink>(new AudioQueueSink);
+#elif defined(__linux__)
+	unique_ptr<AlsaSink> sink(new AlsaSink);
+	if (!sink->load())
+		return nullptr;
+	return sink;
+#else
+	return nullptr;
+#endif
+}
+
+WavFileSink::WavFileSink(const string& path)
+ : m_path(path), m_file(nullptr), m_mixer(nullptr), m_elapsedUs(0), m_framesWritten(0), m_failed(false)
+{
+}
+
+WavFileSink::~WavFileSink()
+{
+	stop();
+}
+
+bool WavFileSink::start(AudioMixer& mixer)
+{
+	m_file = fopen(m_path.c_str(), "wb");
+	if (m_file == nullptr || !writeHeader())
+	{
+		cerr << "Cannot write " << m_path << endl;
+		if (m_file != nullptr)
+			fclose(m_file);
+		m_file = nullptr;
+		return false;
+	}
+	m_mixer = &mixer;
+	m_elapsedUs = 0;
+	m_framesWritten = 0;
+	m_failed = false;
+	return true;
+}
+
+  // Fill in the lengths, now that they're known.
+void WavFileSink::stop()
+{
+	if (m_file == nullptr)
+		return;
+	bool ok = !m_failed && fseek(m_file, 0, SEEK_SET) == 0 && writeHeader();
+	if (fclose(m_file) != 0 || !ok)
+		cerr << "Error writing " << m_path << endl;
+	m_file = nullptr;
+}
+
+void WavFileSink::advance(chrono::microseconds elapsed)
+{
+	if (m_file == nullptr || m_failed)
+		return;
+	m_elapsedUs += elapsed.count();
+	const unsigned long long due = static_cast<unsigned long long>(m_elapsedUs) * AudioMixer::SAMPLE_RATE / 1000000;
+	m_buffer.resize(PERIOD_FRAMES * AudioMixer::CHANNELS);
+	while (m_framesWritten < due)
+	{
+		size_t frames = static_cast<size_t>(min<unsigned long long>(due - m_framesWritten, PERIOD_FRAMES));
+		m_mixer->mix(m_buffer.data(), frames);
+		if (fwrite(m_buffer.data(), BYTES_PER_FRAME, frames, m_file) != frames)
+		{
+			m_failed = true;
+			return;
+		}
+		m_framesWritten += frames;
+	}
+}
+
+  // A plain PCM header: "RIFF", "WAVE", a 16-byte "fmt " chunk, then the
+  // "data" chunk's header.  Samples are written little-endian as they are
+  // in memory (every platform the game builds for is little-endian).
+bool WavFileSink::writeHeader()
+{
+	const uint32_t dataBytes = static_cast<uint32_t>(m_framesWritten * BYTES_PER_FRAME);
+	unsigned char header[44];
+	memcpy(header, "RIFF", 4);
+	put32(header + 4, 36 + dataBytes);
+	memcpy(header + 8, "WAVEfmt ", 8);
+	put32(header + 16, 16);
+	put16(header + 20, 1);
+	put16(header + 22, AudioMixer::CHANNELS);
+	put32(header + 24, AudioMixer::SAMPLE_RATE);
+	put32(header + 28, AudioMixer::SAMPLE_RATE * static_cast<uint32_t>(BYTES_PER_FRAME));
+	put16(header + 32, static_cast<uint16_t>(BYTES_PER_FRAME));
+	put16(header + 34, 16);
+	memcpy(header + 36, "data", 4);
+	put32(header + 40, dataBytes);
+	return fwrite(header, 1, sizeof(header), m_file) == sizeof(header);
+}
@@ -0,0 +1,68 @@
+#ifndef AUDIOSINK_H_
+#define AUDIOSINK_H_
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+class AudioMixer;
+
+  // Where the mix goes.  A sink pulls frames from the mixer at its own
+  // pace: one that plays them does so on its own thread, as fast as the
+  // sound device takes them; one that records them, whenever the game
+  // says time has passed.
+
+class AudioSink
+{
+  public:
+	virtual ~AudioSink()
+	{
+	}
+
+	  // Start pulling from mixer, which must outlive the sink (or the
+	  // next stop).  On failure, say why on cerr and return false.
+	virtual bool start(AudioMixer& mixer) = 0;
+	virtual void stop() = 0;
+
+	  // The game has played on for elapsed; sinks that keep real time
+	  // ignore this.
+	virtual void advance(std::chrono::microseconds /*elapsed*/)
+	{
+	}
+
+	  // The sound device (ALSA on Linux, which is loaded at run time so
+	  // the game runs silently without it; an audio queue on macOS;
+	  // waveOut on Windows), not yet started; null if there isn't one.
+	static std::unique_ptr<AudioSink> openDevice();
+};
+
+  // Records the mix to a 16-bit stereo WAV file, a tick's worth of sound
+  // per tick, so a headless run's soundtrack lines up with its frames
+  // however fast it ran.
+
+class WavFileSink : public AudioSink
+{
+  public:
+	explicit WavFileSink(const std::string& path);
+	~WavFileSink();
+
+	bool start(AudioMixer& mixer) override;
+	void stop() override;
+	void advance(std::chrono::microseconds elapsed) override;
+
+  private:
+	std::string					m_path;
+	std::FILE*					m_file;
+	AudioMixer*					m_mixer;
+	long long					m_elapsedUs;
+	unsigned long long			m_framesWritten;
+	bool						m_failed;
+	std::vector<std::int16_t>	m_buffer;
+
+	bool writeHeader();
+};
+
+#endif // AUDIOSINK_H_
@@ -0,0 +1,184 @@
+#include "Benchmark.h"
+#include "LevelGenerator.h"
+#include "ChunkedLevel.h"
+#include "StudentWorld.h"
+#include "Actor.h"
+#include "GameConstants.h"
+#include "GraphObject.h"
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace {
+
+const int WARMUP_TICKS = 200;
+
+struct Scenario
+{
+	const char* name;
+	int			width;
+	int			height;
+	char		actor;		// what the scenario is dense in (' ' for nothing)
+	int			requested;	// how many of them it asks for
+	bool		maze;
+	int			peasPerTick;	// scripted peas fired each tick
+	bool		chunked;	// stream the level from the chunked format
+};
+
+  // A pea storm needs far more shooters than a level can hold, so the
+  // script fires peas from random open squares instead.
+void firePeas(StudentWorld& world, const vector<pair<int, int>>& open, int count, mt19937& rng)
+{
+	static const int dirs[] = { GraphObject::right, GraphObject::left, GraphObject::up, GraphObject::down };
+	uniform_int_distribution<size_t> cell(0, open.size() - 1);
+	uniform_int_distribution<int> dir(0, 3);
+	for (int i = 0; i < count; i++)
+	{
+		const pair<int, int>& c = open[cell(rng)];
+		world.addActor(new Pea(&world, c.first, c.second, dirs[dir(rng)]));
+	}
+}
+
+bool runScenario(const Scenario& s, int ticks, unsigned int seed, const filesystem::path& dir)
+{
+	LevelGenerator gen(s.width, s.height, seed);
+	if (s.maze)
+		gen.carveMaze();
+	gen.placeSealedPlayer();
+	gen.scatter('x', 1);
+	int placed = 0;
+	if (s.actor != ' ')
+	{
+		  // alternate horizontal and vertical RageBots
+		if (s.actor == 'h')
+			placed = gen.scatter('h', (s.requested + 1) / 2) + gen.scatter('v', s.requested / 2);
+		else
+			placed = gen.scatter(s.actor, s.requested);
+	}
+	vector<pair<int, int>> open = gen.emptyCells();
+
+	  // StudentWorld prefers level00.lvc, so only one of the two may exist
+	error_code ec;
+	filesystem::path text = dir / "level00.txt";
+	filesystem::path chunked = dir / "level00.lvc";
+	filesystem::remove(chunked, ec);
+	bool written = gen.writeTo(text.string());
+	if (written && s.chunked)
+	{
+		Level lev("");
+		written = lev.loadLevel(text.string()) == Level::load_success &&
+				  ChunkedLevel::convert(lev, chunked.string());
+		filesystem::remove(text, ec);
+	}
+	if (!written)
+	{
+		cerr << "Cannot write benchmark level to " << dir << endl;
+		return false;
+	}
+
+	seedRandInt(seed);
+	mt19937 scriptRng(seed);
+	StudentWorld world(dir.string());
+	chrono::steady_clock::time_point initStart = chrono::steady_clock::now();
+	if (world.init() != GWSTATUS_CONTINUE_GAME)
+	{
+		cerr << s.name << ": generated level failed to load" << endl;
+		return false;
+	}
+	double initMs = chrono::duration<double, milli>(chrono::steady_clock::now() - initStart).count();
+
+	int resets = 0;
+	double objectTicks = 0;
+	chrono::steady_clock::duration elapsed(0);
+	for (int t = -WARMUP_TICKS; t < ticks; t++)
+	{
+		if (s.peasPerTick > 0 && !open.empty())
+			firePeas(world, open, s.peasPerTick, scriptRng);
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		int status = world.move();
+		if (t >= 0)
+		{
+			elapsed += chrono::steady_clock::now() - start;
+			objectTicks += GraphObject::getGraphObjectCount();
+		}
+
+		if (status != GWSTATUS_CONTINUE_GAME)
+		{
+			  // Shouldn't happen with the player sealed in, but keep going.
+			world.cleanUp();
+			world.init();
+			resets++;
+		}
+	}
+	world.cleanUp();
+
+	double seconds = chrono::duration<double>(elapsed).count();
+	string counts = (s.actor == ' ' ? string("-") : to_string(placed) + "/" + to_string(s.requested));
+	cout << left << setw(14) << s.name << right
+		 << setw(10) << (to_string(s.width) + "x" + to_string(s.height))
+		 << setw(12) << counts
+		 << setw(10) << fixed << setprecision(1) << initMs
+		 << setw(12) << fixed << setprecision(0) << objectTicks / ticks
+		 << setw(14) << setprecision(0) << ticks / seconds
+		 << setw(12) << setprecision(2) << seconds * 1e6 / ticks;
+	if (resets > 0)
+		cout << "  (" << resets << " resets)";
+	cout << endl;
+	return true;
+}
+
+}  // namespace
+
+int runSimulationBenchmarks(const string& filter, int ticks, unsigned int seed)
+{
+	  // Standard levels are VIEW_WIDTH x VIEW_HEIGHT; the dense scenarios
+	  // use bigger boards so everything requested fits, and the huge ones
+	  // check that per-tick cost tracks the actor count, not the board size.
+	static const Scenario scenarios[] = {
+		  // name           width       height       actor requested maze  peas chunked
+		{ "wall-maze",   VIEW_WIDTH, VIEW_HEIGHT, ' ',    0,     true,  0,   false },
+		{ "ragebots",    32,         32,          'h',    200,   false, 0,   false },
+		{ "factories",   VIEW_WIDTH, VIEW_HEIGHT, '1',    50,    false, 0,   false },
+		{ "pea-storm",   VIEW_WIDTH, VIEW_HEIGHT, ' ',    0,     false, 20,  false },
+		{ "crystals",    48,         48,          '*',    1000,  false, 0,   false },
+		{ "huge-maze",   1025,       1025,        ' ',    0,     true,  0,   false },
+		{ "arena",       1024,       1024,        'h',    20000, false, 0,   false },
+		  // the same huge boards streamed: init time and live objects
+		  // should stay flat as the board grows
+		{ "stream-maze", 1025,       1025,        ' ',    0,     true,  0,   true  },
+		{ "stream-arena", 1024,      1024,        'h',    20000, false, 0,   true  },
+		{ "stream-4k",   4095,       4095,        ' ',    0,     true,  0,   true  },
+	};
+
+	error_code ec;
+	filesystem::path dir = filesystem::temp_directory_path(ec) / "marblemadness-bench";
+	filesystem::create_directories(dir, ec);
+	if (ec)
+	{
+		cerr << "Cannot create benchmark directory " << dir << endl;
+		return 1;
+	}
+
+	cout << "Simulation benchmark: " << ticks << " ticks per scenario, seed " << seed << endl;
+	cout << left << setw(14) << "scenario" << right << setw(10) << "board" << setw(12) << "placed"
+		 << setw(10) << "init ms"
+		 << setw(12) << "objects" << setw(14) << "ticks/s" << setw(12) << "us/tick" << endl;
+
+	bool ok = true;
+	for (const Scenario& s : scenarios)
+	{
+		if (!filter.empty() && string(s.name).find(filter) == string::npos)
+			continue;
+		ok = runScenario(s, ticks, seed, dir) && ok;
+	}
+
+	filesystem::remove_all(dir, ec);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,13 @@
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include <string>
+
+  // Measure StudentWorld::move throughput on synthetic, reproducible
+  // levels.  Runs every scenario whose name contains filter (all of them
+  // if filter is empty), ticks measured ticks each after a warmup, with
+  // level layouts and in-game randomness derived from seed.  Returns a
+  // process exit status.
+int runSimulationBenchmarks(const std::string& filter, int ticks, unsigned int seed);
+
+#endif // BENCHMARK_H_
@@ -0,0 +1,233 @@
+#ifndef CHUNKEDLEVEL_H_
+#define CHUNKEDLEVEL_H_
+
+#include "Level.h"
+#include "AssetArchive.h"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+  // A level stored as square chunks that can be read one at a time, so a
+  // huge map doesn't have to be parsed or held in memory all at once.
+  //
+  // File layout (all integers little-endian):
+  //   "MMLC", version, width, height, chunk size, player x, player y,
+  //   crystal count                                   (uint32 each)
+  //   chunk index, row-major from the bottom-left chunk:
+  //     offset (uint64), byte length (uint32)
+  //   chunk payloads: the chunk's squares row-major from its bottom row,
+  //     run-length encoded as (count 1-255, Level::MazeEntry) byte pairs;
+  //     squares past the board's edge are encoded as empty
+
+class ChunkedLevel
+{
+public:
+
+	static const int DEFAULT_CHUNK_SIZE = 32;
+
+	ChunkedLevel(std::string assetDir)
+	 : m_width(0), m_height(0), m_chunkSize(0), m_playerX(0), m_playerY(0),
+	   m_crystals(0), m_pathPrefix(assetDir)
+	{
+		if (!m_pathPrefix.empty())
+			m_pathPrefix += '/';
+	}
+
+	  // Read the header and chunk index; chunks are read by loadChunk.
+	Level::LoadResult open(std::string filename)
+	{
+		if (!m_file.open(m_pathPrefix, filename))
+			return Level::load_fail_file_not_found;
+
+		char magic[4];
+		std::uint32_t version, width, height, chunkSize, playerX, playerY, crystals;
+		if (!m_file.read(magic, 4)  ||  std::string(magic, 4) != "MMLC"  ||
+			!get(version)  ||  version != VERSION  ||  !get(width)  ||  !get(height)  ||
+			!get(chunkSize)  ||  !get(playerX)  ||  !get(playerY)  ||  !get(crystals))
+			return Level::load_fail_bad_format;
+		if (width < 3  ||  height < 3  ||  width > MAX_BOARD_WIDTH  ||  height > MAX_BOARD_HEIGHT  ||
+			chunkSize == 0  ||  chunkSize > 256  ||  playerX >= width  ||  playerY >= height)
+			return Level::load_fail_bad_format;
+
+		m_width = width;
+		m_height = height;
+		m_chunkSize = chunkSize;
+		m_playerX = playerX;
+		m_playerY = playerY;
+		m_crystals = crystals;
+
+		  // Nothing in the index may point past the end of the file, or
+		  // be longer than a chunk can encode to (a run per square), so a
+		  // corrupt file can't make loadChunk allocate or read wildly.
+		std::streamoff indexStart = m_file.tellg();
+		m_file.seekg(0, std::ios::end);
+		std::streamoff end = m_file.tellg();
+		m_file.seekg(indexStart);
+		size_t chunks = static_cast<size_t>(chunksAcross()) * chunksDown();
+		if (indexStart < 0  ||  end < indexStart  ||  static_cast<std::uint64_t>(end - indexStart) / 12 < chunks)
+			return Level::load_fail_bad_format;
+		const std::uint64_t fileSize = static_cast<std::uint64_t>(end);
+		const std::uint64_t maxLength = 2ull * chunkSize * chunkSize;
+		m_offsets.resize(chunks);
+		m_lengths.resize(chunks);
+		for (size_t i = 0; i < chunks; i++)
+		{
+			if (!get(m_offsets[i])  ||  !get(m_lengths[i]))
+				return Level::load_fail_bad_format;
+			if (m_lengths[i] % 2 != 0  ||  m_lengths[i] > maxLength  ||
+				m_offsets[i] > fileSize  ||  m_lengths[i] > fileSize - m_offsets[i])
+				return Level::load_fail_bad_format;
+		}
+
+		return Level::load_success;
+	}
+
+	int getWidth() const { return m_width; }
+	int getHeight() const { return m_height; }
+	int getChunkSize() const { return m_chunkSize; }
+	int chunksAcross() const { return (m_width + m_chunkSize - 1) / m_chunkSize; }
+	int chunksDown() const { return (m_height + m_chunkSize - 1) / m_chunkSize; }
+	int getPlayerX() const { return m_playerX; }
+	int getPlayerY() const { return m_playerY; }
+	int getCrystals() const { return m_crystals; }
+
+	  // Decode chunk cx,cy into cells (chunk size squared entries, row-major
+	  // from the chunk's bottom row).  Return false if the chunk is corrupt.
+	bool loadChunk(int cx, int cy, std::vector<Level::MazeEntry>& cells)
+	{
+		size_t index = static_cast<size_t>(cy) * chunksAcross() + cx;
+		cells.assign(static_cast<size_t>(m_chunkSize) * m_chunkSize, Level::empty);
+
+		std::vector<unsigned char> runs(m_lengths[index]);
+		m_file.clear();
+		m_file.seekg(static_cast<std::streamoff>(m_offsets[index]));
+		if (!m_file.read(reinterpret_cast<char*>(runs.data()), runs.size())  ||  runs.size() % 2 != 0)
+			return false;
+
+		size_t pos = 0;
+		for (size_t i = 0; i < runs.size(); i += 2)
+		{
+			if (runs[i+1] > Level::ammo  ||  pos + runs[i] > cells.size())
+				return false;
+			std::fill_n(cells.begin() + pos, runs[i], static_cast<Level::MazeEntry>(runs[i+1]));
+			pos += runs[i];
+		}
+		return pos == cells.size();
+	}
+
+	  // Write a loaded text level out in chunked form.
+	static bool convert(const Level& level, std::string path, int chunkSize = DEFAULT_CHUNK_SIZE)
+	{
+		int width = level.getWidth();
+		int height = level.getHeight();
+		int across = (width + chunkSize - 1) / chunkSize;
+		int down = (height + chunkSize - 1) / chunkSize;
+
+		std::uint32_t playerX = 0, playerY = 0, crystals = 0;
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++)
+			{
+				Level::MazeEntry me = level.getContentsOf(x, y);
+				if (me == Level::player)
+					playerX = x, playerY = y;
+				else if (me == Level::crystal)
+					crystals++;
+			}
+
+		std::vector<std::vector<unsigned char>> payloads;
+		for (int cy = 0; cy < down; cy++)
+			for (int cx = 0; cx < across; cx++)
+			{
+				std::vector<unsigned char> runs;
+				for (int y = cy * chunkSize; y < (cy + 1) * chunkSize; y++)
+					for (int x = cx * chunkSize; x < (cx + 1) * chunkSize; x++)
+					{
+						unsigned char me = static_cast<unsigned char>(level.getContentsOf(x, y));
+						if (!runs.empty()  &&  runs.back() == me  &&  runs[runs.size()-2] < 255)
+							runs[runs.size()-2]++;
+						else
+						{
+							runs.push_back(1);
+							runs.push_back(me);
+						}
+					}
+				payloads.push_back(runs);
+			}
+
+		std::ofstream out(path.c_str(), std::ios::binary);
+		out.write("MMLC", 4);
+		put(out, VERSION);
+		put(out, std::uint32_t(width));
+		put(out, std::uint32_t(height));
+		put(out, std::uint32_t(chunkSize));
+		put(out, playerX);
+		put(out, playerY);
+		put(out, crystals);
+		std::uint64_t offset = 4 + 7 * 4 + payloads.size() * (8 + 4);
+		for (const std::vector<unsigned char>& runs : payloads)
+		{
+			put(out, offset);
+			put(out, std::uint32_t(runs.size()));
+			offset += runs.size();
+		}
+		for (const std::vector<unsigned char>& runs : payloads)
+			out.write(reinterpret_cast<const char*>(runs.data()), runs.size());
+		return static_cast<bool>(out);
+	}
+
+private:
+
+	static const std::uint32_t VERSION = 1;
+
+	int							m_width;
+	int							m_height;
+	int							m_chunkSize;
+	int							m_playerX;
+	int							m_playerY;
+	int							m_crystals;
+	std::vector<std::uint64_t>	m_offsets;
+	std::vector<std::uint32_t>	m_lengths;
+	AssetStream					m_file;		// from the asset archive if it's there
+	std::string					m_pathPrefix;
+
+	template <typename T>
+	bool get(T& value)
+	{
+		unsigned char bytes[sizeof(T)];
+		if (!m_file.read(reinterpret_cast<char*>(bytes), sizeof(T)))
+			return false;
+		value = 0;
+		for (size_t i = 0; i < sizeof(T); i++)
+			value |= static_cast<T>(bytes[i]) << (8 * i);
+		return true;
+	}
+
+	template <typename T>
+	static void put(std::ostream& out, T value)
+	{
+		for (size_t i = 0; i < sizeof(T); i++)
+			out.put(static_cast<char>((value >> (8 * i)) & 0xff));
+	}
+};
+
+  // An actor in a chunk that has been streamed out, kept in a compact form
+  // so it can be re-created with its state when the player comes back.
+
+struct ParkedActor
+{
+	enum Kind : std::uint8_t {
+		wall, pit, thiefbot_factory, mean_thiefbot_factory, exit, revealed_exit,
+		marble, crystal, restore_health, extra_life, ammo, ragebot,
+		regular_thiefbot, mean_thiefbot
+	};
+
+	std::uint16_t	x;
+	std::uint16_t	y;
+	Kind			kind;
+	std::uint8_t	direction;	// in units of 90 degrees
+	std::int16_t	hitPoints;
+};
+
+#endif // CHUNKEDLEVEL_H_
@@ -0,0 +1,297 @@
+#include "FrameCapture.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+using namespace std;
+
+namespace {
+
+uint32_t crc32(uint32_t crc, const unsigned char* data, size_t length)
+{
+	static const array<uint32_t, 256> table = [] {
+		array<uint32_t, 256> t;
+		for (uint32_t n = 0; n < 256; n++)
+		{
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			t[n] = c;
+		}
+		return t;
+	}();
+	crc = ~crc;
+	for (size_t i = 0; i < length; i++)
+		crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+void putBigEndian(vector<unsigned char>& out, uint32_t value)
+{
+	out.push_back(static_cast<unsigned char>(value >> 24));
+	out.push_back(static_cast<unsigned char>(value >> 16));
+	out.push_back(static_cast<unsigned char>(value >> 8));
+	out.push_back(static_cast<unsigned char>(value));
+}
+
+void putChunk(vector<unsigned char>& out, const char* type, const vector<unsigned char>& data)
+{
+	putBigEndian(out, static_cast<uint32_t>(data.size()));
+	size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+	putBigEndian(out, crc32(0, &out[start], out.size() - start));
+}
+
+  // Full-range BT.601, as the C420jpeg color space tag says
+inline unsigned char lumaOf(int r, int g, int b)
+{
+	return static_cast<unsigned char>((77 * r + 150 * g + 29 * b + 128) >> 8);
+}
+
+inline unsigned char blueChromaOf(int r, int g, int b)
+{
+	return static_cast<unsigned char>(max(0, min(255, (-43 * r - 85 * g + 128 * b + 32768 + 128) >> 8)));
+}
+
+inline unsigned char redChromaOf(int r, int g, int b)
+{
+	return static_cast<unsigned char>(max(0, min(255, (128 * r - 107 * g - 21 * b + 32768 + 128) >> 8)));
+}
+
+}  // namespace
+
+FrameCapture::FrameCapture()
+ : m_y4m(false), m_width(0), m_height(0), m_stream(nullptr), m_acquired(nullptr), m_submitted(0),
+   m_written(0), m_dropped(0), m_closing(false), m_failed(false)
+{
+}
+
+FrameCapture::~FrameCapture()
+{
+	close();
+}
+
+bool FrameCapture::open(const string& path, int width, int height, int fps)
+{
+	close();
+	m_path = path;
+	m_width = width;
+	m_height = height;
+	m_y4m = (path.size() > 4 && path.compare(path.size() - 4, 4, ".y4m") == 0);
+	if (m_y4m)
+	{
+		m_stream = fopen(path.c_str(), "wb");
+		if (m_stream == nullptr)
+		{
+			cerr << "Cannot write " << path << endl;
+			return false;
+		}
+		fprintf(m_stream, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, max(fps, 1));
+	}
+	else
+	{
+		error_code ec;
+		filesystem::create_directories(path, ec);
+		if (!filesystem::is_directory(path, ec))
+		{
+			cerr << "Cannot create directory " << path << endl;
+			return false;
+		}
+	}
+
+	m_frames.clear();
+	m_free.clear();
+	m_queued.clear();
+	for (int i = 0; i < QUEUE_FRAMES; i++)
+	{
+		m_frames.emplace_back(new Frame);
+		m_frames.back()->rgba.resize(static_cast<size_t>(width) * height * 4);
+		m_free.push_back(m_frames.back().get());
+	}
+	m_acquired = nullptr;
+	m_submitted = m_written = m_dropped = 0;
+	m_closing = m_failed = false;
+	m_encoder = thread(&FrameCapture::encodeLoop, this);
+	return true;
+}
+
+void FrameCapture::close()
+{
+	if (!m_encoder.joinable())
+		return;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_closing = true;
+	}
+	m_frameQueued.notify_one();
+	m_encoder.join();
+	if (m_stream != nullptr)
+	{
+		fclose(m_stream);
+		m_stream = nullptr;
+	}
+	if (m_failed)
+		cerr << "Error writing frames to " << m_path << endl;
+}
+
+unsigned char* FrameCapture::acquire(bool wait)
+{
+	if (m_acquired == nullptr)
+	{
+		unique_lock<mutex> lock(m_mutex);
+		if (wait)
+			m_frameFreed.wait(lock, [this] { return !m_free.empty() || m_failed; });
+		if (m_free.empty())
+		{
+			m_dropped++;
+			return nullptr;
+		}
+		m_acquired = m_free.front();
+		m_free.pop_front();
+	}
+	return m_acquired->rgba.data();
+}
+
+void FrameCapture::submit(bool bottomUp)
+{
+	if (m_acquired == nullptr)
+		return;
+	m_acquired->bottomUp = bottomUp;
+	m_acquired->number = m_submitted++;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_queued.push_back(m_acquired);
+	}
+	m_acquired = nullptr;
+	m_frameQueued.notify_one();
+}
+
+void FrameCapture::encodeLoop()
+{
+	for (;;)
+	{
+		Frame* frame;
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_frameQueued.wait(lock, [this] { return !m_queued.empty() || m_closing; });
+			if (m_queued.empty())
+				return;
+			frame = m_queued.front();
+			m_queued.pop_front();
+		}
+
+		bool ok = !m_failed && (m_y4m ? writeY4m(*frame) : writePng(*frame));
+
+		{
+			lock_guard<mutex> lock(m_mutex);
+			if (ok)
+				m_written++;
+			else
+				m_failed = true;
+			m_free.push_back(frame);
+		}
+		m_frameFreed.notify_one();
+	}
+}
+
+  // One FRAME: the luma plane, then each chroma plane at half resolution
+  // (each sample the average of a 2x2 block), all top row first.
+bool FrameCapture::writeY4m(const Frame& frame)
+{
+	const int w = m_width, h = m_height;
+	const int cw = (w + 1) / 2, ch = (h + 1) / 2;
+	m_planes.resize(static_cast<size_t>(w) * h + 2 * static_cast<size_t>(cw) * ch);
+	unsigned char* luma = m_planes.data();
+	unsigned char* cb = luma + static_cast<size_t>(w) * h;
+	unsigned char* cr = cb + static_cast<size_t>(cw) * ch;
+
+	auto row = [&](int y) {
+		return &frame.rgba[static_cast<size_t>(frame.bottomUp ? h - 1 - y : y) * w * 4];
+	};
+	for (int y = 0; y < h; y += 2)
+	{
+		const unsigned char* top = row(y);
+		const unsigned char* bottom = row(min(y + 1, h - 1));
+		unsigned char* lumaTop = luma + static_cast<size_t>(y) * w;
+		unsigned char* lumaBottom = luma + static_cast<size_t>(min(y + 1, h - 1)) * w;
+		for (int x = 0; x < w; x += 2)
+		{
+			int x1 = min(x + 1, w - 1);
+			const unsigned char* p[4] = { top + x * 4, top + x1 * 4, bottom + x * 4, bottom + x1 * 4 };
+			lumaTop[x] = lumaOf(p[0][0], p[0][1], p[0][2]);
+			lumaTop[x1] = lumaOf(p[1][0], p[1][1], p[1][2]);
+			lumaBottom[x] = lumaOf(p[2][0], p[2][1], p[2][2]);
+			lumaBottom[x1] = lumaOf(p[3][0], p[3][1], p[3][2]);
+			int r = (p[0][0] + p[1][0] + p[2][0] + p[3][0] + 2) / 4;
+			int g = (p[0][1] + p[1][1] + p[2][1] + p[3][1] + 2) / 4;
+			int b = (p[0][2] + p[1][2] + p[2][2] + p[3][2] + 2) / 4;
+			size_t c = static_cast<size_t>(y / 2) * cw + x / 2;
+			cb[c] = blueChromaOf(r, g, b);
+			cr[c] = redChromaOf(r, g, b);
+		}
+	}
+
+	return fputs("FRAME\n", m_stream) >= 0 &&
+		   fwrite(m_planes.data(), 1, m_planes.size(), m_stream) == m_planes.size();
+}
+
+  // An RGBA PNG whose image data is zlib "stored" blocks: bigger than a
+  // compressed file, but quick to write and needs no deflate.
+bool FrameCapture::writePng(const Frame& frame)
+{
+	const int w = m_width, h = m_height;
+	const size_t rowBytes = static_cast<size_t>(w) * 4 + 1;	// filter type byte, then pixels
+
+	m_planes.resize(rowBytes * h);
+	for (int y = 0; y < h; y++)
+	{
+		unsigned char* out = &m_planes[y * rowBytes];
+		out[0] = 0;
+		const unsigned char* in = &frame.rgba[static_cast<size_t>(frame.bottomUp ? h - 1 - y : y) * w * 4];
+		copy(in, in + static_cast<size_t>(w) * 4, out + 1);
+	}
+
+	vector<unsigned char> zlib = { 0x78, 0x01 };
+	const size_t MAX_STORED = 65535;
+	uint32_t a = 1, b = 0;
+	for (size_t pos = 0; pos < m_planes.size() || pos == 0; pos += MAX_STORED)
+	{
+		size_t length = min(MAX_STORED, m_planes.size() - pos);
+		bool last = (pos + length == m_planes.size());
+		zlib.push_back(last ? 1 : 0);
+		zlib.push_back(static_cast<unsigned char>(length));
+		zlib.push_back(static_cast<unsigned char>(length >> 8));
+		zlib.push_back(static_cast<unsigned char>(~length));
+		zlib.push_back(static_cast<unsigned char>(~length >> 8));
+		zlib.insert(zlib.end(), m_planes.begin() + pos, m_planes.begin() + pos + length);
+		for (size_t i = pos; i < pos + length; i++)
+		{
+			a = (a + m_planes[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+		if (last)
+			break;
+	}
+	putBigEndian(zlib, (b << 16) | a);
+
+	vector<unsigned char> header;
+	putBigEndian(header, static_cast<uint32_t>(w));
+	putBigEndian(header, static_cast<uint32_t>(h));
+	header.insert(header.end(), { 8, 6, 0, 0, 0 });	// 8-bit RGBA, no interlace
+
+	static const unsigned char SIGNATURE[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	vector<unsigned char> png(SIGNATURE, SIGNATURE + sizeof(SIGNATURE));
+	putChunk(png, "IHDR", header);
+	putChunk(png, "IDAT", zlib);
+	putChunk(png, "IEND", vector<unsigned char>());
+
+	char name[32];
+	snprintf(name, sizeof(name), "/frame-%06lld.png", frame.number);
+	FILE* file = fopen((m_path + name).c_str(), "wb");
+	if (file == nullptr)
+		return false;
+	bool ok = fwrite(png.data(), 1, png.size(), file) == png.size();
+	return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,113 @@
+#ifndef FRAMECAPTURE_H_
+#define FRAMECAPTURE_H_
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+  // Writes rendered frames to disk on a background encoder thread, so the
+  // thread that draws only copies each frame into a buffer.  Buffers come
+  // from a fixed pool, so the queue to the encoder is bounded: when it is
+  // full the producer either waits (offline rendering, where every frame
+  // must be written) or drops the frame (live play, which mustn't stall).
+  //
+  // The output is a raw YUV4MPEG2 stream (4:2:0, full range) if the path
+  // ends in ".y4m", otherwise a directory of frame-NNNNNN.png files
+  // (uncompressed, so no zlib is needed).
+  //
+  //	unsigned char* rgba = capture.acquire(false);
+  //	if (rgba != nullptr)
+  //	{
+  //		...fill width x height RGBA pixels...
+  //		capture.submit(bottomUp);
+  //	}
+
+class FrameCapture
+{
+  public:
+	FrameCapture();
+	~FrameCapture();
+
+	  // Start writing width x height frames at fps frames per second to
+	  // path.  Return false (and say why on cerr) if it can't be created.
+	bool open(const std::string& path, int width, int height, int fps);
+
+	  // Write out everything queued and stop the encoder thread.
+	void close();
+
+	bool isOpen() const
+	{
+		return m_encoder.joinable();
+	}
+
+	int width() const
+	{
+		return m_width;
+	}
+
+	int height() const
+	{
+		return m_height;
+	}
+
+	  // A buffer for the next frame's RGBA pixels, or null if every buffer
+	  // is queued and wait is false (the frame is counted as dropped).
+	unsigned char* acquire(bool wait);
+
+	  // Queue the acquired buffer; bottomUp if its first row is the bottom
+	  // of the frame (as glReadPixels returns it).
+	void submit(bool bottomUp);
+
+	long long framesWritten() const
+	{
+		return m_written;
+	}
+
+	long long framesDropped() const
+	{
+		return m_dropped;
+	}
+
+  private:
+	static const int QUEUE_FRAMES = 8;
+
+	struct Frame
+	{
+		std::vector<unsigned char>	rgba;
+		bool						bottomUp = false;
+		long long					number = 0;
+	};
+
+	std::string		m_path;
+	bool			m_y4m;
+	int				m_width;
+	int				m_height;
+	std::FILE*		m_stream;			// the .y4m file
+	std::vector<std::unique_ptr<Frame>>	m_frames;
+	std::deque<Frame*>	m_free;
+	std::deque<Frame*>	m_queued;
+	Frame*			m_acquired;			// producer only
+	long long		m_submitted;		// producer only
+	long long		m_written;
+	long long		m_dropped;
+	bool			m_closing;
+	bool			m_failed;
+	std::mutex		m_mutex;
+	std::condition_variable	m_frameFreed;
+	std::condition_variable	m_frameQueued;
+	std::thread		m_encoder;
+
+	  // Scratch for the encoder thread
+	std::vector<unsigned char>	m_planes;
+
+	void encodeLoop();
+	bool writeY4m(const Frame& frame);
+	bool writePng(const Frame& frame);
+};
+
+#endif // FRAMECAPTURE_H_
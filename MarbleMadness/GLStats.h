@@ -0,0 +1,73 @@
+#ifndef GLSTATS_H_
+#define GLSTATS_H_
+
+  // GL work issued while drawing, for benchmarks.  Draw-path GL calls are
+  // made through COUNT_GL, which tallies each one by its name, so the
+  // counts are of the calls actually made:
+  //   vertex specification (glBegin, glVertex*, glTexCoord*) and draws
+  //     (glEnd, glDrawArrays, glCallLists) are calls;
+  //   queries (glGet*, glReadPixels) and glFinish/glutSwapBuffers are
+  //     calls;
+  //   everything else is a state change as well, and glBindTexture is a
+  //     texture bind too.
+
+struct GLStats
+{
+	unsigned long long glCalls = 0;
+	unsigned long long stateChanges = 0;
+	unsigned long long textureBinds = 0;
+	unsigned long long drawCalls = 0;
+
+	static GLStats& getInstance()
+	{
+		static GLStats instance;
+		return instance;
+	}
+
+	void reset()
+	{
+		*this = GLStats();
+	}
+
+	enum Kind { vertex, draw, other, state, bind };
+
+	  // What the call whose source text is call is, worked out at compile
+	  // time
+	static constexpr Kind kindOf(const char* call)
+	{
+		return startsWith(call, "glBegin(") || startsWith(call, "glVertex") || startsWith(call, "glTexCoord") ? vertex
+			 : startsWith(call, "glEnd(") || startsWith(call, "glDrawArrays") || startsWith(call, "glCallLists") ? draw
+			 : startsWith(call, "glGet") || startsWith(call, "glReadPixels") || startsWith(call, "glFinish") ||
+			   startsWith(call, "glutSwapBuffers") ? other
+			 : startsWith(call, "glBindTexture") ? bind
+			 : state;
+	}
+
+	template <Kind kind>
+	void count()
+	{
+		glCalls++;
+		if (kind == draw)
+			drawCalls++;
+		if (kind == state || kind == bind)
+			stateChanges++;
+		if (kind == bind)
+			textureBinds++;
+	}
+
+  private:
+	static constexpr bool startsWith(const char* s, const char* prefix)
+	{
+		return *prefix == '\0' || (*s == *prefix && startsWith(s + 1, prefix + 1));
+	}
+};
+
+inline GLStats& GLCounts()
+{
+	return GLStats::getInstance();
+}
+
+  // Make a GL call and count it (see GLStats).
+#define COUNT_GL(call) (GLCounts().count<GLStats::kindOf(#call)>(), call)
+
+#endif // GLSTATS_H_
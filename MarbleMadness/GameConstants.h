@@ -35,6 +35,7 @@ const int SOUND_ROBOT_BORN		= 8;
 const int SOUND_ROBOT_IMPACT	= 9;
 const int SOUND_PLAYER_IMPACT	= 10;
 const int SOUND_ROBOT_MUNCH		= 11;
+const int NUM_SOUNDS			= 12;
 
 const int SOUND_NONE			= -1;
 
@@ -54,6 +55,11 @@ const int KEY_PRESS_ENTER  = '\r';
 const int VIEW_WIDTH	= 15;
 const int VIEW_HEIGHT	= 15;
 
+// levels may be larger than the view; their size comes from the level file
+
+const int MAX_BOARD_WIDTH	= 4096;
+const int MAX_BOARD_HEIGHT	= 4096;
+
 // status of each tick (did the player die?)
 
 const int GWSTATUS_CONTINUE_GAME	= 0;
@@ -68,6 +74,24 @@ const int GWSTATUS_NOT_IMPLEMENTED	= 5;
 const double SPRITE_WIDTH_GL = .6; // note - this is tied implicitly to SPRITE_WIDTH due to carey's sloppy openGL programming
 const double SPRITE_HEIGHT_GL = .5; // note - this is tied implicitly to SPRITE_HEIGHT due to carey's sloppy openGL programming
 
+// The generator behind randInt, randomly seeded unless seedRandInt is called
+
+inline
+std::default_random_engine& randomEngine()
+{
+	static std::random_device rd;
+	static std::default_random_engine generator(rd());
+	return generator;
+}
+
+// Make the sequence of randInt results reproducible
+
+inline
+void seedRandInt(unsigned int seed)
+{
+	randomEngine().seed(seed);
+}
+
 // Return a uniformly distributed random int from min to max, inclusive
 
 inline
@@ -75,10 +99,8 @@ int randInt(int min, int max)
 {
 	if (max < min)
 		std::swap(max, min);
-	static std::random_device rd;
-	static std::default_random_engine generator(rd());
 	std::uniform_int_distribution<> distro(min, max);
-	return distro(generator);
+	return distro(randomEngine());
 }
 
 #endif // GAMECONSTANTS_H_
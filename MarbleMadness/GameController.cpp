@@ -8,15 +8,29 @@
 #include "GameConstants.h"
 #include "GraphObject.h"
 #include "SoundFX.h"
+#include "AssetArchive.h"
 #include "SpriteManager.h"
+#include "StaticLayer.h"
+#include "GLStats.h"
+#include "Profiler.h"
+#include "Tracer.h"
 #include <iostream>
 #include <string>
 #include <map>
+#include <set>
 #include <utility>
 #include <cstdlib>
 #include <algorithm>
 #include <thread>
 #include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define HAVE_SSE
+#endif
 using namespace std;
 
 /*
@@ -55,6 +69,23 @@ static const double FONT_SCALEDOWN = 760.0;
 static const double SCORE_Y = 3.8;
 static const double SCORE_Z = -10;
 
+  // How often the GLUT thread checks for a newly published frame, and how
+  // often once none has arrived for IDLE_POLLS polls in a row
+static const unsigned int RENDER_POLL_MS = 4;
+static const unsigned int IDLE_RENDER_POLL_MS = 33;
+static const int IDLE_POLLS = 64;
+
+  // In turbo mode, how often a frame is published when not rendering
+  // every Nth tick
+static const chrono::microseconds DISPLAY_REFRESH_PERIOD(16667);
+
+  // How long drawing a frame may spend adding newly decoded sprites
+static const chrono::microseconds SPRITE_LOAD_BUDGET(4000);
+
+  // Range of tick periods selectable with the speed hotkeys
+static const chrono::microseconds MIN_TICK_PERIOD(100);
+static const chrono::microseconds MAX_TICK_PERIOD(1000000);
+
 struct SpriteInfo
 {
 	unsigned int imageID;
@@ -64,15 +95,19 @@ struct SpriteInfo
 	int			 depth;
 };
 
-static void convertToGlutCoords(double x, double y, double& gx, double& gy, double& gz);
-static void drawPrompt(string mainMessage, string secondMessage);
-static void drawScoreAndLives(string);
+static double viewScale(int viewWidth, int viewHeight);
+static void convertToGlutCoords(float* xs, float* ys, size_t count, double scale);
+static const double SPRITE_GLUT_Z = .6 * VISIBLE_MIN_Z;
+static void drawPrompt(const string& mainMessage, const string& secondMessage);
+static void drawScoreAndLives(const string&);
 
 enum GameController::GameControllerState : int {
     welcome, init, makemove, animate, contgame, finishedlevel, gameover, cleanup, quit, prompt, not_applicable
 };
 
-int GameController::m_msPerTick;
+static const char* const stateNames[] = {
+	"welcome", "init", "makemove", "animate", "contgame", "finishedlevel", "gameover", "cleanup", "quit", "prompt", "not_applicable"
+};
 
 void GameController::initDrawersAndSounds()
 {
@@ -102,7 +137,7 @@ void GameController::initDrawersAndSounds()
 		{ IID_PIT         , 0, "pit.tga", "PIT", 2 }
 	};
 
-	m_soundMap = {
+	static const pair<int, const char*> sounds[] = {
 		{ SOUND_THEME         , "theme.wav" },
 		{ SOUND_PLAYER_FIRE   , "torpedo.wav" },
 		{ SOUND_ENEMY_FIRE    , "pop.wav" },
@@ -117,17 +152,80 @@ void GameController::initDrawersAndSounds()
 		{ SOUND_ROBOT_BORN    , "materialize.wav" },
 	};
 
+	string path = m_gw->assetPath();
+	if (!path.empty())
+		path += '/';
+
+	  // Only say where each frame is: a file is decoded (on the worker
+	  // threads) once an actor with its image is created or the image is
+	  // about to be drawn, so starting up doesn't take longer the more
+	  // sprites there are.
+	  // The GL renderer's scaling and mipmapping is done there too, so
+	  // adding a frame to it is only an upload.
+	if (!m_softwareRenderer)
+		m_spriteLoader.setPrepare(SpriteManager::prepareCell);
 	for (const auto& d : drawers)
 	{
-		string path = m_gw->assetPath();
-		if (!path.empty())
-			path += '/';
-		if (!m_spriteManager.loadSprite(path + d.tgaFileName, d.imageID, d.frameNum)) {
-			cerr << "Error loading sprite: " << (path+d.tgaFileName) << endl;
-			setGameState(quit);
-		}
+		m_spriteLoader.declare(d.imageID, d.frameNum, path, d.tgaFileName);
 		m_imageNameMap[d.imageID] = d.imageName;
-		m_imageDepthMap[d.imageID] = d.depth;
+		GraphObject::setImageDepth(d.imageID, d.depth);
+	}
+	GraphObject::setFirstSpawnCallback(imageSpawned);
+
+	  // Decode every sound once, so playing one is just indexing.
+	m_soundClips.assign(NUM_SOUNDS, -1);
+	for (const auto& sound : sounds)
+	{
+		const unsigned char* data;
+		size_t size;
+		if (Assets().find(sound.second, data, size))
+			m_soundClips[sound.first] = SoundFX().addClip(sound.second, data, size);
+		else
+			m_soundClips[sound.first] = SoundFX().addClipFile(path + sound.second);
+	}
+
+	  // Things that (almost) never change are cached as a layer
+	static const int staticImages[] = { IID_WALL, IID_PIT, IID_ROBOT_FACTORY, IID_EXIT };
+	for (int imageID : staticImages)
+		GraphObject::setImageStatic(imageID, true);
+}
+
+  // Runs on the thread creating actors (the simulation thread, if any).
+void GameController::imageSpawned(int imageID)
+{
+	Game().m_spriteLoader.request(imageID);
+}
+
+  // Add the sprites decoded since last time to whichever renderer is in
+  // use, taking no more than budget (zero means no limit) so drawing isn't
+  // held up.
+void GameController::collectSprites(chrono::microseconds budget)
+{
+	ScopedTrace trace("collectSprites", "assets");
+	size_t added = m_spriteLoader.collect([this](int imageID, int frameNum, const TgaImage& image,
+												 const vector<char>& prepared) {
+		return m_softwareRenderer ? m_softwareRenderer->addSprite(image, imageID, frameNum)
+								  : m_spriteManager.addSprite(prepared, imageID, frameNum);
+	}, budget);
+	if (added == 0 || m_softwareRenderer)
+		return;
+	m_staticLayer.invalidate();	// it may have been drawn without them
+}
+
+  // Block until every sprite in the snapshot can be drawn, for runs whose
+  // frames must not depend on how long decoding took.
+void GameController::waitForSprites(const RenderSnapshot& snapshot)
+{
+	for (const vector<SpriteRecord>* sprites : { &snapshot.sprites, &snapshot.staticSprites })
+	{
+		for (const SpriteRecord& cur : *sprites)
+		{
+			if (!m_spriteLoader.isCollected(cur.imageID))
+			{
+				m_spriteLoader.wait(cur.imageID);
+				collectSprites(chrono::microseconds(0));
+			}
+		}
 	}
 }
 
@@ -140,9 +238,9 @@ bool GameController::passesThruWhenSingleStepping(int key) const
 	return passThruKeys.find(key) != passThruKeys.end();
 }
 
-static void doSomethingCallback()
+static void displayCallback()
 {
-	Game().doSomething();
+	Game().redisplay();
 }
 
 static void reshapeCallback(int w, int h)
@@ -160,31 +258,191 @@ static void specialKeyboardEventCallback(int key, int x, int y)
 	Game().specialKeyboardEvent(key, x, y);
 }
 
-void GameController::timerFuncCallback(int)
+  // Runs on the GLUT thread:  draw whatever the simulation thread most
+  // recently published, and leave the main loop once it has finished.
+void GameController::timerFuncCallback(int generation)
+{
+	GameController& game = Game();
+	if (generation != game.m_pollGeneration)
+		return;  // superseded by a prompter poll after input
+	  // A frame drawn without sprites that were still loading is drawn
+	  // again once some have arrived.
+	if (game.renderLatestSnapshot(game.m_spritesMissing && game.m_spriteLoader.hasDecoded()))
+		game.m_idlePolls = 0;
+	else if (game.m_idlePolls < IDLE_POLLS)
+		game.m_idlePolls++;
+	if (game.m_simFinished)
+		glutLeaveMainLoop();
+	else
+		glutTimerFunc(game.m_idlePolls < IDLE_POLLS ? RENDER_POLL_MS : IDLE_RENDER_POLL_MS,
+					  timerFuncCallback, generation);
+}
+
+  // Runs on its own thread, so tick timing doesn't depend on how long GL
+  // takes to draw.
+void GameController::simulationLoop()
+{
+	using Clock = TickScheduler::Clock;
+
+	Trace().nameThisThread("simulation");
+
+	chrono::microseconds period(m_tickPeriodUs);
+	m_scheduler.setPeriod(period);
+	m_scheduler.start(Clock::now());
+
+	bool wasTurbo = false;
+	long long turboTicks = 0;
+	Clock::time_point lastTurboPublish = Clock::now();
+
+	while (!m_simFinished)
+	{
+		if (period.count() != m_tickPeriodUs)
+		{
+			period = chrono::microseconds(m_tickPeriodUs);
+			m_scheduler.setPeriod(period);
+			m_scheduler.resync(Clock::now());
+		}
+
+		if (inTurboGamePlay())
+		{
+			doSomething();
+			m_scheduler.countUnscheduledTick();
+			wasTurbo = true;
+
+			int renderEvery = m_turboRenderEvery;
+			Clock::time_point now = Clock::now();
+			if (renderEvery > 0 ? ++turboTicks % renderEvery == 0
+								: now - lastTurboPublish >= DISPLAY_REFRESH_PERIOD)
+			{
+				publishSnapshot();
+				lastTurboPublish = now;
+			}
+			continue;
+		}
+		if (wasTurbo)
+		{
+			  // Don't try to catch up on the ticks turbo mode ran ahead of.
+			publishSnapshot();
+			m_scheduler.resync(Clock::now());
+			wasTurbo = false;
+		}
+
+		  // Nothing happens until a key is pressed, so don't tick.
+		if (waitingForKey())
+		{
+			waitForInput();
+			m_scheduler.resync(Clock::now());
+			continue;
+		}
+
+		this_thread::sleep_until(m_scheduler.nextDeadline());
+
+		int due = m_scheduler.ticksDue(TickScheduler::Clock::now());
+		for (int i = 0; i < due && !m_simFinished; i++)
+			doSomething();
+
+		  // When catching up, only the last tick of the batch is published.
+		if (due > 0)
+			publishSnapshot();
+	}
+}
+
+  // Is the game stopped until a key is pressed (at a prompt, or between
+  // moves when single stepping)?
+bool GameController::waitingForKey() const
+{
+	if (m_replay || m_inputKey != INVALID_KEY || m_lastKeyHit != INVALID_KEY ||
+		m_singleStep != m_stepping || m_quitRequested || m_profileDumpRequested)
+		return false;
+	return m_gameState == prompt ||
+		   (m_gameState == animate && m_stepping && m_curIntraFrameTick < 0 &&
+			m_nextStateAfterAnimate == not_applicable);
+}
+
+  // Sleep until input means the game is no longer waiting for a key.  The
+  // GLUT thread changes key state before notifying under the lock, so no
+  // wakeup is missed.
+void GameController::waitForInput()
+{
+	ScopedTrace trace("waitForInput", "controller");
+	unique_lock<mutex> lock(m_inputMutex);
+	m_inputArrived.wait(lock, [this] { return !waitingForKey(); });
+}
+
+  // Called on the GLUT thread for every key press: wake the simulation
+  // thread if it is waiting, and go back to polling for frames often.
+void GameController::inputEvent()
+{
+	{
+		  // the key state has changed; a waiter either saw that or is
+		  // already waiting when notified
+		lock_guard<mutex> lock(m_inputMutex);
+	}
+	m_inputArrived.notify_one();
+
+	if (m_idlePolls >= IDLE_POLLS)
+	{
+		m_idlePolls = 0;
+		glutTimerFunc(RENDER_POLL_MS, timerFuncCallback, ++m_pollGeneration);
+	}
+}
+
+bool GameController::inTurboGamePlay() const
+{
+	return m_turbo && (m_gameState == makemove || m_gameState == animate);
+}
+
+void GameController::setTickPeriod(chrono::microseconds period)
+{
+	period = max(MIN_TICK_PERIOD, min(period, MAX_TICK_PERIOD));
+	m_tickPeriodUs = period.count();
+}
+
+  // Speed up (factor > 1) or slow down the game from the keyboard.
+void GameController::changeTickRate(double factor)
 {
-	Game().doSomething();
-	this_thread::sleep_for(chrono::milliseconds(m_msPerTick));
-    glutTimerFunc(0, timerFuncCallback, 0);
+	setTickPeriod(chrono::microseconds(static_cast<long long>(m_tickPeriodUs / factor)));
+	cerr << "Tick period: " << m_tickPeriodUs / 1000.0 << "ms ("
+		 << 1e6 / m_tickPeriodUs << " ticks/s)" << endl;
 }
 
 void windowCloseCallback()
 {
-#if defined(__APPLE__)
-	SoundFX().abortClip();
-#endif
+	  // The simulation thread stops any playing clip when it quits.
+	Game().quitGame();
 }
 
-void GameController::run(int argc, char* argv[], GameWorld* gw, string windowTitle, int msPerTick)
+void GameController::startGame(GameWorld* gw, int msPerTick)
 {
 	gw->setController(this);
 	m_gw = gw;
-	m_msPerTick = msPerTick;
+	m_defaultTickPeriod = chrono::milliseconds(msPerTick);
+	setTickPeriod(m_defaultTickPeriod);
 	setGameState(welcome);
 	m_lastKeyHit = INVALID_KEY;
+	m_inputKey = INVALID_KEY;
 	m_singleStep = false;
+	m_stepping = false;
+	m_tickCount = 0;
+	m_replayNext = 0;
+	m_quitRequested = false;
+	m_simFinished = false;
+	m_profileDumpRequested = false;
 	m_curIntraFrameTick = 0;
 	m_playerWon = false;
 
+	  // A replay plays the recorded game with its seed; a recording picks
+	  // a seed to record (or copies the replay's).
+	if (m_recording)
+		m_recording->seed = (m_replay ? m_replay->seed : random_device()());
+	if (m_replay || m_recording)
+		seedRandInt(m_replay ? m_replay->seed : m_recording->seed);
+}
+
+void GameController::run(int argc, char* argv[], GameWorld* gw, string windowTitle, int msPerTick)
+{
+	startGame(gw, msPerTick);
+
 	glutInit(&argc, argv);
 
 	glutInitDisplayMode(GLUT_RGB | GLUT_DEPTH | GLUT_DOUBLE);
@@ -193,77 +451,267 @@ void GameController::run(int argc, char* argv[], GameWorld* gw, string windowTit
 	glutCreateWindow(windowTitle.c_str());
 
 	initDrawersAndSounds();  // won't work unless *after* window created
+	SoundFX().start(true);
+
+	  // Frames are captured as they are drawn, which is at most once per
+	  // display refresh.
+	if (!m_capturePath.empty())
+		m_capture.open(m_capturePath, WINDOW_WIDTH, WINDOW_HEIGHT, 60);
 
 	glutKeyboardFunc(keyboardEventCallback);
 	glutSpecialFunc(specialKeyboardEventCallback);
 	glutReshapeFunc(reshapeCallback);
-	glutDisplayFunc(doSomethingCallback);
+	glutDisplayFunc(displayCallback);
 	glutTimerFunc(0, timerFuncCallback, 0);
 	glutWMCloseFunc(windowCloseCallback);
 
 	glutSetOption(GLUT_ACTION_ON_WINDOW_CLOSE, GLUT_ACTION_GLUTMAINLOOP_RETURNS);
+	Trace().nameThisThread("render");
+	m_simThread = thread(&GameController::simulationLoop, this);
 	glutMainLoop();
+
+	  // The main loop also returns if the window was closed, in which case
+	  // the simulation thread may still be running.
+	quitGame();
+	m_simThread.join();
+	finishRun();
+}
+
+void GameController::runHeadless(GameWorld* gw, int msPerTick, const string& frameDir, int frameEvery,
+								 long long ticks)
+{
+	startGame(gw, msPerTick);
+	m_headless = true;
+	m_softwareRenderer.reset(new SoftwareRenderer(WINDOW_WIDTH, WINDOW_HEIGHT));
+	initDrawersAndSounds();
+	SoundFX().start(false);	// only to record it, if asked to
+	frameEvery = max(frameEvery, 1);
+	if (m_replay)
+		ticks = m_replay->endTick - 1;	// the last tick recorded is the one that ended the game
+
+	  // Nothing here has to keep time, so capture waits for the encoder
+	  // rather than dropping frames, and gets one frame per tick.
+	if (!m_capturePath.empty() &&
+		!m_capture.open(m_capturePath, WINDOW_WIDTH, WINDOW_HEIGHT, static_cast<int>(1000000 / m_tickPeriodUs)))
+		ticks = 0;
+
+	long long tick = 0;
+	long long framesDrawn = 0;
+	long long framesSaved = 0;
+	chrono::steady_clock::duration renderTime(0);
+	for ( ; tick < ticks && !m_simFinished; tick++)
+	{
+		if (!m_replay && m_gameState == prompt && m_inputKey == INVALID_KEY && m_lastKeyHit == INVALID_KEY)
+			m_inputKey = '\r';
+		doSomething();
+		publishSnapshot();
+
+		if (m_snapshots.update())
+		{
+			ScopedTimer timer(Profile().phase(phase_sprite_drawing));
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			waitForSprites(m_snapshots.readBuffer());
+			m_softwareRenderer->render(m_snapshots.readBuffer());
+			renderTime += chrono::steady_clock::now() - start;
+			framesDrawn++;
+		}
+		if (framesDrawn == 0)
+			continue;
+		if (m_capture.isOpen())
+		{
+			unsigned char* pixels = m_capture.acquire(true);
+			memcpy(pixels, m_softwareRenderer->pixels(), static_cast<size_t>(WINDOW_WIDTH) * WINDOW_HEIGHT * 4);
+			m_capture.submit(false);
+		}
+		if (!frameDir.empty() && tick % frameEvery == 0)
+		{
+			char name[32];
+			snprintf(name, sizeof(name), "/frame-%06lld.tga", tick);
+			if (!m_softwareRenderer->saveFrame(frameDir + name))
+			{
+				cerr << "Cannot write " << frameDir << name << endl;
+				break;
+			}
+			framesSaved++;
+		}
+	}
+
+	  // Stop a game still in progress, cleaning up its world.
+	if (!m_simFinished)
+	{
+		quitGame();
+		doSomething();
+	}
+
+	cerr << "Headless: " << tick << " ticks, " << framesDrawn << " frames drawn";
+	if (framesDrawn > 0)
+		cerr << " (" << chrono::duration<double, milli>(renderTime).count() / framesDrawn << "ms each)";
+	cerr << ", " << framesSaved << " saved" << endl;
+
+	finishRun();
+}
+
+  // Shared by run and runHeadless once the game is over.
+void GameController::finishRun()
+{
+	SoundFX().stop();
+	if (m_capture.isOpen())
+	{
+		m_capture.close();
+		cerr << "Captured " << m_capture.framesWritten() << " frames to " << m_capturePath;
+		if (m_capture.framesDropped() > 0)
+			cerr << " (" << m_capture.framesDropped() << " dropped while the encoder was busy)";
+		cerr << endl;
+	}
+	if (m_recording)
+	{
+		m_recording->endTick = m_tickCount;
+		if (!m_recording->save(m_recordPath))
+			cerr << "Cannot write replay " << m_recordPath << endl;
+	}
+
 	delete m_gw;
 	reportLeakedGraphObjects();
+	if (!m_headless)
+		m_scheduler.report(cerr);
+	if (Profile().isEnabled())
+		Profile().dump(cerr);
+}
+
+bool GameController::setRecording(const string& path)
+{
+	m_recordPath = path;
+	m_recording.reset(new Replay);
+	ofstream test(path, ios::app);
+	return static_cast<bool>(test);
+}
+
+bool GameController::setReplay(const string& path)
+{
+	m_replay.reset(new Replay);
+	if (m_replay->load(path))
+		return true;
+	m_replay.reset();
+	return false;
 }
 
 void GameController::keyboardEvent(unsigned char key, int /* x */, int /* y */)
 {
 	switch (key)
 	{
-		case 'a': case '4': m_lastKeyHit = KEY_PRESS_LEFT;	break;
-		case 'd': case '6': m_lastKeyHit = KEY_PRESS_RIGHT; break;
-		case 'w': case '8': m_lastKeyHit = KEY_PRESS_UP;	break;
-		case 's': case '2': m_lastKeyHit = KEY_PRESS_DOWN;	break;
-		case 't':			m_lastKeyHit = KEY_PRESS_TAB;	break;
+		case 'a': case '4': m_inputKey = KEY_PRESS_LEFT;	break;
+		case 'd': case '6': m_inputKey = KEY_PRESS_RIGHT;	break;
+		case 'w': case '8': m_inputKey = KEY_PRESS_UP;		break;
+		case 's': case '2': m_inputKey = KEY_PRESS_DOWN;	break;
+		case 't':			m_inputKey = KEY_PRESS_TAB;		break;
 		case 'f':			m_singleStep = true;			break;
 		case 'r':			m_singleStep = false;			break;
+		case '+': case '=':	changeTickRate(2);				break;
+		case '-': case '_':	changeTickRate(0.5);			break;
+		case '0':			setTickPeriod(m_defaultTickPeriod);
+							changeTickRate(1);				break;
+		case 'p':			m_profileDumpRequested = true;	break;
+		case 'u':			setTurbo(!m_turbo, m_turboRenderEvery);
+							cerr << "Turbo " << (m_turbo ? "on" : "off") << endl;
+															break;
 		case 'q': case 'Q': case '\x03':  // CTRL-C
-							setGameState(quit);				break;
-		default:			m_lastKeyHit = key;				break;
+							quitGame();						break;
+		default:			m_inputKey = key;				break;
 	}
+	inputEvent();
 }
 
 void GameController::specialKeyboardEvent(int key, int /* x */, int /* y */)
 {
 	switch (key)
 	{
-		case GLUT_KEY_LEFT:	 m_lastKeyHit = KEY_PRESS_LEFT;	 break;
-		case GLUT_KEY_RIGHT: m_lastKeyHit = KEY_PRESS_RIGHT; break;
-		case GLUT_KEY_UP:	 m_lastKeyHit = KEY_PRESS_UP;	 break;
-		case GLUT_KEY_DOWN:	 m_lastKeyHit = KEY_PRESS_DOWN;	 break;
-		default:			 m_lastKeyHit = INVALID_KEY;	 break;
+		case GLUT_KEY_LEFT:	 m_inputKey = KEY_PRESS_LEFT;	 break;
+		case GLUT_KEY_RIGHT: m_inputKey = KEY_PRESS_RIGHT;	 break;
+		case GLUT_KEY_UP:	 m_inputKey = KEY_PRESS_UP;		 break;
+		case GLUT_KEY_DOWN:	 m_inputKey = KEY_PRESS_DOWN;	 break;
+		default:			 m_inputKey = INVALID_KEY;		 break;
 	}
+	inputEvent();
 }
 
 void GameController::playSound(int soundID)
 {
-	if (soundID == SOUND_NONE)
+	if (soundID < 0 || soundID >= static_cast<int>(m_soundClips.size()))
 		return;
 
-	auto p = m_soundMap.find(soundID);
-	if (p != m_soundMap.end())
-	{
-		string path = m_gw->assetPath();
-		if (!path.empty())
-			path += '/';
-		SoundFX().playClip(path + p->second);
-	}
+	SoundFX().playClip(m_soundClips[soundID]);
 }
 
 void GameController::setGameState(GameControllerState s)
 {
     if (m_gameState != quit)
+    {
+        if (m_gameState != s)
+            Trace().instant("state", "controller", stateNames[s]);
         m_gameState = s;
+    }
+}
+
+  // Input reaches the game only here, at the start of a tick, so a game is
+  // determined by its seed and what arrived on which tick.  That is what a
+  // recording keeps and a replay feeds back in (ignoring the keyboard).
+void GameController::takeInput()
+{
+	long long tick = m_tickCount++;
+	if (m_replay)
+	{
+		const vector<Replay::Event>& events = m_replay->events;
+		for ( ; m_replayNext < events.size() && events[m_replayNext].tick <= tick; m_replayNext++)
+		{
+			const Replay::Event& e = events[m_replayNext];
+			if (e.type == Replay::key)
+				m_lastKeyHit = e.value;
+			else
+				m_stepping = (e.value != 0);
+			if (m_recording)
+				m_recording->add(tick, e.type, e.value);
+		}
+		if (tick + 1 >= m_replay->endTick)
+			quitGame();
+		return;
+	}
+
+	int key = m_inputKey.exchange(INVALID_KEY);
+	if (key != INVALID_KEY)
+	{
+		m_lastKeyHit = key;
+		if (m_recording)
+			m_recording->add(tick, Replay::key, key);
+	}
+	bool stepping = m_singleStep;
+	if (stepping != m_stepping)
+	{
+		m_stepping = stepping;
+		if (m_recording)
+			m_recording->add(tick, Replay::step, stepping);
+	}
 }
 
+  // Safe to call from any thread; the simulation thread acts on it at the
+  // start of its next tick.
 void GameController::quitGame()
 {
-    setGameState(quit);
+	{
+		lock_guard<mutex> lock(m_inputMutex);
+		m_quitRequested = true;
+	}
+	m_inputArrived.notify_one();
 }
 
 void GameController::doSomething()
 {
+	takeInput();
+	SoundFX().advance(chrono::microseconds(m_tickPeriodUs));
+	if (m_quitRequested)
+		setGameState(quit);
+	if (m_profileDumpRequested.exchange(false) && Profile().isEnabled())
+		Profile().dump(cerr);
+
 	switch (m_gameState)
 	{
 		case not_applicable:
@@ -277,7 +725,11 @@ void GameController::doSomething()
 			break;
 		case init:
 			{
-				int status = m_gw->init();
+				int status;
+				{
+					ScopedTrace trace("init", "world");
+					status = m_gw->init();
+				}
 				m_postInitPreCleanup = true;
 				SoundFX().abortClip();
 				switch (status)
@@ -308,7 +760,11 @@ void GameController::doSomething()
 			m_curIntraFrameTick = ANIMATION_POSITIONS_PER_TICK;
 			m_nextStateAfterAnimate = not_applicable;
 			{
-				int status = m_gw->move();
+				int status;
+				{
+					ScopedTrace trace("move", "world");
+					status = m_gw->move();
+				}
 				switch (status)
 				{
 				  case GWSTATUS_PLAYER_DIED:
@@ -329,12 +785,11 @@ void GameController::doSomething()
 			setGameState(animate);
 			break;
 		case animate:
-			displayGamePlay();
 			if (m_curIntraFrameTick-- <= 0)
 			{
 				if (m_nextStateAfterAnimate != not_applicable)
 					setGameState(m_nextStateAfterAnimate);
-				else if (!m_singleStep)
+				else if (!m_stepping)
 					setGameState(makemove);
 				else
 				{
@@ -363,6 +818,7 @@ void GameController::doSomething()
 		case cleanup:
 			if (m_postInitPreCleanup)  // should aways be true here
 			{
+				ScopedTrace trace("cleanUp", "world");
 				m_gw->cleanUp();
 				m_postInitPreCleanup = false;
 			}
@@ -382,14 +838,14 @@ void GameController::doSomething()
 		case quit:
 			if (m_postInitPreCleanup)  // might be false if aborted game
 			{
+				ScopedTrace trace("cleanUp", "world");
 				m_gw->cleanUp();
 				m_postInitPreCleanup = false;
 			}
             SoundFX().abortClip();
-			glutLeaveMainLoop();
+			m_simFinished = true;
 			break;
 		case prompt:
-			drawPrompt(m_mainMessage, m_secondMessage);
 			{
 				int key;
 				if (getKeyIfAny(key) && key == '\r')
@@ -399,62 +855,308 @@ void GameController::doSomething()
 	}
 }
 
+  // Capture what the current state needs drawn and hand it to the GLUT
+  // thread.  Called on the simulation thread at the end of a tick.
+void GameController::publishSnapshot()
+{
+	RenderSnapshot& snapshot = m_snapshots.writeBuffer();
+
+	  // Frames that would look the same as the last one published aren't.
+	switch (m_gameState)
+	{
+		case prompt:
+			if (m_publishedKind == RenderSnapshot::prompt && m_mainMessage == m_publishedMainMessage &&
+				m_secondMessage == m_publishedSecondMessage)
+				return;
+			snapshot.kind = RenderSnapshot::prompt;
+			snapshot.mainMessage = m_mainMessage;
+			snapshot.secondMessage = m_secondMessage;
+			m_publishedMainMessage = m_mainMessage;
+			m_publishedSecondMessage = m_secondMessage;
+			break;
+		case makemove:
+		case animate:
+			if (m_publishedKind == RenderSnapshot::gameplay && !m_gameStatChanged &&
+				m_publishedSceneVersion == GraphObject::getSceneVersion())
+				return;
+			snapshot.kind = RenderSnapshot::gameplay;
+			m_publishedSceneVersion = GraphObject::getSceneVersion();
+			m_gameStatChanged = false;
+			captureGamePlay(snapshot);
+			break;
+		default:
+			  // Transitional states leave the last frame on screen.
+			return;
+	}
+
+	m_publishedKind = snapshot.kind;
+	m_snapshots.publish();
+}
 
-void GameController::displayGamePlay()
+  // Record the sprites in view, back to front.  Called on the simulation
+  // thread.
+void GameController::captureGamePlay(RenderSnapshot& snapshot)
 {
-	glEnable(GL_DEPTH_TEST); // must be done each time before displaying graphics or gets disabled for some reason
-	glLoadIdentity();
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	snapshot.hudText = m_gameStatText;
+	snapshot.sprites.clear();
+	int oldViewX = snapshot.viewX, oldViewY = snapshot.viewY;
+	int oldViewWidth = snapshot.viewWidth, oldViewHeight = snapshot.viewHeight;
+	chooseView(snapshot);
+
+	  // This buffer's static layer (from when it was last written) is still
+	  // good if nothing in the layer has changed and the view hasn't moved.
+	unsigned long long staticVersion = GraphObject::getStaticLayerVersion();
+	bool keepStatic = (snapshot.staticVersion == staticVersion &&
+					   snapshot.viewX == oldViewX && snapshot.viewY == oldViewY &&
+					   snapshot.viewWidth == oldViewWidth && snapshot.viewHeight == oldViewHeight);
+	if (!keepStatic)
+	{
+		snapshot.staticSprites.clear();
+		snapshot.staticVersion = staticVersion;
+	}
+
+	  // Only objects in (or overlapping) the view are visited, found
+	  // through the world's spatial index.
+	m_viewObjects.clear();
+	m_gw->getGraphObjectsIn(snapshot.viewX - 1, snapshot.viewY - 1,
+							snapshot.viewX + snapshot.viewWidth,
+							snapshot.viewY + snapshot.viewHeight, m_viewObjects);
+
+	  // Bucket them by depth in one pass, then record back to front.
+	for (std::vector<GraphObject*>& bucket : m_viewBuckets)
+		bucket.clear();
+	for (GraphObject* cur : m_viewObjects)
+		m_viewBuckets[cur->getDepth()].push_back(cur);
+
+	for (int i = GraphObject::NUM_DEPTHS - 1; i >= 0; --i)
+	{
+		for (GraphObject* cur : m_viewBuckets[i])
+		{
+			if (cur->isStatic() && keepStatic)
+				continue;
+			if (cur->isVisible())
+				cur->animate();
+
+			double x, y;
+			cur->getAnimationLocation(x, y);
+
+			SpriteRecord rec;
+			rec.imageID = cur->getID();
+			rec.x = static_cast<float>(x);
+			rec.y = static_cast<float>(y);
+			rec.direction = cur->getDirection();
+			rec.frame = cur->getAnimationNumber();
+			rec.size = static_cast<float>(cur->getSize());
+			rec.visible = cur->isVisible();
+			rec.depth = i;
+			(cur->isStatic() ? snapshot.staticSprites : snapshot.sprites).push_back(rec);
+		}
+	}
+}
+
+  // Pick the squares the snapshot shows: the whole board if it fits in the
+  // viewport, otherwise a viewport-sized window centered on the world's
+  // camera focus and clamped to the board.
+void GameController::chooseView(RenderSnapshot& snapshot) const
+{
+	int boardWidth = m_gw->getBoardWidth();
+	int boardHeight = m_gw->getBoardHeight();
+	snapshot.viewX = 0;
+	snapshot.viewY = 0;
+	snapshot.viewWidth = boardWidth;
+	snapshot.viewHeight = boardHeight;
+
+	double fx, fy;
+	if (m_viewportCells <= 0  ||  (boardWidth <= m_viewportCells  &&  boardHeight <= m_viewportCells)  ||
+		!m_gw->getCameraFocus(fx, fy))
+		return;
+
+	snapshot.viewWidth = min(boardWidth, m_viewportCells);
+	snapshot.viewHeight = min(boardHeight, m_viewportCells);
+	snapshot.viewX = max(0, min(static_cast<int>(fx) - snapshot.viewWidth / 2, boardWidth - snapshot.viewWidth));
+	snapshot.viewY = max(0, min(static_cast<int>(fy) - snapshot.viewHeight / 2, boardHeight - snapshot.viewHeight));
+}
+
+  // Draw the most recently published snapshot.  Called on the GLUT thread.
+  // Return true if a frame was drawn.
+bool GameController::renderLatestSnapshot(bool redrawIfUnchanged)
+{
+	if (!m_snapshots.update() && !redrawIfUnchanged)
+		return false;
+
+	const RenderSnapshot& snapshot = m_snapshots.readBuffer();
+	m_spritesMissing = false;
+	switch (snapshot.kind)
+	{
+		case RenderSnapshot::prompt:
+			{
+				ScopedTrace trace("drawPrompt", "render");
+				drawPrompt(snapshot.mainMessage, snapshot.secondMessage);
+				presentFrame();
+			}
+			break;
+		case RenderSnapshot::gameplay:
+			{
+				ScopedTrace trace("displayGamePlay", "render");
+				displayGamePlay(snapshot);
+			}
+			break;
+		case RenderSnapshot::nothing:
+			return false;
+	}
+	return true;
+}
+
+void GameController::redisplay()
+{
+	renderLatestSnapshot(true);
+}
+
+void GameController::displayGamePlay(const RenderSnapshot& snapshot)
+{
+	COUNT_GL(glEnable(GL_DEPTH_TEST)); // must be done each time before displaying graphics or gets disabled for some reason
+	COUNT_GL(glLoadIdentity());
 #ifdef _MSC_VER
-    gluLookAt(0, 0, 0, 0, 0, -1, 0, 1, 0);
+    COUNT_GL(gluLookAt(0, 0, 0, 0, 0, -1, 0, 1, 0));
 #else
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
-    gluLookAt(0, 0, 0, 0, 0, -1, 0, 1, 0);
+    COUNT_GL(gluLookAt(0, 0, 0, 0, 0, -1, 0, 1, 0));
 #pragma GCC diagnostic pop
 #endif
+	collectSprites(SPRITE_LOAD_BUDGET);
 
-  std::set<GraphObject*> &graphObjects = GraphObject::getGraphObjects();
+	{
+		ScopedTimer timer(Profile().phase(phase_sprite_drawing));
+		clearToStaticLayer(snapshot);
+		plotSprites(snapshot, snapshot.sprites);
+		m_spriteManager.flushSprites();
+	}
 
-	for (int i = GraphObject::NUM_DEPTHS - 1; i >= 0; --i)
+	if (!snapshot.hudText.empty())
 	{
-		for (auto it = graphObjects.begin(); it != graphObjects.end(); it++)
-		{
-			GraphObject* cur = *it;
-			if (m_imageDepthMap.at(cur->getID()) == i && cur->isVisible())
-			{
-				cur->animate();
+		ScopedTimer timer(Profile().phase(phase_hud_drawing));
+		drawScoreAndLives(snapshot.hudText);
+	}
+
+	ScopedTimer timer(Profile().phase(phase_buffer_swap));
+	presentFrame();
+}
 
-				double x, y, gx, gy, gz;
-				cur->getAnimationLocation(x, y);
-				convertToGlutCoords(x, y, gx, gy, gz);
+void GameController::plotSprites(const RenderSnapshot& snapshot, const vector<SpriteRecord>& sprites)
+{
+	double scale = viewScale(snapshot.viewWidth, snapshot.viewHeight);
 
-				int angle = cur->getDirection();
-				int imageID = cur->getID();
+	  // Pack the positions and convert them all at once.
+	m_spriteXs.resize(sprites.size());
+	m_spriteYs.resize(sprites.size());
+	for (size_t i = 0; i < sprites.size(); i++)
+	{
+		m_spriteXs[i] = sprites[i].x - snapshot.viewX;
+		m_spriteYs[i] = sprites[i].y - snapshot.viewY;
+	}
+	convertToGlutCoords(m_spriteXs.data(), m_spriteYs.data(), sprites.size(), scale);
 
-				m_spriteManager.plotSprite(imageID, cur->getAnimationNumber() % m_spriteManager.getNumFrames(imageID), gx, gy, gz, angle, cur->getSize());
-			}
+	for (size_t i = 0; i < sprites.size(); i++)
+	{
+		const SpriteRecord& cur = sprites[i];
+		if (!cur.visible)
+			continue;
+		  // Rather than wait for a sprite that isn't loaded yet, leave it
+		  // out of this frame.
+		if (!m_spriteLoader.isCollected(cur.imageID))
+		{
+			m_spriteLoader.request(cur.imageID);
+			m_spritesMissing = true;
+			continue;
 		}
+		m_spriteManager.plotSprite(cur.imageID, cur.frame % m_spriteLoader.getNumFrames(cur.imageID), m_spriteXs[i], m_spriteYs[i], SPRITE_GLUT_Z, cur.direction, cur.size / scale, cur.depth);
+	}
+}
+
+  // Clear the frame and draw the snapshot's static layer: if it is dense
+  // enough to be worth caching, from the cached copy if it is of the same
+  // layer at the same view and window size (it covers the whole frame, so
+  // only depth needs clearing), otherwise by drawing its sprites and
+  // caching the result.
+void GameController::clearToStaticLayer(const RenderSnapshot& snapshot)
+{
+	  // A cached layer costs a full-frame blit, which in software GL is
+	  // about what covering a quarter of the view with sprites costs, so
+	  // sparser layers are just drawn with everything else.
+	if (snapshot.staticSprites.size() * 4 < static_cast<size_t>(snapshot.viewWidth) * snapshot.viewHeight)
+	{
+		COUNT_GL(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+		plotSprites(snapshot, snapshot.staticSprites);
+		return;
 	}
 
-	drawScoreAndLives(m_gameStatText);
+	GLint viewport[4];
+	COUNT_GL(glGetIntegerv(GL_VIEWPORT, viewport));
+
+	StaticLayer::Key key;
+	key.version = snapshot.staticVersion;
+	key.viewX = snapshot.viewX;
+	key.viewY = snapshot.viewY;
+	key.viewWidth = snapshot.viewWidth;
+	key.viewHeight = snapshot.viewHeight;
+	key.pixelWidth = viewport[2];
+	key.pixelHeight = viewport[3];
+
+	if (m_staticLayer.matches(key))
+	{
+		COUNT_GL(glClear(GL_DEPTH_BUFFER_BIT));
+		m_staticLayer.draw();
+		return;
+	}
+
+	COUNT_GL(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+	plotSprites(snapshot, snapshot.staticSprites);
+	m_spriteManager.flushSprites();
+	m_staticLayer.capture(key);
+}
+
+void GameController::presentFrame()
+{
+	if (m_capture.isOpen())
+		captureFrame();
+	if (m_present)
+		m_present();
+	else
+		COUNT_GL(glutSwapBuffers());
+}
 
-	glutSwapBuffers();
+  // Hand the frame just drawn to the capture encoder, unless it's still
+  // busy with earlier ones (live play mustn't wait for it) or the window
+  // is no longer the size being captured.
+void GameController::captureFrame()
+{
+	GLint viewport[4];
+	COUNT_GL(glGetIntegerv(GL_VIEWPORT, viewport));
+	if (viewport[2] != m_capture.width() || viewport[3] != m_capture.height())
+		return;
+	unsigned char* pixels = m_capture.acquire(false);
+	if (pixels == nullptr)
+		return;
+	COUNT_GL(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+	COUNT_GL(glReadPixels(0, 0, m_capture.width(), m_capture.height(), GL_RGBA, GL_UNSIGNED_BYTE, pixels));
+	m_capture.submit(true);
 }
 
 void GameController::reportLeakedGraphObjects() const
 {
 	//int totalLeaked = 0;
-	auto& graphObjects = GraphObject::getGraphObjects();
-	if (graphObjects.empty())
+	size_t leaked = GraphObject::getGraphObjectCount();
+	if (leaked == 0)
 		cerr << "No memory leaks were detected." << endl;
 	else
 	{
-		cerr << "***** " << graphObjects.size() << " leaked objects" << endl;
-		for (GraphObject* go : graphObjects)
-			cerr << "At (" << go->getX() << "," << go->getY() << "): "
-						   <<  m_imageNameMap.at(go->m_imageID) << endl;
-		//totalLeaked += graphObjects.size();
+		cerr << "***** " << leaked << " leaked objects" << endl;
+		for (int depth = 0; depth < GraphObject::NUM_DEPTHS; depth++)
+			for (GraphObject* go = GraphObject::firstAtDepth(depth); go != nullptr; go = go->nextAtDepth())
+				cerr << "At (" << go->getX() << "," << go->getY() << "): "
+							   <<  m_imageNameMap.at(go->m_imageID) << endl;
+		//totalLeaked += leaked;
 	}
 	//if (totalLeaked > 0)
 	//	cout << "***** Total leaked objects: " << totalLeaked << endl;
@@ -476,32 +1178,100 @@ void GameController::reshape (int w, int h)
 	glMatrixMode (GL_MODELVIEW);
 }
 
-static void convertToGlutCoords(double x, double y, double& gx, double& gy, double& gz)
+  // Views of more than VIEW_WIDTH x VIEW_HEIGHT squares are shrunk
+  // uniformly so all of them fits.
+static double viewScale(int viewWidth, int viewHeight)
+{
+	return max(1.0, max(double(viewWidth) / VIEW_WIDTH, double(viewHeight) / VIEW_HEIGHT));
+}
+
+  // Convert count board positions (relative to the view) to GLUT
+  // coordinates in place.  The conversion is a scale and offset per axis,
+  // done four positions at a time where SSE is available.
+static void convertToGlutCoords(float* xs, float* ys, size_t count, double scale)
+{
+	const float scaleX = static_cast<float>(2 * (VISIBLE_MAX_X - VISIBLE_MIN_X) / (VIEW_WIDTH * scale));
+	const float scaleY = static_cast<float>(2 * (VISIBLE_MAX_Y - VISIBLE_MIN_Y) / (VIEW_HEIGHT * scale));
+	const float offsetX = static_cast<float>(2 * VISIBLE_MIN_X + .3);
+	const float offsetY = static_cast<float>(2 * VISIBLE_MIN_Y);
+
+	size_t i = 0;
+#ifdef HAVE_SSE
+	const __m128 sx = _mm_set1_ps(scaleX), ox = _mm_set1_ps(offsetX);
+	const __m128 sy = _mm_set1_ps(scaleY), oy = _mm_set1_ps(offsetY);
+	for ( ; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_ps(xs + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(xs + i), sx), ox));
+		_mm_storeu_ps(ys + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(ys + i), sy), oy));
+	}
+#endif
+	for ( ; i < count; i++)
+	{
+		xs[i] = xs[i] * scaleX + offsetX;
+		ys[i] = ys[i] * scaleY + offsetY;
+	}
+}
+
+  // The stroke font compiled into display lists the first time text is
+  // drawn, so a string is one glCallLists instead of a glutStrokeCharacter
+  // call per character.  Glyph c is list base + c; each list ends by
+  // advancing past the glyph, as glutStrokeCharacter does.
+struct StrokeGlyphs
+{
+	static const int NUM_GLYPHS = 128;
+
+	GLuint	base;
+	double	widths[NUM_GLYPHS];
+
+	StrokeGlyphs()
+	{
+		base = glGenLists(NUM_GLYPHS);
+		for (int c = 0; c < NUM_GLYPHS; c++)
+		{
+			widths[c] = glutStrokeWidth(GLUT_STROKE_ROMAN, c);
+			glNewList(base + c, GL_COMPILE);
+			glutStrokeCharacter(GLUT_STROKE_ROMAN, c);
+			glEndList();
+		}
+	}
+
+	double length(const char* str) const
+	{
+		double len = 0;
+		for ( ; *str != '\0'; str++)
+		{
+			unsigned char c = static_cast<unsigned char>(*str);
+			if (c < NUM_GLYPHS)
+				len += widths[c];
+		}
+		return len;
+	}
+};
+
+static const StrokeGlyphs& strokeGlyphs()
 {
-	x /= VIEW_WIDTH;
-	y /= VIEW_HEIGHT;
-	gx = 2 * VISIBLE_MIN_X + .3 + x * 2 * (VISIBLE_MAX_X - VISIBLE_MIN_X);
-	gy = 2 * VISIBLE_MIN_Y +	  y * 2 * (VISIBLE_MAX_Y - VISIBLE_MIN_Y);
-	gz = .6 * VISIBLE_MIN_Z;
+	static StrokeGlyphs glyphs;
+	return glyphs;
 }
 
 static void doOutputStroke(double x, double y, double z, double size, const char* str, bool centered)
 {
+	const StrokeGlyphs& glyphs = strokeGlyphs();
 	if (centered)
 	{
-		double len = glutStrokeLength(GLUT_STROKE_ROMAN, reinterpret_cast<const unsigned char*>(str)) / FONT_SCALEDOWN;
+		double len = glyphs.length(str) / FONT_SCALEDOWN;
 		x = -len / 2;
 		size = 1;
 	}
 	GLfloat scaledSize = static_cast<GLfloat>(size / FONT_SCALEDOWN);
-	glPushMatrix();
-	glLineWidth(1);
-	glLoadIdentity();
-	glTranslatef(static_cast<GLfloat>(x), static_cast<GLfloat>(y), static_cast<GLfloat>(z));
-	glScalef(scaledSize, scaledSize, scaledSize);
-	for ( ; *str != '\0'; str++)
-		glutStrokeCharacter(GLUT_STROKE_ROMAN, *str);
-	glPopMatrix();
+	COUNT_GL(glPushMatrix());
+	COUNT_GL(glLineWidth(1));
+	COUNT_GL(glLoadIdentity());
+	COUNT_GL(glTranslatef(static_cast<GLfloat>(x), static_cast<GLfloat>(y), static_cast<GLfloat>(z)));
+	COUNT_GL(glScalef(scaledSize, scaledSize, scaledSize));
+	COUNT_GL(glListBase(glyphs.base));
+	COUNT_GL(glCallLists(static_cast<GLsizei>(strlen(str)), GL_UNSIGNED_BYTE, str));
+	COUNT_GL(glPopMatrix());
 }
 
 //static void outputStroke(double x, double y, double z, double size, const char* str)
@@ -514,31 +1284,32 @@ static void outputStrokeCentered(double y, double z, const char* str)
 	doOutputStroke(0, y, z, 1, str, true);
 }
 
-static void drawPrompt(string mainMessage, string secondMessage)
+static void drawPrompt(const string& mainMessage, const string& secondMessage)
 {
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glColor3f (1.0, 1.0, 1.0);
 	glLoadIdentity ();
 	outputStrokeCentered(1, -5, mainMessage.c_str());
 	outputStrokeCentered(-1, -5, secondMessage.c_str());
-	glutSwapBuffers();
 }
 
-static void drawScoreAndLives(string gameStatText)
+static void drawScoreAndLives(const string& gameStatText)
 {
 	static int RATE = 1;
 	static GLfloat rgb[3] =
 		{ static_cast<GLfloat>(.6), static_cast<GLfloat>(.6), static_cast<GLfloat>(.6) };
+	  // not randInt, which belongs to the simulation thread (and replays)
+	static minstd_rand shimmer;
 	for (int k = 0; k < 3; k++)
 	{
-		double strength = rgb[k] + randInt(-RATE, RATE) / 100.0;
+		double strength = rgb[k] + uniform_int_distribution<int>(-RATE, RATE)(shimmer) / 100.0;
 		if (strength < .6)
 			strength = .6;
 		else if (strength > 1.0)
 			strength = 1.0;
 		rgb[k] = static_cast<GLfloat>(strength);
 	}
-	glColor3f(rgb[0], rgb[1], rgb[2]);
+	COUNT_GL(glColor3f(rgb[0], rgb[1], rgb[2]));
 	outputStrokeCentered(SCORE_Y, SCORE_Z, gameStatText.c_str());
 }
 
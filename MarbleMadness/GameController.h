@@ -2,13 +2,31 @@
 #define GAMECONTROLLER_H_
 
 #include "SpriteManager.h"
+#include "SpriteLoader.h"
+#include "GraphObject.h"
+#include "StaticLayer.h"
+#include "SoftwareRenderer.h"
+#include "FrameCapture.h"
+#include "Replay.h"
+#include "TickScheduler.h"
+#include "TripleBuffer.h"
+#include "RenderSnapshot.h"
 #include <string>
 #include <map>
+#include <vector>
 #include <iostream>
 #include <sstream>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include <memory>
 const int INVALID_KEY = 0;
 
-class GraphObject;
 class GameWorld;
 
 class GameController
@@ -16,12 +34,70 @@ class GameController
   public:
 	void run(int argc, char* argv[], GameWorld* gw, std::string windowTitle, int msPerTick);
 
+	  // Play without a window or any GL: ticks run back to back and each
+	  // new frame is drawn in memory by a SoftwareRenderer.  If frameDir
+	  // isn't empty, the frame as of every frameEvery'th tick is saved there
+	  // as frame-NNNNNN.tga.  Stops after ticks ticks if the game hasn't
+	  // ended by then.  Nobody is there to press keys, so prompts are
+	  // answered with Enter.
+	void runHeadless(GameWorld* gw, int msPerTick, const std::string& frameDir, int frameEvery,
+					 long long ticks);
+
+	  // Record the game to a replay file when it ends.  Return false if
+	  // the file can't be written.
+	bool setRecording(const std::string& path);
+
+	  // Play back a recorded game instead of taking input (a headless run
+	  // stops where the recording did).  Return false if it can't be read.
+	bool setReplay(const std::string& path);
+
+	  // Capture frames as they are drawn to a .y4m file or a directory of
+	  // PNGs (see FrameCapture).
+	void setCapture(const std::string& path)
+	{
+		m_capturePath = path;
+	}
+
+	  // How many overdue ticks may be run back to back (without rendering)
+	  // when the game falls behind schedule before ticks start being dropped.
+	void setMaxCatchUpTicks(int ticks)
+	{
+		m_scheduler.setMaxCatchUp(ticks);
+	}
+
+	  // Change the tick period while the game is running.  Safe to call
+	  // from any thread.
+	void setTickPeriod(std::chrono::microseconds period);
+
+	  // In turbo mode, gameplay ticks run back to back as fast as possible
+	  // and a frame is published every renderEveryNthTick ticks, or at the
+	  // display refresh rate if that is 0.  Prompts still run at the normal
+	  // tick rate.  Safe to call from any thread.
+	void setTurbo(bool enabled, int renderEveryNthTick = 0)
+	{
+		m_turboRenderEvery = std::max(renderEveryNthTick, 0);
+		m_turbo = enabled;
+	}
+
+	  // Draw sprites in batches (the default) or one at a time.
+	void setSpriteBatching(bool batching)
+	{
+		m_spriteManager.setBatching(batching);
+	}
+
+	  // Show at most cells x cells squares of a bigger board, following the
+	  // world's camera focus; 0 shows the whole board, shrunk to fit.
+	void setViewport(int cells)
+	{
+		m_viewportCells = std::max(cells, 0);
+	}
+
 	bool getKeyIfAny(int& value)
 	{
-		if (m_lastKeyHit != INVALID_KEY)
+		int key = m_lastKeyHit.exchange(INVALID_KEY);
+		if (key != INVALID_KEY)
 		{
-			value = m_lastKeyHit;
-			m_lastKeyHit = INVALID_KEY;
+			value = key;
 			return true;
 		}
 		return false;
@@ -34,14 +110,16 @@ class GameController
 
 	void playSound(int soundID);
 
-	void setGameStatText(std::string text)
+	void setGameStatText(const std::string& text)
 	{
 		m_gameStatText = text;
+		m_gameStatChanged = true;
 	}
 
 	void doSomething();
 
 	void reshape(int w, int h);
+	void redisplay();
 	void keyboardEvent(unsigned char key, int x, int y);
 	void specialKeyboardEvent(int key, int x, int y);
 	static void timerFuncCallback(int);
@@ -56,32 +134,102 @@ class GameController
 	}
 
 private:
+	friend class RenderBenchmark;
+
     enum GameControllerState : int;
 
 	GameWorld*	m_gw;
 	GameControllerState	m_gameState;
 	GameControllerState	m_nextStateAfterPrompt;
 	GameControllerState	m_nextStateAfterAnimate;
-	int			m_lastKeyHit;
-	bool		m_singleStep;
+	std::atomic<int>	m_lastKeyHit;
+	std::atomic<bool>	m_singleStep;
+	std::atomic<bool>	m_quitRequested;
+	std::atomic<bool>	m_simFinished;
+	std::atomic<long long>	m_tickPeriodUs;
+	std::chrono::microseconds	m_defaultTickPeriod;
+	std::atomic<bool>	m_turbo;
+	std::atomic<int>	m_turboRenderEvery;
+	std::atomic<bool>	m_profileDumpRequested;
 	bool		m_postInitPreCleanup;
 	std::string m_gameStatText;
 	std::string m_mainMessage;
 	std::string m_secondMessage;
 	int			m_curIntraFrameTick;
-	using SoundMapType = std::map<int, std::string>;
-	SoundMapType m_soundMap;
+	std::vector<int> m_soundClips;	// each sound's clip (see SoundFXController), or -1
 	std::map<int, std::string> m_imageNameMap;
-	std::map<int, int> m_imageDepthMap;
 	bool		m_playerWon;
 	SpriteManager m_spriteManager;
-	static int m_msPerTick;
+	SpriteLoader m_spriteLoader;
+	bool		m_spritesMissing = false;	// the last frame drawn left out sprites still loading
+	StaticLayer	m_staticLayer;
+	TickScheduler m_scheduler;
+	std::thread	m_simThread;
+	TripleBuffer<RenderSnapshot> m_snapshots;
+	std::function<void()> m_present;	// if empty, glutSwapBuffers
+	bool		m_headless = false;
+	std::unique_ptr<SoftwareRenderer> m_softwareRenderer;	// draws instead of GL when headless
+	FrameCapture m_capture;
+	std::string	m_capturePath;
+
+	  // Keys and single stepping reach the game at the start of a tick
+	  // (see takeInput): m_inputKey and m_singleStep are set from the GLUT
+	  // thread, m_lastKeyHit and m_stepping are what the game sees.
+	std::atomic<int>	m_inputKey;
+	bool		m_stepping = false;
+	long long	m_tickCount = 0;
+	std::unique_ptr<Replay> m_recording;
+	std::string	m_recordPath;
+	std::unique_ptr<Replay> m_replay;
+	size_t		m_replayNext = 0;
+	int			m_viewportCells = VIEW_WIDTH;
+	std::vector<GraphObject*> m_viewObjects;	// scratch for captureGamePlay
+	std::vector<GraphObject*> m_viewBuckets[GraphObject::NUM_DEPTHS];
+	std::vector<float>	m_spriteXs;		// scratch for plotSprites
+	std::vector<float>	m_spriteYs;
+
+	  // What was last published, so unchanged frames aren't published
+	  // (and so aren't redrawn).  Simulation thread only.
+	bool		m_gameStatChanged = true;
+	RenderSnapshot::Kind m_publishedKind = RenderSnapshot::nothing;
+	unsigned long long m_publishedSceneVersion = 0;
+	std::string	m_publishedMainMessage;
+	std::string	m_publishedSecondMessage;
+
+	  // Wakes the simulation thread when it is idle waiting for a key
+	std::mutex	m_inputMutex;
+	std::condition_variable m_inputArrived;
+
+	  // Render polling, which slows down when no frames are arriving.
+	  // GLUT thread only.
+	int			m_idlePolls = 0;
+	int			m_pollGeneration = 0;
 
     void setGameState(GameControllerState s);
-
+	void startGame(GameWorld* gw, int msPerTick);
+	void finishRun();
+	void takeInput();
+
+	void simulationLoop();
+	bool inTurboGamePlay() const;
+	void changeTickRate(double factor);
+	void publishSnapshot();
+	void captureGamePlay(RenderSnapshot& snapshot);
+	void chooseView(RenderSnapshot& snapshot) const;
+	bool renderLatestSnapshot(bool redrawIfUnchanged);
+	bool waitingForKey() const;
+	void waitForInput();
+	void inputEvent();
 	void initDrawersAndSounds();
+	static void imageSpawned(int imageID);
+	void collectSprites(std::chrono::microseconds budget);
+	void waitForSprites(const RenderSnapshot& snapshot);
 	bool passesThruWhenSingleStepping(int key) const;
-	void displayGamePlay();
+	void displayGamePlay(const RenderSnapshot& snapshot);
+	void plotSprites(const RenderSnapshot& snapshot, const std::vector<SpriteRecord>& sprites);
+	void clearToStaticLayer(const RenderSnapshot& snapshot);
+	void presentFrame();
+	void captureFrame();
 	void reportLeakedGraphObjects() const;
 
 };
@@ -1,11 +1,18 @@
 #include "GameWorld.h"
 #include "GameController.h"
+#include "GraphObject.h"
 #include <string>
 #include <cstdlib>
 using namespace std;
 
+  // A world without a controller runs headless (e.g., in benchmarks):
+  // no keys, no sound, no status line.
+
 bool GameWorld::getKey(int& value)
 {
+	if (m_controller == nullptr)
+		return false;
+
 	bool gotKey = m_controller->getKeyIfAny(value);
 
 	if (gotKey)
@@ -18,10 +25,25 @@ bool GameWorld::getKey(int& value)
 
 void GameWorld::playSound(int soundID)
 {
-	m_controller->playSound(soundID);
+	if (m_controller != nullptr)
+		m_controller->playSound(soundID);
 }
 
-void GameWorld::setGameStatText(string text)
+void GameWorld::setGameStatText(const string& text)
 {
-	m_controller->setGameStatText(text);
+	if (m_controller != nullptr)
+		m_controller->setGameStatText(text);
+}
+
+void GameWorld::getGraphObjectsIn(int minX, int minY, int maxX, int maxY,
+								  vector<GraphObject*>& objects) const
+{
+	for (int depth = GraphObject::NUM_DEPTHS - 1; depth >= 0; depth--)
+	{
+		for (GraphObject* go = GraphObject::firstAtDepth(depth); go != nullptr; go = go->nextAtDepth())
+		{
+			if (go->getX() >= minX  &&  go->getX() <= maxX  &&  go->getY() >= minY  &&  go->getY() <= maxY)
+				objects.push_back(go);
+		}
+	}
 }
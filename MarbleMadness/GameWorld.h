@@ -3,10 +3,12 @@
 
 #include "GameConstants.h"
 #include <string>
+#include <vector>
 
 const int START_PLAYER_LIVES = 3;
 
 class GameController;
+class GraphObject;
 
 class GameWorld
 {
@@ -14,6 +16,7 @@ public:
 
 	GameWorld(std::string assetPath)
 	 : m_lives(START_PLAYER_LIVES), m_score(0), m_level(0),
+	   m_boardWidth(VIEW_WIDTH), m_boardHeight(VIEW_HEIGHT),
 	   m_controller(nullptr), m_assetPath(assetPath)
 	{
 	}
@@ -26,7 +29,21 @@ public:
 	virtual int move() = 0;
 	virtual void cleanUp() = 0;
 
-	void setGameStatText(std::string text);
+	void setGameStatText(const std::string& text);
+
+	  // Add to objects every GraphObject that may be on a square in the
+	  // rectangle.  This default checks every object; worlds with a
+	  // spatial index override it so only the squares asked about are
+	  // visited when a camera shows part of a big board.
+	virtual void getGraphObjectsIn(int minX, int minY, int maxX, int maxY,
+								   std::vector<GraphObject*>& objects) const;
+
+	  // Set x,y to where the camera should be centered, or return false if
+	  // nothing in the world needs following.
+	virtual bool getCameraFocus(double& /*x*/, double& /*y*/) const
+	{
+		return false;
+	}
 
 	bool getKey(int& value);
 	void playSound(int soundID);
@@ -71,6 +88,23 @@ public:
 		++m_level;
 	}
  
+	  // The current level's dimensions, which may exceed the view's
+	void setBoardSize(int width, int height)
+	{
+		m_boardWidth = width;
+		m_boardHeight = height;
+	}
+
+	int getBoardWidth() const
+	{
+		return m_boardWidth;
+	}
+
+	int getBoardHeight() const
+	{
+		return m_boardHeight;
+	}
+
 	void setController(GameController* controller)
 	{
 		m_controller = controller;
@@ -85,6 +119,8 @@ private:
 	int				m_lives;
 	int				m_score;
 	int				m_level;
+	int				m_boardWidth;
+	int				m_boardHeight;
 	GameController* m_controller;
 	std::string		m_assetPath;
 };
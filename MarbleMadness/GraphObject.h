@@ -4,8 +4,9 @@
 #include "SpriteManager.h"
 #include "GameConstants.h"
 
-#include <set>
 #include <cmath>
+#include <cstddef>
+#include <vector>
 
 const int ANIMATION_POSITIONS_PER_TICK = 1;
 
@@ -19,6 +20,9 @@ class GraphObject
 	static const int up = 90;
 	static const int down = 270;
 
+	  // Depths run from 0 (front) to NUM_DEPTHS-1 (back)
+	static const int NUM_DEPTHS = 4;
+
 	GraphObject(int imageID, double startX, double startY, int dir = 0, double size = 1.0)
 	 : m_imageID(imageID), m_visible(true), m_x(startX), m_y(startY),
 	   m_destX(startX), m_destY(startY), m_brightness(1.0),
@@ -27,23 +31,39 @@ class GraphObject
 		if (m_size <= 0)
 			m_size = 1;
 
-		getGraphObjects().insert(this);
+		m_depth = imageDepth(imageID);
+		m_static = isStaticImage(imageID);
+		noteSpawned(imageID);
+		changed();
+		DepthList& list = depthList(m_depth);
+		m_prevAtDepth = list.tail;
+		m_nextAtDepth = nullptr;
+		(list.tail != nullptr ? list.tail->m_nextAtDepth : list.head) = this;
+		list.tail = this;
+		list.count++;
 		setVisible(true);
 	}
 
 	virtual ~GraphObject()
 	{
-		getGraphObjects().erase(this);
+		changed();
+		DepthList& list = depthList(m_depth);
+		(m_prevAtDepth != nullptr ? m_prevAtDepth->m_nextAtDepth : list.head) = m_nextAtDepth;
+		(m_nextAtDepth != nullptr ? m_nextAtDepth->m_prevAtDepth : list.tail) = m_prevAtDepth;
+		list.count--;
 	}
 
 	void setVisible(bool shouldIDisplay)
 	{
+		if (m_visible != shouldIDisplay)
+			changed();
 		m_visible = shouldIDisplay;
 	}
 
 	void setBrightness(double brightness)
 	{
 		m_brightness = brightness;
+		changed();
 	}
 
 	double getX() const
@@ -60,6 +80,7 @@ class GraphObject
 
 	virtual void moveTo(double x, double y)
 	{
+		changed();
 		m_destX = x;
 		m_destY = y;
 		increaseAnimationNumber();
@@ -97,11 +118,13 @@ class GraphObject
 			d += 360;
 
 		m_direction = d % 360;
+		changed();
 	}
 
 	void setSize(double size)
 	{
 		m_size = size;
+		changed();
 	}
 
 	double getSize() const
@@ -144,15 +167,71 @@ class GraphObject
 		//moveALittle(m_y, m_destY);
 	}
 
-	static std::set<GraphObject*>& getGraphObjects()
+	  // Live GraphObjects are kept in a list per depth, linked through the
+	  // objects themselves in creation order, so creating or destroying one
+	  // is O(1) and drawing can walk them depth by depth.
+	static GraphObject* firstAtDepth(int depth)
+	{
+		return depthList(depth).head;
+	}
+
+	GraphObject* nextAtDepth() const
+	{
+		return m_nextAtDepth;
+	}
+
+	static size_t getGraphObjectCount()
+	{
+		size_t count = 0;
+		for (int d = 0; d < NUM_DEPTHS; d++)
+			count += depthList(d).count;
+		return count;
+	}
+
+	  // The depth objects with this image are drawn at.  Set before any
+	  // such object is created; unregistered images are at depth 0.
+	static void setImageDepth(int imageID, int depth)
+	{
+		if (imageID >= 0)
+			imageInfo(imageID).depth = (depth < 0 ? 0 : depth >= NUM_DEPTHS ? NUM_DEPTHS - 1 : depth);
+	}
+
+	  // Mark objects with this image as part of the static layer: things
+	  // like walls that rarely appear, disappear or change, which the
+	  // renderer draws once and reuses.  Set before any such object is
+	  // created.
+	static void setImageStatic(int imageID, bool isStatic)
+	{
+		if (imageID >= 0)
+			imageInfo(imageID).isStatic = isStatic;
+	}
+
+	  // Have callback called (on the thread creating objects) the first
+	  // time an object with each image is created, so the image can be
+	  // loaded before it is drawn.
+	using SpawnCallback = void (*)(int imageID);
+	static void setFirstSpawnCallback(SpawnCallback callback)
+	{
+		firstSpawnCallback() = callback;
+	}
+
+	  // Changes whenever any object is created, destroyed, moved, turned,
+	  // resized, shown, hidden or animated, so a frame needs redrawing
+	static unsigned long long getSceneVersion()
 	{
-		static std::set<GraphObject*> graphObjects;
-		return graphObjects;
+		return sceneVersion();
+	}
+
+	  // Changes whenever an object in the static layer does
+	static unsigned long long getStaticLayerVersion()
+	{
+		return staticLayerVersion();
 	}
 
 	void increaseAnimationNumber()
 	{
 		m_animationNumber++;
+		changed();
 	}
 
 
@@ -163,12 +242,28 @@ private:
 		return m_imageID;
 	}
 
+	int getDepth() const
+	{
+		return m_depth;
+	}
+
+	bool isStatic() const
+	{
+		return m_static;
+	}
+
   private:
 	  // Prevent copying or assigning GraphObjects
 	GraphObject(const GraphObject&);
 	GraphObject& operator=(const GraphObject&);
 
-	static const int NUM_DEPTHS = 4;
+	struct DepthList
+	{
+		GraphObject*	head = nullptr;
+		GraphObject*	tail = nullptr;
+		size_t			count = 0;
+	};
+
 	int		m_imageID;
 	bool	m_visible;
 	double	m_x;
@@ -179,6 +274,86 @@ private:
 	int	m_animationNumber;
 	int	m_direction;
 	double	m_size;
+	int		m_depth;
+	bool	m_static;
+	GraphObject*	m_prevAtDepth;
+	GraphObject*	m_nextAtDepth;
+
+	static DepthList& depthList(int depth)
+	{
+		static DepthList lists[NUM_DEPTHS];
+		return lists[depth];
+	}
+
+	struct ImageInfo
+	{
+		int		depth = 0;
+		bool	isStatic = false;
+		bool	spawned = false;
+	};
+
+	static std::vector<ImageInfo>& imageInfos()
+	{
+		static std::vector<ImageInfo> infos;
+		return infos;
+	}
+
+	static ImageInfo& imageInfo(int imageID)
+	{
+		std::vector<ImageInfo>& infos = imageInfos();
+		if (static_cast<size_t>(imageID) >= infos.size())
+			infos.resize(imageID + 1);
+		return infos[imageID];
+	}
+
+	static int imageDepth(int imageID)
+	{
+		const std::vector<ImageInfo>& infos = imageInfos();
+		return (imageID >= 0 && static_cast<size_t>(imageID) < infos.size() ? infos[imageID].depth : 0);
+	}
+
+	static bool isStaticImage(int imageID)
+	{
+		const std::vector<ImageInfo>& infos = imageInfos();
+		return imageID >= 0 && static_cast<size_t>(imageID) < infos.size() && infos[imageID].isStatic;
+	}
+
+	static SpawnCallback& firstSpawnCallback()
+	{
+		static SpawnCallback callback = nullptr;
+		return callback;
+	}
+
+	static void noteSpawned(int imageID)
+	{
+		if (imageID < 0 || firstSpawnCallback() == nullptr)
+			return;
+		ImageInfo& info = imageInfo(imageID);
+		if (!info.spawned)
+		{
+			info.spawned = true;
+			firstSpawnCallback()(imageID);
+		}
+	}
+
+	static unsigned long long& sceneVersion()
+	{
+		static unsigned long long version = 0;
+		return version;
+	}
+
+	static unsigned long long& staticLayerVersion()
+	{
+		static unsigned long long version = 0;
+		return version;
+	}
+
+	void changed()
+	{
+		sceneVersion()++;
+		if (m_static)
+			staticLayerVersion()++;
+	}
 
 	void moveALittle(double& from, double& to)
 	{
@@ -2,10 +2,11 @@
 #define LEVEL_H_
 
 #include "GameConstants.h"
+#include "AssetArchive.h"
 #include <iostream>
-#include <fstream>
 #include <string>
 #include <cctype>
+#include <vector>
 
 class Level
 {
@@ -20,47 +21,61 @@ public:
 		load_success, load_fail_file_not_found, load_fail_bad_format};
 
 	Level(std::string assetDir)
-	 : m_pathPrefix(assetDir)
+	 : m_width(0), m_height(0), m_pathPrefix(assetDir)
 	{
-		for (int y = 0; y < VIEW_HEIGHT; y++)
-			for (int x = 0; x < VIEW_WIDTH; x++)
-				m_maze[y][x] = empty;
-
 		if (!m_pathPrefix.empty())
 			m_pathPrefix += '/';
 	}
 
+	  // The board is as wide as the first line (ignoring trailing blanks)
+	  // and as tall as the number of lines up to the first blank one.
+	  // Every row must be at least that wide, with only blanks after it.
 	LoadResult loadLevel(std::string filename)
 	{
-		std::ifstream levelFile((m_pathPrefix + filename).c_str());
-		if (!levelFile)
+		AssetStream levelFile;
+		if (!levelFile.open(m_pathPrefix, filename))
 			return load_fail_file_not_found;
 
 		  // get the maze
 
+		std::vector<std::string> rows;
 		std::string line;
-		bool foundExit = false;
-		bool foundPlayer = false;
-
-		for (int y = VIEW_HEIGHT-1; std::getline(levelFile, line); y--)
+		while (std::getline(levelFile, line))
 		{
-			if (y < 0)	// too many maze lines?
+			if (line.find_first_not_of(" \t\r") == std::string::npos)
 			{
-				if (line.find_first_not_of(" \t\r") != std::string::npos)
-					return load_fail_bad_format;  // non-blank line
 				char dummy;
 				if (levelFile >> dummy)	 // non-blank rest of file
-				return load_fail_bad_format;
+					return load_fail_bad_format;
 				break;
 			}
+			rows.push_back(line);
+		}
 
-			if (line.size() < VIEW_WIDTH  ||  line.find_first_not_of(" \t\r", VIEW_WIDTH) != std::string::npos)
+		if (rows.empty())
+			return load_fail_bad_format;
+		int width = static_cast<int>(rows[0].find_last_not_of(" \t\r") + 1);
+		int height = static_cast<int>(rows.size());
+		if (width > MAX_BOARD_WIDTH  ||  height > MAX_BOARD_HEIGHT)
+			return load_fail_bad_format;
+
+		m_width = width;
+		m_height = height;
+		m_maze.assign(static_cast<size_t>(m_width) * m_height, empty);
+
+		bool foundExit = false;
+		bool foundPlayer = false;
+
+		for (int y = m_height-1, r = 0; y >= 0; y--, r++)
+		{
+			const std::string& row = rows[r];
+			if (row.size() < size_t(m_width)  ||  row.find_first_not_of(" \t\r", m_width) != std::string::npos)
 				return load_fail_bad_format;
 				
-			for (int x = 0; x < VIEW_WIDTH; x++)
+			for (int x = 0; x < m_width; x++)
 			{
 				MazeEntry me;
-				switch (tolower(line[x]))
+				switch (tolower(row[x]))
 				{
 					default:   return load_fail_bad_format;
 					case ' ':  me = empty; break;
@@ -78,7 +93,7 @@ public:
 					case 'e':  me = extra_life; break;
 					case 'a':  me = ammo; break;
 				}
-				m_maze[y][x] = me;
+				m_maze[cell(x, y)] = me;
 			}
 		}
 
@@ -88,25 +103,42 @@ public:
 		return load_success;
 	}
 
+	int getWidth() const
+	{
+		return m_width;
+	}
+
+	int getHeight() const
+	{
+		return m_height;
+	}
+
 	MazeEntry getContentsOf(int x, int y) const
 	{
-		if (x < 0  ||  x >= VIEW_WIDTH  ||  y < 0  ||  y >= VIEW_HEIGHT)
+		if (x < 0  ||  x >= m_width  ||  y < 0  ||  y >= m_height)
 			return empty;
-		return m_maze[y][x];
+		return m_maze[cell(x, y)];
 	}
 
 private:
 
-	MazeEntry	m_maze[VIEW_HEIGHT][VIEW_WIDTH];
-	std::string m_pathPrefix;
+	int						m_width;
+	int						m_height;
+	std::vector<MazeEntry>	m_maze;		// row-major, bottom row first
+	std::string				m_pathPrefix;
+
+	size_t cell(int x, int y) const
+	{
+		return static_cast<size_t>(y) * m_width + x;
+	}
 
 	bool edgesValid() const
 	{
-		for (int y = 0; y < VIEW_HEIGHT; y++)
-			if (m_maze[y][0] != wall || m_maze[y][VIEW_WIDTH-1] != wall)
+		for (int y = 0; y < m_height; y++)
+			if (m_maze[cell(0, y)] != wall || m_maze[cell(m_width-1, y)] != wall)
 				return false;
-		for (int x = 0; x < VIEW_WIDTH; x++)
-			if (m_maze[0][x] != wall || m_maze[VIEW_HEIGHT-1][x] != wall)
+		for (int x = 0; x < m_width; x++)
+			if (m_maze[cell(x, 0)] != wall || m_maze[cell(x, m_height-1)] != wall)
 				return false;
 
 		return true;
@@ -0,0 +1,137 @@
+#ifndef LEVELGENERATOR_H_
+#define LEVELGENERATOR_H_
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+  // Builds synthetic levels in the text format Level::loadLevel reads,
+  // for benchmarks and stress tests.  The same seed always produces the
+  // same level.
+
+class LevelGenerator
+{
+  public:
+	LevelGenerator(int width, int height, unsigned int seed)
+	 : m_width(width), m_height(height), m_cells(width * height, ' '), m_rng(seed)
+	{
+		for (int x = 0; x < m_width; x++)
+			set(x, 0, '#'), set(x, m_height - 1, '#');
+		for (int y = 0; y < m_height; y++)
+			set(0, y, '#'), set(m_width - 1, y, '#');
+	}
+
+	int getWidth() const { return m_width; }
+	int getHeight() const { return m_height; }
+
+	char at(int x, int y) const
+	{
+		return m_cells[y * m_width + x];
+	}
+
+	void set(int x, int y, char c)
+	{
+		m_cells[y * m_width + x] = c;
+	}
+
+	  // Fill the interior with walls and carve a perfect maze out of it
+	  // (randomized depth-first search over the odd-coordinate cells).
+	void carveMaze()
+	{
+		for (int y = 1; y < m_height - 1; y++)
+			for (int x = 1; x < m_width - 1; x++)
+				set(x, y, '#');
+
+		static const int dx[] = { 2, -2, 0, 0 };
+		static const int dy[] = { 0, 0, 2, -2 };
+		std::vector<std::pair<int, int>> stack;
+		stack.emplace_back(1, 1);
+		set(1, 1, ' ');
+		while (!stack.empty())
+		{
+			int x = stack.back().first;
+			int y = stack.back().second;
+			int options[4];
+			int n = 0;
+			for (int d = 0; d < 4; d++)
+			{
+				int nx = x + dx[d];
+				int ny = y + dy[d];
+				if (nx > 0 && nx < m_width - 1 && ny > 0 && ny < m_height - 1 && at(nx, ny) == '#')
+					options[n++] = d;
+			}
+			if (n == 0)
+			{
+				stack.pop_back();
+				continue;
+			}
+			int d = options[std::uniform_int_distribution<int>(0, n - 1)(m_rng)];
+			set(x + dx[d] / 2, y + dy[d] / 2, ' ');
+			set(x + dx[d], y + dy[d], ' ');
+			stack.emplace_back(x + dx[d], y + dy[d]);
+		}
+	}
+
+	  // Put the player in a one-cell pocket in the lower left corner, so
+	  // robots can neither reach nor shoot it and a benchmark can run for
+	  // as long as it likes.
+	void placeSealedPlayer()
+	{
+		set(1, 1, '@');
+		set(2, 1, '#');
+		set(1, 2, '#');
+	}
+
+	  // Place up to count copies of what on random empty interior squares.
+	  // Return how many were placed.
+	int scatter(char what, int count)
+	{
+		std::vector<std::pair<int, int>> cells = emptyCells();
+		std::shuffle(cells.begin(), cells.end(), m_rng);
+		int placed = 0;
+		for ( ; placed < count && placed < static_cast<int>(cells.size()); placed++)
+			set(cells[placed].first, cells[placed].second, what);
+		return placed;
+	}
+
+	std::vector<std::pair<int, int>> emptyCells() const
+	{
+		std::vector<std::pair<int, int>> cells;
+		for (int y = 1; y < m_height - 1; y++)
+			for (int x = 1; x < m_width - 1; x++)
+				if (at(x, y) == ' ')
+					cells.emplace_back(x, y);
+		return cells;
+	}
+
+	  // The level as text; the first line is the top row (highest y).
+	std::string text() const
+	{
+		std::string result;
+		result.reserve((m_width + 1) * m_height);
+		for (int y = m_height - 1; y >= 0; y--)
+		{
+			result.append(&m_cells[y * m_width], m_width);
+			result += '\n';
+		}
+		return result;
+	}
+
+	bool writeTo(const std::string& path) const
+	{
+		std::ofstream out(path.c_str(), std::ios::binary);
+		out << text();
+		return static_cast<bool>(out);
+	}
+
+  private:
+	int					m_width;
+	int					m_height;
+	std::vector<char>	m_cells;
+	std::mt19937		m_rng;
+};
+
+#endif // LEVELGENERATOR_H_
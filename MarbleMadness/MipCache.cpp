@@ -0,0 +1,269 @@
+#include "MipCache.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HAVE_SSE2
+#endif
+using namespace std;
+
+namespace {
+
+template <typename T>
+void put(ostream& out, T value)
+{
+	for (size_t i = 0; i < sizeof(T); i++)
+		out.put(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+template <typename T>
+bool get(istream& in, T& value)
+{
+	unsigned char bytes[sizeof(T)];
+	if (!in.read(reinterpret_cast<char*>(bytes), sizeof(T)))
+		return false;
+	value = 0;
+	for (size_t i = 0; i < sizeof(T); i++)
+		value |= static_cast<T>(bytes[i]) << (8 * i);
+	return true;
+}
+
+}  // namespace
+
+MipCache::MipCache()
+{
+#if defined(_WIN32)
+	const char* base = getenv("LOCALAPPDATA");
+	if (base != nullptr)
+		m_dir = string(base) + "/MarbleMadness/mipcache";
+#else
+	const char* base = getenv("XDG_CACHE_HOME");
+	if (base != nullptr && *base != '\0')
+		m_dir = string(base) + "/marblemadness/mipcache";
+	else if ((base = getenv("HOME")) != nullptr)
+		m_dir = string(base) + "/.cache/marblemadness/mipcache";
+#endif
+}
+
+bool MipCache::load(const Source& source, int size, vector<char>& chain) const
+{
+	if (m_dir.empty())
+		return false;
+	ifstream in(pathFor(source.hash, size), ios::binary);
+	char magic[4];
+	uint32_t version, storedSize, width, height;
+	uint64_t bytes;
+	if (!in.read(magic, 4) || memcmp(magic, "MMMP", 4) != 0 || !get(in, version) || version != VERSION ||
+		!get(in, storedSize) || storedSize != static_cast<uint32_t>(size) ||
+		!get(in, bytes) || bytes != source.bytes ||
+		!get(in, width) || width != source.width || !get(in, height) || height != source.height)
+		return false;
+	chain.resize(chainBytes(size));
+	return static_cast<bool>(in.read(chain.data(), chain.size())) && in.peek() == EOF;
+}
+
+void MipCache::store(const Source& source, int size, const vector<char>& chain) const
+{
+	if (m_dir.empty())
+		return;
+	error_code ec;
+	filesystem::create_directories(m_dir, ec);
+
+	  // Write under a temporary name and rename, so a reader never sees a
+	  // partly written file.
+	string path = pathFor(source.hash, size);
+	string temp = path + ".tmp" + to_string(random_device()());
+	{
+		ofstream out(temp, ios::binary);
+		out.write("MMMP", 4);
+		put(out, VERSION);
+		put(out, static_cast<uint32_t>(size));
+		put(out, source.bytes);
+		put(out, source.width);
+		put(out, source.height);
+		out.write(chain.data(), chain.size());
+		if (!out)
+		{
+			out.close();
+			remove(temp.c_str());
+			return;
+		}
+	}
+	filesystem::rename(temp, path, ec);
+	if (ec)
+		remove(temp.c_str());
+}
+
+string MipCache::pathFor(uint64_t key, int size) const
+{
+	char name[48];
+	snprintf(name, sizeof(name), "/%016llx-%d.mip", static_cast<unsigned long long>(key), size);
+	return m_dir + name;
+}
+
+size_t MipCache::chainBytes(int size)
+{
+	size_t bytes = 0;
+	for (int s = size; s >= 1; s /= 2)
+		bytes += static_cast<size_t>(s) * s * 4;
+	return bytes;
+}
+
+void MipCache::buildChain(int size, vector<char>& chain)
+{
+	chain.resize(chainBytes(size));
+	unsigned char* level = reinterpret_cast<unsigned char*>(chain.data());
+	for (int s = size; s > 1; s /= 2)
+	{
+		unsigned char* next = level + static_cast<size_t>(s) * s * 4;
+		halve(level, s, s, next);
+		level = next;
+	}
+}
+
+void MipCache::halve(const unsigned char* src, int width, int height, unsigned char* dst)
+{
+	if (width == 1 || height == 1)
+	{
+		  // A single row or column: average pairs (truncating, like GLU)
+		int n = max(width, height) / 2;
+		for (int i = 0; i < n; i++)
+			for (int c = 0; c < 4; c++)
+				dst[i * 4 + c] = static_cast<unsigned char>((src[i * 8 + c] + src[i * 8 + 4 + c]) / 2);
+		return;
+	}
+
+	const int outWidth = width / 2;
+	const int outHeight = height / 2;
+	const size_t rowBytes = static_cast<size_t>(width) * 4;
+	for (int y = 0; y < outHeight; y++)
+	{
+		const unsigned char* r0 = src + 2 * y * rowBytes;
+		const unsigned char* r1 = r0 + rowBytes;
+		unsigned char* out = dst + static_cast<size_t>(y) * outWidth * 4;
+		int x = 0;
+#ifdef HAVE_SSE2
+		  // Widen to 16 bits, add the two rows, then add each pixel to its
+		  // neighbor: eight source pixels per row make four outputs.
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i two = _mm_set1_epi16(2);
+		auto pairSums = [&](__m128i a, __m128i b) {
+			__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+			__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+			lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+			hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+			return _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), two), 2);
+		};
+		for ( ; x + 4 <= outWidth; x += 4)
+		{
+			const __m128i* a = reinterpret_cast<const __m128i*>(r0 + x * 8);
+			const __m128i* b = reinterpret_cast<const __m128i*>(r1 + x * 8);
+			__m128i first = pairSums(_mm_loadu_si128(a), _mm_loadu_si128(b));
+			__m128i second = pairSums(_mm_loadu_si128(a + 1), _mm_loadu_si128(b + 1));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), _mm_packus_epi16(first, second));
+		}
+#endif
+		for ( ; x < outWidth; x++)
+			for (int c = 0; c < 4; c++)
+				out[x * 4 + c] = static_cast<unsigned char>(
+					(r0[x * 8 + c] + r0[x * 8 + 4 + c] + r1[x * 8 + c] + r1[x * 8 + 4 + c] + 2) / 4);
+	}
+}
+
+void MipCache::scale(const unsigned char* src, int width, int height, int size, unsigned char* dst)
+{
+	  // GLU widens each component to 16 bits (times 257) and narrows the
+	  // result by dropping the low byte; doing the same, with the same
+	  // float arithmetic, gives the same texels.
+	vector<unsigned short> in(static_cast<size_t>(width) * height * 4);
+	for (size_t i = 0; i < in.size(); i++)
+		in[i] = static_cast<unsigned short>(src[i] * 257);
+
+	if (width == size * 2 && height == size * 2)
+	{
+		const size_t rowComponents = static_cast<size_t>(width) * 4;
+		for (int y = 0; y < size; y++)
+			for (int x = 0; x < size; x++)
+				for (int c = 0; c < 4; c++)
+				{
+					const unsigned short* t = &in[2 * y * rowComponents + x * 8 + c];
+					dst[(static_cast<size_t>(y) * size + x) * 4 + c] = static_cast<unsigned char>(
+						((t[0] + t[4] + t[rowComponents] + t[rowComponents + 4] + 2) / 4) >> 8);
+				}
+		return;
+	}
+
+	  // Each output texel is the area-weighted average of the input texels
+	  // under its box: the output texel's footprint when shrinking, a
+	  // texel-sized box around its center when enlarging.  Boxes hanging
+	  // off an edge wrap around, as GLU's do.
+	const float convx = static_cast<float>(width) / size;
+	const float convy = static_cast<float>(height) / size;
+	const float halfconvx = convx / 2;
+	const float halfconvy = convy / 2;
+	for (int i = 0; i < size; i++)
+	{
+		float y = convy * (i + 0.5);
+		float lowy, highy;
+		if (height > size)
+		{
+			highy = y + halfconvy;
+			lowy = y - halfconvy;
+		}
+		else
+		{
+			highy = y + 0.5;
+			lowy = y - 0.5;
+		}
+		for (int j = 0; j < size; j++)
+		{
+			float x = convx * (j + 0.5);
+			float lowx, highx;
+			if (width > size)
+			{
+				highx = x + halfconvx;
+				lowx = x - halfconvx;
+			}
+			else
+			{
+				highx = x + 0.5;
+				lowx = x - 0.5;
+			}
+
+			float totals[4] = { 0, 0, 0, 0 };
+			float area = 0;
+			y = lowy;
+			int yint = static_cast<int>(floor(y));
+			while (y < highy)
+			{
+				int yindex = (yint + height) % height;
+				float ypercent = highy < yint + 1 ? highy - y : yint + 1 - y;
+				x = lowx;
+				int xint = static_cast<int>(floor(x));
+				while (x < highx)
+				{
+					int xindex = (xint + width) % width;
+					float xpercent = highx < xint + 1 ? highx - x : xint + 1 - x;
+					float percent = xpercent * ypercent;
+					area += percent;
+					const unsigned short* texel = &in[(static_cast<size_t>(yindex) * width + xindex) * 4];
+					for (int c = 0; c < 4; c++)
+						totals[c] += texel[c] * percent;
+					xint++;
+					x = static_cast<float>(xint);
+				}
+				yint++;
+				y = static_cast<float>(yint);
+			}
+
+			unsigned char* out = &dst[(static_cast<size_t>(i) * size + j) * 4];
+			for (int c = 0; c < 4; c++)
+				out[c] = static_cast<unsigned char>(static_cast<unsigned short>((totals[c] + 0.5) / area) >> 8);
+		}
+	}
+}
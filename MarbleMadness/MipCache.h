@@ -0,0 +1,90 @@
+#ifndef MIPCACHE_H_
+#define MIPCACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+  // Mip chains for square BGRA textures, built with a 2x2 box filter (four
+  // pixels at a time where SSE2 is available) and kept in a directory on
+  // disk between runs, so a sprite that hasn't changed since the last
+  // launch is neither scaled nor filtered again.
+  //
+  // A chain is level 0 (size x size texels) followed by each level half
+  // the size of the one before, down to 1x1, rows bottom first.  Cache
+  // files are named for the hash of the sprite's source file and the
+  // size, and hold:
+  //   "MMMP", version, size                            (uint32 each)
+  //   the source file's length                         (uint64)
+  //   the source image's width, height                 (uint32 each)
+  //   the chain
+  // A file whose header doesn't match the sprite it is looked up for is
+  // ignored (and replaced).
+
+class MipCache
+{
+  public:
+	static MipCache& getInstance()
+	{
+		static MipCache instance;
+		return instance;
+	}
+
+	  // Where cache files go; empty turns the cache off.  Defaults to a
+	  // directory in the user's cache directory.
+	void setDirectory(const std::string& dir)
+	{
+		m_dir = dir;
+	}
+
+	  // What a chain was built from
+	struct Source
+	{
+		std::uint64_t	hash;		// of the file (see TgaImage::sourceHash)
+		std::uint64_t	bytes;		// in the file
+		std::uint32_t	width;
+		std::uint32_t	height;
+	};
+
+	  // Fill chain with the chain stored for source; false if there isn't
+	  // one.
+	bool load(const Source& source, int size, std::vector<char>& chain) const;
+
+	  // Save chain for source (quietly doing nothing if that fails).
+	void store(const Source& source, int size, const std::vector<char>& chain) const;
+
+	  // Bytes in a chain for a size x size texture
+	static std::size_t chainBytes(int size);
+
+	  // Given a chain whose level 0 is filled in, fill in the rest.
+	static void buildChain(int size, std::vector<char>& chain);
+
+	  // Halve a width x height BGRA image (bottom row first) into dst, as
+	  // gluBuild2DMipmaps does: each texel the rounded average of a 2x2
+	  // block, or of a pair once one dimension is down to 1.
+	static void halve(const unsigned char* src, int width, int height, unsigned char* dst);
+
+	  // Scale a width x height BGRA image (bottom row first) to size x size
+	  // into dst, as gluScaleImage does, but without a GL context, so on
+	  // any thread.
+	static void scale(const unsigned char* src, int width, int height, int size, unsigned char* dst);
+
+  private:
+	static const std::uint32_t VERSION = 2;
+
+	std::string		m_dir;
+
+	MipCache();
+	MipCache(const MipCache&) = delete;
+	MipCache& operator=(const MipCache&) = delete;
+
+	std::string pathFor(std::uint64_t key, int size) const;
+};
+
+inline MipCache& Mips()
+{
+	return MipCache::getInstance();
+}
+
+#endif // MIPCACHE_H_
@@ -0,0 +1,87 @@
+#include "Profiler.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iomanip>
+#include <cstdlib>
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#endif
+using namespace std;
+
+uint64_t LatencyHistogram::percentile(double p) const
+{
+	uint64_t n = count();
+	if (n == 0)
+		return 0;
+	uint64_t target = static_cast<uint64_t>(p * n);
+	uint64_t seen = 0;
+	for (int i = 0; i < NUM_BUCKETS; i++)
+	{
+		seen += m_buckets[i].load(memory_order_relaxed);
+		if (seen > target)
+			return min(bucketMidpoint(i), maximum());
+	}
+	return maximum();
+}
+
+string readableTypeName(const char* name)
+{
+#if defined(__GNUG__)
+	int status = 0;
+	char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+	if (status == 0 && demangled != nullptr)
+	{
+		string result(demangled);
+		free(demangled);
+		return result;
+	}
+#endif
+	return name;
+}
+
+static void dumpRow(ostream& os, const string& label, const LatencyHistogram& h)
+{
+	if (h.count() == 0)
+		return;
+	os << "  " << left << setw(26) << label << right
+	   << setw(10) << h.count()
+	   << setw(10) << h.total() / 1000.0 / h.count()
+	   << setw(10) << h.percentile(.50) / 1000.0
+	   << setw(10) << h.percentile(.90) / 1000.0
+	   << setw(10) << h.percentile(.99) / 1000.0
+	   << setw(10) << h.maximum() / 1000.0
+	   << setw(12) << h.total() / 1e6 << endl;
+}
+
+void Profiler::dump(ostream& os) const
+{
+	static const char* const phaseNames[NUM_PROFILE_PHASES] = {
+		"non-shooter updates", "shooter updates", "player update",
+		"dead actor sweep", "HUD formatting",
+		"sprite drawing", "HUD drawing", "buffer swap"
+	};
+
+	ios::fmtflags flags = os.flags();
+	streamsize precision = os.precision();
+	os << fixed << setprecision(2);
+
+	os << "Tick profile (us)                count      mean       p50       p90       p99       max    total ms" << endl;
+	for (int p = 0; p < NUM_PROFILE_PHASES; p++)
+		dumpRow(os, phaseNames[p], m_phases[p]);
+
+	  // Most expensive actor types first
+	vector<pair<string, const LatencyHistogram*>> types;
+	for (const auto& t : m_actorTypes)
+		types.emplace_back(readableTypeName(t.first.name()), t.second.get());
+	sort(types.begin(), types.end(), [](const pair<string, const LatencyHistogram*>& a,
+										const pair<string, const LatencyHistogram*>& b) {
+		return a.second->total() > b.second->total();
+	});
+	os << "Actor doSomething (us)" << endl;
+	for (const auto& t : types)
+		dumpRow(os, t.first, *t.second);
+
+	os.flags(flags);
+	os.precision(precision);
+}
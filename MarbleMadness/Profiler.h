@@ -0,0 +1,193 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+
+  // Log-linear histogram of durations in nanoseconds.  Each power of two
+  // is split into SUB_BUCKETS linear buckets, so a recorded value is known
+  // to within 1/SUB_BUCKETS of itself.  Buckets are relaxed atomics with a
+  // single writer, so recording is a couple of plain loads and stores, and
+  // another thread may read (and dump) the histogram at any time.
+
+class LatencyHistogram
+{
+  public:
+	LatencyHistogram()
+	{
+		for (auto& b : m_buckets)
+			b.store(0, std::memory_order_relaxed);
+		m_count.store(0, std::memory_order_relaxed);
+		m_total.store(0, std::memory_order_relaxed);
+		m_max.store(0, std::memory_order_relaxed);
+	}
+
+	  // Only one thread may record into a given histogram.
+	void record(std::uint64_t ns)
+	{
+		bump(m_buckets[bucketFor(ns)], 1);
+		bump(m_count, 1);
+		bump(m_total, ns);
+		if (ns > m_max.load(std::memory_order_relaxed))
+			m_max.store(ns, std::memory_order_relaxed);
+	}
+
+	std::uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+	std::uint64_t total() const { return m_total.load(std::memory_order_relaxed); }
+	std::uint64_t maximum() const { return m_max.load(std::memory_order_relaxed); }
+
+	  // Approximate value below which fraction p of the samples lie.
+	std::uint64_t percentile(double p) const;
+
+  private:
+	static const int SUB_BUCKET_BITS = 3;
+	static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static const int NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+	std::atomic<std::uint64_t> m_buckets[NUM_BUCKETS];
+	std::atomic<std::uint64_t> m_count;
+	std::atomic<std::uint64_t> m_total;
+	std::atomic<std::uint64_t> m_max;
+
+	static void bump(std::atomic<std::uint64_t>& a, std::uint64_t by)
+	{
+		a.store(a.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+	}
+
+	static int highestBit(std::uint64_t v)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return 63 - __builtin_clzll(v);
+#else
+		int bit = 0;
+		while (v >>= 1)
+			bit++;
+		return bit;
+#endif
+	}
+
+	static int bucketFor(std::uint64_t v)
+	{
+		if (v < SUB_BUCKETS)
+			return static_cast<int>(v);
+		int shift = highestBit(v) - SUB_BUCKET_BITS;
+		return (shift + 1) * SUB_BUCKETS + static_cast<int>((v >> shift) & (SUB_BUCKETS - 1));
+	}
+
+	static std::uint64_t bucketMidpoint(int index)
+	{
+		if (index < SUB_BUCKETS)
+			return index;
+		int shift = index / SUB_BUCKETS - 1;
+		std::uint64_t low = static_cast<std::uint64_t>(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+		return low + ((std::uint64_t(1) << shift) >> 1);
+	}
+
+	LatencyHistogram(const LatencyHistogram&);
+	LatencyHistogram& operator=(const LatencyHistogram&);
+};
+
+  // The phases of a tick and of a frame that are timed separately.
+enum ProfilePhase
+{
+	phase_non_shooter_updates, phase_shooter_updates, phase_player_update,
+	phase_dead_actor_sweep, phase_hud_formatting,
+	phase_sprite_drawing, phase_hud_drawing, phase_buffer_swap,
+	NUM_PROFILE_PHASES
+};
+
+class Profiler
+{
+  public:
+	bool isEnabled() const
+	{
+		return m_enabled;
+	}
+
+	void setEnabled(bool enabled)
+	{
+		m_enabled = enabled;
+	}
+
+	  // Return the histogram for a phase, or nullptr if profiling is off.
+	LatencyHistogram* phase(ProfilePhase p)
+	{
+		return m_enabled ? &m_phases[p] : nullptr;
+	}
+
+	  // Return the histogram for a concrete actor type, or nullptr if
+	  // profiling is off.  Only call this from the simulation thread.
+	LatencyHistogram* actorType(const std::type_info& type)
+	{
+		if (!m_enabled)
+			return nullptr;
+		std::unique_ptr<LatencyHistogram>& h = m_actorTypes[std::type_index(type)];
+		if (!h)
+			h.reset(new LatencyHistogram);
+		return h.get();
+	}
+
+	  // Write all non-empty histograms.  Only call this from the simulation
+	  // thread (or after it has finished).
+	void dump(std::ostream& os) const;
+
+	static Profiler& getInstance()
+	{
+		static Profiler instance;
+		return instance;
+	}
+
+  private:
+	std::atomic<bool>	m_enabled;
+	LatencyHistogram	m_phases[NUM_PROFILE_PHASES];
+	std::unordered_map<std::type_index, std::unique_ptr<LatencyHistogram>> m_actorTypes;
+
+	Profiler()
+	 : m_enabled(false)
+	{
+	}
+};
+
+inline Profiler& Profile()
+{
+	return Profiler::getInstance();
+}
+
+  // Return a readable name for a type_info name (demangled where the
+  // compiler mangles them).
+std::string readableTypeName(const char* name);
+
+  // Record the lifetime of a scope into a histogram; does nothing if the
+  // histogram is nullptr (i.e., profiling is off).
+class ScopedTimer
+{
+  public:
+	explicit ScopedTimer(LatencyHistogram* h)
+	 : m_histogram(h)
+	{
+		if (m_histogram != nullptr)
+			m_start = std::chrono::steady_clock::now();
+	}
+
+	~ScopedTimer()
+	{
+		if (m_histogram != nullptr)
+			m_histogram->record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+								std::chrono::steady_clock::now() - m_start).count());
+	}
+
+  private:
+	LatencyHistogram* m_histogram;
+	std::chrono::steady_clock::time_point m_start;
+
+	ScopedTimer(const ScopedTimer&);
+	ScopedTimer& operator=(const ScopedTimer&);
+};
+
+#endif // PROFILER_H_
@@ -0,0 +1,369 @@
+#if defined(__APPLE__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+#include "freeglut.h"
+#include "RenderBenchmark.h"
+#include "GameController.h"
+#include "GameWorld.h"
+#include "GameConstants.h"
+#include "RenderSnapshot.h"
+#include "GLStats.h"
+#include "LevelGenerator.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#if defined(__linux__)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <dlfcn.h>
+#endif
+#if !defined(_WIN32)
+#include <time.h>
+#endif
+using namespace std;
+
+GameWorld* createStudentWorld(string assetPath);
+
+namespace {
+
+  // Same size as the game window
+const int FRAME_WIDTH = 768;
+const int FRAME_HEIGHT = 768;
+
+const int WARMUP_FRAMES = 5;
+
+  // A normal level is VIEW_WIDTH x VIEW_HEIGHT = 225 squares
+const int SPRITE_COUNTS[] = { VIEW_WIDTH * VIEW_HEIGHT, 1000, 5000, 20000, 50000 };
+
+  // The world views: big levels drawn with the default viewport and then
+  // with the whole board (0).  The arena is open ground full of RageBots;
+  // the maze is mostly walls, so mostly static layer.
+struct WorldLevel
+{
+	const char*	name;
+	bool		maze;
+	int			robots;
+};
+
+const int WORLD_SIZE = 1025;
+const WorldLevel WORLD_LEVELS[] = { { "arena", false, 20000 }, { "maze", true, 2000 } };
+const int WORLD_VIEWPORTS[] = { VIEW_WIDTH, 0 };
+
+#if defined(__linux__)
+  // EGL is loaded at run time, so the game doesn't need it to run (only
+  // this benchmark without a display does).
+template <typename Function>
+bool loadEGL(void* library, const char* name, Function& function)
+{
+	function = reinterpret_cast<Function>(dlsym(library, name));
+	return function != nullptr;
+}
+
+bool createSurfacelessContext()
+{
+	void* library = dlopen("libEGL.so.1", RTLD_NOW);
+	decltype(&eglGetProcAddress) getProcAddress;
+	decltype(&eglGetDisplay) getDisplay;
+	decltype(&eglInitialize) initialize;
+	decltype(&eglChooseConfig) chooseConfig;
+	decltype(&eglCreatePbufferSurface) createPbufferSurface;
+	decltype(&eglBindAPI) bindAPI;
+	decltype(&eglCreateContext) createContext;
+	decltype(&eglMakeCurrent) makeCurrent;
+	if (library == nullptr || !loadEGL(library, "eglGetProcAddress", getProcAddress) ||
+		!loadEGL(library, "eglGetDisplay", getDisplay) || !loadEGL(library, "eglInitialize", initialize) ||
+		!loadEGL(library, "eglChooseConfig", chooseConfig) ||
+		!loadEGL(library, "eglCreatePbufferSurface", createPbufferSurface) ||
+		!loadEGL(library, "eglBindAPI", bindAPI) || !loadEGL(library, "eglCreateContext", createContext) ||
+		!loadEGL(library, "eglMakeCurrent", makeCurrent))
+	{
+		cerr << "Cannot load libEGL.so.1" << endl;
+		return false;
+	}
+
+	EGLDisplay display = EGL_NO_DISPLAY;
+	auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+								getProcAddress("eglGetPlatformDisplayEXT"));
+	if (getPlatformDisplay != nullptr)
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if (display == EGL_NO_DISPLAY)
+		display = getDisplay(EGL_DEFAULT_DISPLAY);
+	if (display == EGL_NO_DISPLAY || !initialize(display, nullptr, nullptr))
+		return false;
+
+	const EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_DEPTH_SIZE, 16,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint numConfigs = 0;
+	if (!chooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0)
+		return false;
+
+	const EGLint surfaceAttribs[] = { EGL_WIDTH, FRAME_WIDTH, EGL_HEIGHT, FRAME_HEIGHT, EGL_NONE };
+	EGLSurface surface = createPbufferSurface(display, config, surfaceAttribs);
+	if (surface == EGL_NO_SURFACE || !bindAPI(EGL_OPENGL_API))
+		return false;
+	EGLContext context = createContext(display, config, EGL_NO_CONTEXT, nullptr);
+	return context != EGL_NO_CONTEXT && makeCurrent(display, surface, surface, context);
+}
+#endif
+
+  // Return true if the context is a GLUT window (so GLUT fonts and
+  // glutSwapBuffers are available).
+bool createContext(int argc, char* argv[], bool& usingGlut)
+{
+#if defined(__linux__)
+	if (getenv("DISPLAY") == nullptr)
+	{
+		usingGlut = false;
+		return createSurfacelessContext();
+	}
+#endif
+	usingGlut = true;
+	glutInit(&argc, argv);
+	glutInitDisplayMode(GLUT_RGB | GLUT_DEPTH | GLUT_DOUBLE);
+	glutInitWindowSize(FRAME_WIDTH, FRAME_HEIGHT);
+	glutCreateWindow("Marble Madness render benchmark");
+	glutHideWindow();
+	return true;
+}
+
+double cpuSeconds()
+{
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+#else
+	return static_cast<double>(clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+void fillSnapshot(RenderSnapshot& snapshot, int count, mt19937& rng)
+{
+	static const int directions[] = { 0, 90, 180, 270 };
+	uniform_int_distribution<int> image(IID_PLAYER, IID_AMMO);
+	uniform_real_distribution<float> xPos(0, VIEW_WIDTH - 1);
+	uniform_real_distribution<float> yPos(0, VIEW_HEIGHT - 1);
+	uniform_int_distribution<int> dir(0, 3);
+	uniform_int_distribution<unsigned int> frame(0, 11);
+
+	snapshot.kind = RenderSnapshot::gameplay;
+	snapshot.sprites.clear();
+	for (int i = 0; i < count; i++)
+	{
+		SpriteRecord rec;
+		rec.imageID = image(rng);
+		rec.x = xPos(rng);
+		rec.y = yPos(rng);
+		rec.direction = directions[dir(rng)];
+		rec.frame = frame(rng);
+		rec.size = 1;
+		rec.visible = true;
+		rec.depth = 0;
+		snapshot.sprites.push_back(rec);
+	}
+}
+
+bool saveFrame(const string& path, bool frontBuffer)
+{
+	vector<unsigned char> pixels(FRAME_WIDTH * FRAME_HEIGHT * 4);
+	GLint readBuffer;
+	glGetIntegerv(GL_READ_BUFFER, &readBuffer);
+	if (frontBuffer)
+		glReadBuffer(GL_FRONT);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, FRAME_WIDTH, FRAME_HEIGHT, GL_BGRA, GL_UNSIGNED_BYTE, pixels.data());
+	glReadBuffer(readBuffer);
+
+	  // uncompressed true-color TGA, bottom-up like glReadPixels
+	unsigned char header[18] = { 0 };
+	header[2] = 2;
+	header[12] = FRAME_WIDTH & 0xff;
+	header[13] = FRAME_WIDTH >> 8;
+	header[14] = FRAME_HEIGHT & 0xff;
+	header[15] = FRAME_HEIGHT >> 8;
+	header[16] = 32;
+	header[17] = 8;
+	ofstream out(path.c_str(), ios::binary);
+	out.write(reinterpret_cast<const char*>(header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+	return static_cast<bool>(out);
+}
+
+}  // namespace
+
+int RenderBenchmark::run(int argc, char* argv[], const string& assetPath, int frames,
+						 const string& shotDir)
+{
+	bool usingGlut;
+	if (!createContext(argc, argv, usingGlut))
+	{
+		cerr << "Cannot create an offscreen GL context" << endl;
+		return 1;
+	}
+
+	GameController& game = Game();
+	game.m_gw = createStudentWorld(assetPath);
+	game.initDrawersAndSounds();
+	game.m_spriteLoader.waitAll();		// loading isn't what's being measured
+	game.collectSprites(chrono::microseconds(0));
+	if (game.m_spriteManager.getNumFrames(IID_PLAYER) == 0)
+	{
+		cerr << "Cannot load sprites from " << assetPath << endl;
+		return 1;
+	}
+	if (!usingGlut)
+		game.m_present = [] { COUNT_GL(glFinish()); };
+	game.reshape(FRAME_WIDTH, FRAME_HEIGHT);
+
+	cout << "Render benchmark: " << frames << " frames per sprite count, "
+		 << glGetString(GL_RENDERER) << (usingGlut ? "" : " (surfaceless, no HUD)") << endl;
+	cout << setw(8) << "sprites" << setw(10) << "fps" << setw(12) << "wall ms" << setw(12) << "cpu ms"
+		 << setw(12) << "GL calls" << setw(12) << "state chg" << setw(10) << "binds" << setw(10) << "draws" << endl;
+
+	mt19937 rng(12345);
+	RenderSnapshot snapshot;
+	if (usingGlut)
+		snapshot.hudText = "Score: 0000000  Level: 00  Lives:  3  Health: 100%  Ammo:  20  Bonus: 1000";
+
+	for (int count : SPRITE_COUNTS)
+	{
+		fillSnapshot(snapshot, count, rng);
+		for (int f = 0; f < WARMUP_FRAMES; f++)
+			game.displayGamePlay(snapshot);
+		glFinish();
+
+		GLCounts().reset();
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		double cpuStart = cpuSeconds();
+		for (int f = 0; f < frames; f++)
+			game.displayGamePlay(snapshot);
+		glFinish();
+		double cpu = cpuSeconds() - cpuStart;
+		double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+		const GLStats& stats = GLCounts();
+		cout << fixed << setw(8) << count
+			 << setw(10) << setprecision(1) << frames / wall
+			 << setw(12) << setprecision(3) << wall * 1000 / frames
+			 << setw(12) << cpu * 1000 / frames
+			 << setw(12) << setprecision(0) << double(stats.glCalls) / frames
+			 << setw(12) << double(stats.stateChanges) / frames
+			 << setw(10) << double(stats.textureBinds) / frames
+			 << setw(10) << double(stats.drawCalls) / frames << endl;
+
+		if (!shotDir.empty())
+		{
+			string path = shotDir + "/render-" + to_string(count) + ".tga";
+			if (!saveFrame(path, usingGlut))
+				cerr << "Cannot write " << path << endl;
+		}
+	}
+
+	delete game.m_gw;
+	game.m_gw = nullptr;
+	return runWorldViews(frames, shotDir, usingGlut) ? 0 : 1;
+}
+
+bool RenderBenchmark::runWorldViews(int frames, const string& shotDir, bool frontBuffer)
+{
+	error_code ec;
+	filesystem::path dir = filesystem::temp_directory_path(ec) / "marblemadness-render";
+	filesystem::create_directories(dir, ec);
+
+	cout << endl << "World views: " << WORLD_SIZE << "x" << WORLD_SIZE << " levels, capture + draw" << endl;
+	cout << left << setw(8) << "level" << right << setw(8) << "view" << setw(10) << "fps" << setw(12) << "wall ms"
+		 << setw(12) << "cpu ms" << setw(12) << "sprites" << setw(12) << "static" << endl;
+
+	GameController& game = Game();
+	bool ok = true;
+	for (const WorldLevel& level : WORLD_LEVELS)
+	{
+		LevelGenerator gen(WORLD_SIZE, WORLD_SIZE, 12345);
+		if (level.maze)
+			gen.carveMaze();
+		gen.placeSealedPlayer();
+		gen.scatter('x', 1);
+		gen.scatter('h', level.robots / 2);
+		gen.scatter('v', level.robots / 2);
+		if (ec || !gen.writeTo((dir / "level00.txt").string()))
+		{
+			cerr << "Cannot write benchmark level to " << dir << endl;
+			ok = false;
+			break;
+		}
+
+		  // the world's own images are already loaded, so only its level
+		  // comes from the temporary directory
+		game.m_gw = createStudentWorld(dir.string());
+		if (game.m_gw->init() != GWSTATUS_CONTINUE_GAME)
+		{
+			cerr << "Generated " << level.name << " level failed to load" << endl;
+			delete game.m_gw;
+			game.m_gw = nullptr;
+			ok = false;
+			break;
+		}
+
+		RenderSnapshot snapshot;
+		for (int viewport : WORLD_VIEWPORTS)
+		{
+			game.setViewport(viewport);
+			for (int f = 0; f < WARMUP_FRAMES; f++)
+			{
+				game.captureGamePlay(snapshot);
+				game.displayGamePlay(snapshot);
+			}
+			glFinish();
+
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			double cpuStart = cpuSeconds();
+			for (int f = 0; f < frames; f++)
+			{
+				game.captureGamePlay(snapshot);
+				game.displayGamePlay(snapshot);
+			}
+			glFinish();
+			double cpu = cpuSeconds() - cpuStart;
+			double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+			string view = (viewport > 0 ? to_string(viewport) : string("board"));
+			cout << left << setw(8) << level.name << right << fixed << setw(8) << view
+				 << setw(10) << setprecision(1) << frames / wall
+				 << setw(12) << setprecision(3) << wall * 1000 / frames
+				 << setw(12) << cpu * 1000 / frames
+				 << setw(12) << snapshot.sprites.size() + snapshot.staticSprites.size()
+				 << setw(12) << snapshot.staticSprites.size() << endl;
+
+			if (!shotDir.empty())
+			{
+				string path = shotDir + "/world-" + level.name + "-" + view + ".tga";
+				if (!saveFrame(path, frontBuffer))
+					cerr << "Cannot write " << path << endl;
+			}
+		}
+
+		game.m_gw->cleanUp();
+		delete game.m_gw;
+		game.m_gw = nullptr;
+	}
+
+	game.setViewport(VIEW_WIDTH);
+	filesystem::remove_all(dir, ec);
+	return ok;
+}
+
+#if defined(__APPLE__)
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,33 @@
+#ifndef RENDERBENCHMARK_H_
+#define RENDERBENCHMARK_H_
+
+#include <string>
+
+  // Drive GameController::displayGamePlay (and so SpriteManager::plotSprite)
+  // with synthetic frames of increasing sprite counts, from a normal level
+  // up to tens of thousands of objects, and report frames per second, CPU
+  // time per frame, and GL calls and state changes per frame.
+  //
+  // Renders offscreen: through a surfaceless EGL pbuffer on Linux when
+  // there is no X display, otherwise into a hidden GLUT window (which also
+  // works under a virtual framebuffer such as Xvfb).  If shotDir isn't
+  // empty, the last frame for each sprite count is saved there as a TGA
+  // file, so render changes can be checked by eye.
+  //
+  // A second table draws generated 1025x1025 levels (an open arena full of
+  // robots and a maze that is mostly walls) through the world, once with
+  // the camera viewport and once with the whole board, to show what
+  // culling through the spatial index and caching the static layer save.
+
+class RenderBenchmark
+{
+  public:
+	  // Returns a process exit status.
+	static int run(int argc, char* argv[], const std::string& assetPath, int frames,
+				   const std::string& shotDir);
+
+  private:
+	static bool runWorldViews(int frames, const std::string& shotDir, bool frontBuffer);
+};
+
+#endif // RENDERBENCHMARK_H_
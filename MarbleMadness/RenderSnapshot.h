@@ -0,0 +1,43 @@
+#ifndef RENDERSNAPSHOT_H_
+#define RENDERSNAPSHOT_H_
+
+#include "GameConstants.h"
+#include <string>
+#include <vector>
+
+  // Everything the renderer needs to draw one frame, captured by the
+  // simulation thread at the end of a tick so that drawing never touches
+  // live GraphObjects.
+
+struct SpriteRecord
+{
+	int				imageID;
+	float			x;
+	float			y;
+	int				direction;
+	unsigned int	frame;		// animation number; the renderer reduces it mod frame count
+	float			size;
+	bool			visible;
+	int				depth;		// GraphObject depth; greater depths are drawn first
+};
+
+struct RenderSnapshot
+{
+	enum Kind { nothing, prompt, gameplay };
+
+	Kind						kind = nothing;
+	std::vector<SpriteRecord>	sprites;	// in back-to-front drawing order
+	  // The static layer (walls, pits, ...) in view, drawn behind sprites,
+	  // as of GraphObject static layer version staticVersion
+	std::vector<SpriteRecord>	staticSprites;
+	unsigned long long			staticVersion = 0;
+	int							viewX = 0;		// board square at the view's bottom left
+	int							viewY = 0;
+	int							viewWidth = VIEW_WIDTH;		// squares shown
+	int							viewHeight = VIEW_HEIGHT;
+	std::string					hudText;
+	std::string					mainMessage;
+	std::string					secondMessage;
+};
+
+#endif // RENDERSNAPSHOT_H_
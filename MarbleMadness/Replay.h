@@ -0,0 +1,79 @@
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+  // A recorded game: the seed randInt was given and the input that
+  // reached the game on each tick, which is all it takes to play the same
+  // game again (the levels are read from the assets as usual).
+  //
+  // File layout (text):
+  //   MMREPLAY 1
+  //   seed <seed>
+  //   <tick> key <key code>         one line per event, in tick order
+  //   <tick> step <0 or 1>          (single stepping turned off or on)
+  //   end <number of ticks played>
+
+class Replay
+{
+  public:
+	enum EventType { key, step };
+
+	struct Event
+	{
+		long long	tick;
+		EventType	type;
+		int			value;
+	};
+
+	unsigned int		seed = 0;
+	std::vector<Event>	events;
+	long long			endTick = 0;
+
+	void add(long long tick, EventType type, int value)
+	{
+		events.push_back(Event{ tick, type, value });
+	}
+
+	bool save(const std::string& path) const
+	{
+		std::ofstream out(path);
+		out << "MMREPLAY 1\nseed " << seed << '\n';
+		for (const Event& e : events)
+			out << e.tick << (e.type == key ? " key " : " step ") << e.value << '\n';
+		out << "end " << endTick << '\n';
+		return static_cast<bool>(out);
+	}
+
+	bool load(const std::string& path)
+	{
+		std::ifstream in(path);
+		std::string word;
+		int version;
+		if (!(in >> word >> version) || word != "MMREPLAY" || version != 1)
+			return false;
+		if (!(in >> word >> seed) || word != "seed")
+			return false;
+		events.clear();
+		while (in >> word)
+		{
+			if (word == "end")
+				return static_cast<bool>(in >> endTick);
+			Event e;
+			std::string type;
+			char* rest;
+			e.tick = std::strtoll(word.c_str(), &rest, 10);
+			if (*rest != '\0' || !(in >> type >> e.value) || (type != "key" && type != "step") ||
+				(!events.empty() && e.tick < events.back().tick))
+				return false;
+			e.type = (type == "key" ? key : step);
+			events.push_back(e);
+		}
+		return false;
+	}
+};
+
+#endif // REPLAY_H_
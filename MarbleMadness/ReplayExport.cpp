@@ -0,0 +1,108 @@
+#include "ReplayExport.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <thread>
+#ifndef _WIN32
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
+using namespace std;
+
+namespace {
+
+vector<string> exportCommand(const string& exe, const vector<string>& extraArgs, const string& outDir,
+							 const string& replay)
+{
+	vector<string> args = { exe, "--headless" };
+	args.insert(args.end(), extraArgs.begin(), extraArgs.end());
+	args.push_back("--replay=" + replay);
+	args.push_back("--capture=" + (filesystem::path(outDir) / filesystem::path(replay).stem()).string() + ".y4m");
+	return args;
+}
+
+}  // namespace
+
+int exportReplays(const string& exe, const vector<string>& extraArgs, const string& outDir,
+				  const vector<string>& replays, unsigned int jobs)
+{
+	if (replays.empty())
+	{
+		cerr << "No replay files to export" << endl;
+		return 1;
+	}
+	error_code ec;
+	filesystem::create_directories(outDir, ec);
+	if (!filesystem::is_directory(outDir, ec))
+	{
+		cerr << "Cannot create directory " << outDir << endl;
+		return 1;
+	}
+	if (jobs == 0)
+		jobs = max(thread::hardware_concurrency(), 1u);
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	int failures = 0;
+
+#ifdef _WIN32
+	  // No posix_spawn; export one at a time.
+	for (const string& replay : replays)
+	{
+		string command;
+		for (const string& arg : exportCommand(exe, extraArgs, outDir, replay))
+			command += "\"" + arg + "\" ";
+		if (system(command.c_str()) != 0)
+		{
+			cerr << "Export of " << replay << " failed" << endl;
+			failures++;
+		}
+	}
+#else
+	map<pid_t, string> running;
+	size_t next = 0;
+	while (next < replays.size() || !running.empty())
+	{
+		while (next < replays.size() && running.size() < jobs)
+		{
+			const string& replay = replays[next++];
+			vector<string> args = exportCommand(exe, extraArgs, outDir, replay);
+			vector<char*> argv;
+			for (string& arg : args)
+				argv.push_back(&arg[0]);
+			argv.push_back(nullptr);
+			pid_t pid;
+			if (posix_spawnp(&pid, exe.c_str(), nullptr, nullptr, argv.data(), environ) != 0)
+			{
+				cerr << "Cannot run " << exe << " for " << replay << endl;
+				failures++;
+				continue;
+			}
+			running[pid] = replay;
+		}
+		if (running.empty())
+			break;
+
+		int status;
+		pid_t pid = waitpid(-1, &status, 0);
+		if (pid < 0)
+			break;
+		auto it = running.find(pid);
+		if (it == running.end())
+			continue;
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		{
+			cerr << "Export of " << it->second << " failed" << endl;
+			failures++;
+		}
+		running.erase(it);
+	}
+#endif
+
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cerr << "Exported " << replays.size() - failures << " of " << replays.size() << " replays to " << outDir
+		 << " in " << seconds << "s (" << min<size_t>(jobs, replays.size()) << " at a time)" << endl;
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,19 @@
+#ifndef REPLAYEXPORT_H_
+#define REPLAYEXPORT_H_
+
+#include <string>
+#include <vector>
+
+  // Render recorded games to video: each replay file is played headless
+  // into outDir/<name>.y4m, up to jobs of them at a time (0 means one per
+  // core).  Every replay runs in its own copy of this program, since a
+  // game lives in process-wide state (the controller, the random engine,
+  // the graph object lists) that only one game can use at once.
+  //
+  // exe is the program to run (argv[0]); extraArgs are passed to each
+  // copy ahead of the replay options.  Returns a process exit status.
+
+int exportReplays(const std::string& exe, const std::vector<std::string>& extraArgs,
+				  const std::string& outDir, const std::vector<std::string>& replays, unsigned int jobs);
+
+#endif // REPLAYEXPORT_H_
@@ -0,0 +1,452 @@
+#include "SoftwareRenderer.h"
+#include "GameConstants.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HAVE_SSE2
+#endif
+using namespace std;
+
+namespace {
+
+  // The HUD line is sized for this many characters across the frame
+const int HUD_COLUMNS = 80;
+const int HUD_MARGIN = 8;
+
+const int GLYPH_WIDTH = 5;
+const int GLYPH_HEIGHT = 7;
+const int GLYPH_ADVANCE = GLYPH_WIDTH + 1;
+
+  // Printable ASCII (' ' to '~'), one byte per row, top row first, the
+  // leftmost pixel in bit 4
+const unsigned char FONT[][GLYPH_HEIGHT] = {
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// ' '
+	{ 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04 },	// '!'
+	{ 0x0a, 0x0a, 0x0a, 0x00, 0x00, 0x00, 0x00 },	// '"'
+	{ 0x0a, 0x0a, 0x1f, 0x0a, 0x1f, 0x0a, 0x0a },	// '#'
+	{ 0x04, 0x0f, 0x14, 0x0e, 0x05, 0x1e, 0x04 },	// '$'
+	{ 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 },	// '%'
+	{ 0x0c, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0d },	// '&'
+	{ 0x04, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00 },	// '\''
+	{ 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 },	// '('
+	{ 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 },	// ')'
+	{ 0x00, 0x04, 0x15, 0x0e, 0x15, 0x04, 0x00 },	// '*'
+	{ 0x00, 0x04, 0x04, 0x1f, 0x04, 0x04, 0x00 },	// '+'
+	{ 0x00, 0x00, 0x00, 0x00, 0x0c, 0x04, 0x08 },	// ','
+	{ 0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00 },	// '-'
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c },	// '.'
+	{ 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 },	// '/'
+	{ 0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e },	// '0'
+	{ 0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e },	// '1'
+	{ 0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f },	// '2'
+	{ 0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e },	// '3'
+	{ 0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02 },	// '4'
+	{ 0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e },	// '5'
+	{ 0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e },	// '6'
+	{ 0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },	// '7'
+	{ 0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e },	// '8'
+	{ 0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c },	// '9'
+	{ 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00 },	// ':'
+	{ 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x04, 0x08 },	// ';'
+	{ 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 },	// '<'
+	{ 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00 },	// '='
+	{ 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 },	// '>'
+	{ 0x0e, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 },	// '?'
+	{ 0x0e, 0x11, 0x01, 0x0d, 0x15, 0x15, 0x0e },	// '@'
+	{ 0x0e, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 },	// 'A'
+	{ 0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e },	// 'B'
+	{ 0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e },	// 'C'
+	{ 0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c },	// 'D'
+	{ 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f },	// 'E'
+	{ 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10 },	// 'F'
+	{ 0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f },	// 'G'
+	{ 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 },	// 'H'
+	{ 0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e },	// 'I'
+	{ 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c },	// 'J'
+	{ 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 },	// 'K'
+	{ 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f },	// 'L'
+	{ 0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11 },	// 'M'
+	{ 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 },	// 'N'
+	{ 0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e },	// 'O'
+	{ 0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10 },	// 'P'
+	{ 0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d },	// 'Q'
+	{ 0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11 },	// 'R'
+	{ 0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e },	// 'S'
+	{ 0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },	// 'T'
+	{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e },	// 'U'
+	{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04 },	// 'V'
+	{ 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a },	// 'W'
+	{ 0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11 },	// 'X'
+	{ 0x11, 0x11, 0x11, 0x0a, 0x04, 0x04, 0x04 },	// 'Y'
+	{ 0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f },	// 'Z'
+	{ 0x0e, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0e },	// '['
+	{ 0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00 },	// '\\'
+	{ 0x0e, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0e },	// ']'
+	{ 0x04, 0x0a, 0x11, 0x00, 0x00, 0x00, 0x00 },	// '^'
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f },	// '_'
+	{ 0x08, 0x04, 0x02, 0x00, 0x00, 0x00, 0x00 },	// '`'
+	{ 0x00, 0x00, 0x0e, 0x01, 0x0f, 0x11, 0x0f },	// 'a'
+	{ 0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x1e },	// 'b'
+	{ 0x00, 0x00, 0x0e, 0x10, 0x10, 0x11, 0x0e },	// 'c'
+	{ 0x01, 0x01, 0x0d, 0x13, 0x11, 0x11, 0x0f },	// 'd'
+	{ 0x00, 0x00, 0x0e, 0x11, 0x1f, 0x10, 0x0e },	// 'e'
+	{ 0x06, 0x09, 0x08, 0x1c, 0x08, 0x08, 0x08 },	// 'f'
+	{ 0x00, 0x0f, 0x11, 0x11, 0x0f, 0x01, 0x0e },	// 'g'
+	{ 0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x11 },	// 'h'
+	{ 0x04, 0x00, 0x0c, 0x04, 0x04, 0x04, 0x0e },	// 'i'
+	{ 0x02, 0x00, 0x06, 0x02, 0x02, 0x12, 0x0c },	// 'j'
+	{ 0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12 },	// 'k'
+	{ 0x0c, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e },	// 'l'
+	{ 0x00, 0x00, 0x1a, 0x15, 0x15, 0x11, 0x11 },	// 'm'
+	{ 0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11 },	// 'n'
+	{ 0x00, 0x00, 0x0e, 0x11, 0x11, 0x11, 0x0e },	// 'o'
+	{ 0x00, 0x00, 0x1e, 0x11, 0x1e, 0x10, 0x10 },	// 'p'
+	{ 0x00, 0x00, 0x0d, 0x13, 0x0f, 0x01, 0x01 },	// 'q'
+	{ 0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10 },	// 'r'
+	{ 0x00, 0x00, 0x0e, 0x10, 0x0e, 0x01, 0x1e },	// 's'
+	{ 0x08, 0x08, 0x1c, 0x08, 0x08, 0x09, 0x06 },	// 't'
+	{ 0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0d },	// 'u'
+	{ 0x00, 0x00, 0x11, 0x11, 0x11, 0x0a, 0x04 },	// 'v'
+	{ 0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0a },	// 'w'
+	{ 0x00, 0x00, 0x11, 0x0a, 0x04, 0x0a, 0x11 },	// 'x'
+	{ 0x00, 0x00, 0x11, 0x11, 0x0f, 0x01, 0x0e },	// 'y'
+	{ 0x00, 0x00, 0x1f, 0x02, 0x04, 0x08, 0x1f },	// 'z'
+	{ 0x02, 0x04, 0x04, 0x08, 0x04, 0x04, 0x02 },	// '{'
+	{ 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },	// '|'
+	{ 0x08, 0x04, 0x04, 0x02, 0x04, 0x04, 0x08 },	// '}'
+	{ 0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00 },	// '~'
+};
+
+uint32_t packRGBA(unsigned char r, unsigned char g, unsigned char b, unsigned char a)
+{
+	const unsigned char bytes[4] = { r, g, b, a };
+	uint32_t pixel;
+	memcpy(&pixel, bytes, sizeof(pixel));
+	return pixel;
+}
+
+const uint32_t OPAQUE_BLACK = packRGBA(0, 0, 0, 255);
+const uint32_t OPAQUE_WHITE = packRGBA(255, 255, 255, 255);
+
+  // Which way a sprite faces: right (or no direction), up, left or down
+int directionIndex(int angleDegrees)
+{
+	switch (angleDegrees)
+	{
+		case 90:	return 1;
+		case 180:	return 2;
+		case 270:	return 3;
+		default:	return 0;
+	}
+}
+
+  // x * y / 255, rounded
+inline unsigned int mulDiv255(unsigned int x, unsigned int y)
+{
+	unsigned int p = x * y + 128;
+	return (p + (p >> 8)) >> 8;
+}
+
+  // Draw n premultiplied source pixels over the destination.
+void blendRow(uint32_t* dst, const uint32_t* src, int n)
+{
+	int i = 0;
+#ifdef HAVE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xff000000));
+	const __m128i c255 = _mm_set1_epi16(255);
+	const __m128i c128 = _mm_set1_epi16(128);
+	for ( ; i + 4 <= n; i += 4)
+	{
+		__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		__m128i alpha = _mm_and_si128(s, alphaMask);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero)) == 0xffff)
+			continue;	// all four transparent
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alphaMask)) == 0xffff)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), s);
+			continue;	// all four opaque
+		}
+
+		  // 255 - alpha in each 16-bit channel of a pixel, two pixels a register
+		__m128i a32 = _mm_srli_epi32(s, 24);
+		__m128i inv = _mm_sub_epi16(c255, _mm_or_si128(a32, _mm_slli_epi32(a32, 16)));
+		__m128i invLo = _mm_unpacklo_epi32(inv, inv);
+		__m128i invHi = _mm_unpackhi_epi32(inv, inv);
+
+		__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+		__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), invLo), c128);
+		__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), invHi), c128);
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_adds_epu8(s, _mm_packus_epi16(lo, hi)));
+	}
+#endif
+	for ( ; i < n; i++)
+	{
+		const unsigned char* s = reinterpret_cast<const unsigned char*>(src + i);
+		unsigned char* d = reinterpret_cast<unsigned char*>(dst + i);
+		unsigned int inv = 255 - s[3];
+		for (int c = 0; c < 4; c++)
+			d[c] = static_cast<unsigned char>(min(255u, s[c] + mulDiv255(d[c], inv)));
+	}
+}
+
+}  // namespace
+
+SoftwareRenderer::SoftwareRenderer(int width, int height)
+ : m_width(width), m_height(height), m_frame(static_cast<size_t>(width) * height, OPAQUE_BLACK),
+   m_cell(1), m_boardLeft(0), m_boardBottom(height)
+{
+}
+
+bool SoftwareRenderer::loadSprite(const string& filename, int imageID, int frameNum)
+{
+	TgaImage image;
+	return image.load(filename) && addSprite(image, imageID, frameNum);
+}
+
+bool SoftwareRenderer::addSprite(const TgaImage& image, int imageID, int frameNum)
+{
+	vector<TgaImage>& frames = m_images[imageID];
+	if (frameNum < 0)
+		return false;
+	if (static_cast<size_t>(frameNum) >= frames.size())
+		frames.resize(frameNum + 1);
+	frames[frameNum] = image;
+	return true;
+}
+
+unsigned int SoftwareRenderer::getNumFrames(int imageID) const
+{
+	auto it = m_images.find(imageID);
+	return it == m_images.end() ? 0 : static_cast<unsigned int>(it->second.size());
+}
+
+void SoftwareRenderer::render(const RenderSnapshot& snapshot)
+{
+	clear();
+	switch (snapshot.kind)
+	{
+		case RenderSnapshot::prompt:
+			{
+				int scale = max(1, min(3, m_width / (GLYPH_ADVANCE * static_cast<int>(
+										   max(snapshot.mainMessage.size(), snapshot.secondMessage.size()) + 2))));
+				drawTextCentered(snapshot.mainMessage, m_height / 2 - GLYPH_HEIGHT * scale, scale);
+				drawTextCentered(snapshot.secondMessage, m_height / 2 + GLYPH_HEIGHT * scale, scale);
+			}
+			break;
+		case RenderSnapshot::gameplay:
+			drawGamePlay(snapshot);
+			break;
+		case RenderSnapshot::nothing:
+			break;
+	}
+}
+
+bool SoftwareRenderer::saveFrame(const string& path) const
+{
+	  // uncompressed true-color TGA, top row first
+	unsigned char header[18] = { 0 };
+	header[2] = 2;
+	header[12] = m_width & 0xff;
+	header[13] = m_width >> 8;
+	header[14] = m_height & 0xff;
+	header[15] = m_height >> 8;
+	header[16] = 32;
+	header[17] = 0x28;
+
+	vector<unsigned char> bgra(m_frame.size() * 4);
+	const unsigned char* rgba = pixels();
+	for (size_t i = 0; i < bgra.size(); i += 4)
+	{
+		bgra[i] = rgba[i + 2];
+		bgra[i + 1] = rgba[i + 1];
+		bgra[i + 2] = rgba[i];
+		bgra[i + 3] = rgba[i + 3];
+	}
+
+	ofstream out(path.c_str(), ios::binary);
+	out.write(reinterpret_cast<const char*>(header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(bgra.data()), bgra.size());
+	return static_cast<bool>(out);
+}
+
+void SoftwareRenderer::clear()
+{
+	fill(m_frame.begin(), m_frame.end(), OPAQUE_BLACK);
+}
+
+  // The HUD line across the top, the board below it, as big as fits and
+  // centered; views that fit at one pixel or more per square get a whole
+  // number of pixels per square so tiles line up.
+void SoftwareRenderer::drawGamePlay(const RenderSnapshot& snapshot)
+{
+	int hudScale = max(1, m_width / (HUD_COLUMNS * GLYPH_ADVANCE));
+	int hudHeight = GLYPH_HEIGHT * hudScale + 2 * HUD_MARGIN;
+
+	int boardHeight = max(m_height - hudHeight, 1);
+	m_cell = min(double(m_width) / snapshot.viewWidth, double(boardHeight) / snapshot.viewHeight);
+	if (m_cell >= 1)
+		m_cell = floor(m_cell);
+	m_boardLeft = (m_width - m_cell * snapshot.viewWidth) / 2;
+	m_boardBottom = m_height - (boardHeight - m_cell * snapshot.viewHeight) / 2;
+
+	drawSprites(snapshot, snapshot.staticSprites);
+	drawSprites(snapshot, snapshot.sprites);
+
+	int hudWidth = static_cast<int>(snapshot.hudText.size()) * GLYPH_ADVANCE * hudScale;
+	drawText(snapshot.hudText, max((m_width - hudWidth) / 2, 0), HUD_MARGIN, hudScale);
+}
+
+void SoftwareRenderer::drawSprites(const RenderSnapshot& snapshot, const vector<SpriteRecord>& sprites)
+{
+	for (const SpriteRecord& cur : sprites)
+	{
+		if (!cur.visible)
+			continue;
+		unsigned int numFrames = getNumFrames(cur.imageID);
+		if (numFrames == 0)
+			continue;
+
+		int size = max(1, static_cast<int>(lround(cur.size * m_cell)));
+		const ScaledSprite* sprite = scaledSprite(cur.imageID, cur.frame % numFrames, cur.direction, size);
+		if (sprite == nullptr)
+			continue;
+
+		  // a sprite is centered on its square
+		double centerX = m_boardLeft + (cur.x - snapshot.viewX + .5) * m_cell;
+		double centerY = m_boardBottom - (cur.y - snapshot.viewY + .5) * m_cell;
+		blit(*sprite, static_cast<int>(lround(centerX - size / 2.0)), static_cast<int>(lround(centerY - size / 2.0)));
+	}
+}
+
+  // The frame box-filtered to size x size (premultiplying alpha first, so
+  // transparent texels don't bleed their color) and turned to face the
+  // direction, built the first time it's needed.
+const SoftwareRenderer::ScaledSprite* SoftwareRenderer::scaledSprite(int imageID, unsigned int frame,
+																	 int direction, int size)
+{
+	int dir = directionIndex(direction);
+	uint64_t key = ((((uint64_t(imageID) << 16) | frame) << 2 | uint64_t(dir)) << 24) | uint64_t(size);
+	auto it = m_scaled.find(key);
+	if (it != m_scaled.end())
+		return &it->second;
+
+	const TgaImage& image = m_images[imageID][frame];
+	if (image.width() == 0 || image.height() == 0)
+		return nullptr;
+
+	  // Scale in texture space: u left to right, v bottom to top.
+	const int w = image.width();
+	const int h = image.height();
+	const unsigned char* texels = reinterpret_cast<const unsigned char*>(image.pixels());
+	vector<uint32_t> scaled(static_cast<size_t>(size) * size);
+	bool opaque = true;
+	for (int j = 0; j < size; j++)
+	{
+		int y0 = static_cast<int>(static_cast<long long>(j) * h / size);
+		int y1 = max(y0 + 1, static_cast<int>(static_cast<long long>(j + 1) * h / size));
+		for (int i = 0; i < size; i++)
+		{
+			int x0 = static_cast<int>(static_cast<long long>(i) * w / size);
+			int x1 = max(x0 + 1, static_cast<int>(static_cast<long long>(i + 1) * w / size));
+			unsigned long long r = 0, g = 0, b = 0, a = 0;
+			for (int y = y0; y < y1; y++)
+			{
+				const unsigned char* p = texels + (static_cast<size_t>(y) * w + x0) * 4;
+				for (int x = x0; x < x1; x++, p += 4)
+				{
+					  // BGRA
+					b += p[0] * p[3];
+					g += p[1] * p[3];
+					r += p[2] * p[3];
+					a += p[3];
+				}
+			}
+			unsigned long long n = static_cast<unsigned long long>(x1 - x0) * (y1 - y0);
+			unsigned char alpha = static_cast<unsigned char>((a + n / 2) / n);
+			opaque = opaque && alpha == 255;
+			scaled[static_cast<size_t>(j) * size + i] = packRGBA(
+				static_cast<unsigned char>((r + n * 255 / 2) / (n * 255)),
+				static_cast<unsigned char>((g + n * 255 / 2) / (n * 255)),
+				static_cast<unsigned char>((b + n * 255 / 2) / (n * 255)), alpha);
+		}
+	}
+
+	  // Lay it out on screen, top row first.  Facing up or down turns it a
+	  // quarter turn; facing left mirrors it, as the GL renderer does.
+	ScaledSprite& sprite = m_scaled[key];
+	sprite.size = size;
+	sprite.opaque = opaque;
+	sprite.pixels.resize(scaled.size());
+	for (int row = 0; row < size; row++)
+	{
+		int up = size - 1 - row;	// screen y, bottom to top
+		for (int col = 0; col < size; col++)
+		{
+			int u, v;
+			switch (dir)
+			{
+				case 1:	 u = up;			v = size - 1 - col;	break;
+				case 2:	 u = size - 1 - col; v = up;				break;
+				case 3:	 u = size - 1 - up;	v = col;			break;
+				default: u = col;			v = up;				break;
+			}
+			sprite.pixels[static_cast<size_t>(row) * size + col] = scaled[static_cast<size_t>(v) * size + u];
+		}
+	}
+	return &sprite;
+}
+
+void SoftwareRenderer::blit(const ScaledSprite& sprite, int left, int top)
+{
+	int x0 = max(left, 0), x1 = min(left + sprite.size, m_width);
+	int y0 = max(top, 0), y1 = min(top + sprite.size, m_height);
+	if (x0 >= x1 || y0 >= y1)
+		return;
+
+	for (int y = y0; y < y1; y++)
+	{
+		uint32_t* dst = &m_frame[static_cast<size_t>(y) * m_width + x0];
+		const uint32_t* src = &sprite.pixels[static_cast<size_t>(y - top) * sprite.size + (x0 - left)];
+		if (sprite.opaque)
+			memcpy(dst, src, (x1 - x0) * sizeof(uint32_t));
+		else
+			blendRow(dst, src, x1 - x0);
+	}
+}
+
+void SoftwareRenderer::drawText(const string& text, int left, int top, int scale)
+{
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		unsigned char c = static_cast<unsigned char>(text[i]);
+		if (c < ' ' || c > '~')
+			c = '?';
+		const unsigned char* glyph = FONT[c - ' '];
+		int glyphLeft = left + static_cast<int>(i) * GLYPH_ADVANCE * scale;
+		for (int row = 0; row < GLYPH_HEIGHT * scale; row++)
+		{
+			int y = top + row;
+			if (y < 0 || y >= m_height)
+				continue;
+			unsigned char bits = glyph[row / scale];
+			for (int col = 0; col < GLYPH_WIDTH * scale; col++)
+			{
+				int x = glyphLeft + col;
+				if (x >= 0 && x < m_width && (bits & (0x10 >> (col / scale))))
+					m_frame[static_cast<size_t>(y) * m_width + x] = OPAQUE_WHITE;
+			}
+		}
+	}
+}
+
+void SoftwareRenderer::drawTextCentered(const string& text, int centerY, int scale)
+{
+	int width = static_cast<int>(text.size()) * GLYPH_ADVANCE * scale;
+	drawText(text, (m_width - width) / 2, centerY - GLYPH_HEIGHT * scale / 2, scale);
+}
@@ -0,0 +1,85 @@
+#ifndef SOFTWARERENDERER_H_
+#define SOFTWARERENDERER_H_
+
+#include "RenderSnapshot.h"
+#include "TgaImage.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+  // Draws RenderSnapshots into an RGBA framebuffer in memory, without any
+  // GL context, for headless runs (thumbnails, bug reports, agents that
+  // play from pixels).  The board fills the frame below a line of HUD
+  // text; each sprite is scaled to its on-screen size and turned to face
+  // its direction once, then alpha-blended from that cached copy (four
+  // pixels at a time where SSE2 is available).  Text is drawn in a built-
+  // in 5x7 bitmap font.
+
+class SoftwareRenderer
+{
+  public:
+	SoftwareRenderer(int width, int height);
+
+	  // Load frame frameNum of imageID from a TGA file.
+	bool loadSprite(const std::string& filename, int imageID, int frameNum);
+
+	  // Add a frame already decoded.
+	bool addSprite(const TgaImage& image, int imageID, int frameNum);
+
+	unsigned int getNumFrames(int imageID) const;
+
+	  // Draw the snapshot over the whole frame.
+	void render(const RenderSnapshot& snapshot);
+
+	int width() const
+	{
+		return m_width;
+	}
+
+	int height() const
+	{
+		return m_height;
+	}
+
+	  // Red, green, blue, alpha bytes per pixel, top row first
+	const unsigned char* pixels() const
+	{
+		return reinterpret_cast<const unsigned char*>(m_frame.data());
+	}
+
+	  // Write the frame as an uncompressed TGA file.
+	bool saveFrame(const std::string& path) const;
+
+  private:
+	  // A sprite frame at one size and direction, as premultiplied RGBA
+	  // (size x size pixels, top row first)
+	struct ScaledSprite
+	{
+		int							size = 0;
+		bool						opaque = true;
+		std::vector<std::uint32_t>	pixels;
+	};
+
+	int									m_width;
+	int									m_height;
+	std::vector<std::uint32_t>			m_frame;
+	std::map<int, std::vector<TgaImage>>	m_images;	// frames by image ID
+	std::unordered_map<std::uint64_t, ScaledSprite>	m_scaled;
+
+	  // Where the board is drawn this frame
+	double	m_cell;			// pixels per square
+	double	m_boardLeft;
+	double	m_boardBottom;
+
+	void clear();
+	void drawGamePlay(const RenderSnapshot& snapshot);
+	void drawSprites(const RenderSnapshot& snapshot, const std::vector<SpriteRecord>& sprites);
+	const ScaledSprite* scaledSprite(int imageID, unsigned int frame, int direction, int size);
+	void blit(const ScaledSprite& sprite, int left, int top);
+	void drawText(const std::string& text, int left, int top, int scale);
+	void drawTextCentered(const std::string& text, int centerY, int scale);
+};
+
+#endif // SOFTWARERENDERER_H_
@@ -1,102 +1,112 @@
 #ifndef SOUNDFX_H_
 #define SOUNDFX_H_
 
+#include "AudioMixer.h"
+#include "AudioSink.h"
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
-#if defined(_WIN32)
-
-#include "irrKlang/irrKlang.h"
-#pragma comment(lib, "irrKlang.lib")
-#include <iostream>
+  // The game's sound clips, decoded once when added and mixed in process
+  // (see AudioMixer), so any number can overlap and playing one is just
+  // pointing a voice at it.  The mix goes to the sound device, or to a WAV file if one is
+  // named (see AudioSink).
 
 class SoundFXController
 {
   public:
-
-	void playClip(std::string soundFile)
+	  // Decode a clip held in memory; returns the clip to give playClip,
+	  // or -1 if it couldn't be decoded (after saying why on cerr).
+	int addClip(const std::string& name, const unsigned char* data, std::size_t size)
 	{
-		if (m_engine != nullptr)
-			m_engine->play2D(soundFile.c_str(), false);
+		std::string why;
+		int clip = m_mixer.addClip(data, size, why);
+		if (clip < 0)
+			std::cerr << why << ": " << name << std::endl;
+		return clip;
 	}
 
-	void abortClip()
+	  // Decode a clip from a file, likewise.
+	int addClipFile(const std::string& path)
 	{
-		if (m_engine != nullptr)
-			m_engine->stopAllSounds();
+		std::ifstream in(path, std::ios::binary|std::ios::ate);
+		std::vector<char> data(in ? static_cast<std::size_t>(in.tellg()) : 0);
+		in.seekg(0);
+		if (!in.read(data.data(), data.size()))
+		{
+			std::cerr << "Cannot read " << path << std::endl;
+			return -1;
+		}
+		return addClip(path, reinterpret_cast<const unsigned char*>(data.data()), data.size());
 	}
 
-	static SoundFXController& getInstance();
-
-  private:
-	irrklang::ISoundEngine* m_engine;
-
-	SoundFXController()
+	  // Play a clip from addClip (doing nothing for -1)
+	void playClip(int clip)
 	{
-		m_engine = irrklang::createIrrKlangDevice();
-		if (m_engine == nullptr)
-			std::cout << "Cannot create sound engine!  Game will be silent."
-					  << std::endl;
+		m_mixer.play(clip);
 	}
 
-	~SoundFXController()
+	  // Stop everything that's playing.
+	void abortClip()
 	{
-		if (m_engine != nullptr)
-			m_engine->drop();
+		m_mixer.stopAll();
 	}
 
-	SoundFXController(const SoundFXController&);
-	SoundFXController& operator=(const SoundFXController&);
-};
-
-#elif defined(__APPLE__)
-
-#include <memory>
-#include <spawn.h>
-#include <csignal>
-#include <cstring>
+	  // Record the mix to a WAV file instead of playing it (see
+	  // WavFileSink).  Call before start.
+	void setOutputFile(const std::string& path)
+	{
+		m_outputPath = path;
+	}
 
-class SoundFXController
-{
-  public:
-	SoundFXController()
-	 : pidValid(false)
-	{}
+	  // Start sending the mix to the output file if there is one, otherwise
+	  // to the sound device if useDevice.
+	void start(bool useDevice)
+	{
+		stop();
+		if (!m_outputPath.empty())
+			m_sink.reset(new WavFileSink(m_outputPath));
+		else if (useDevice && (m_sink = AudioSink::openDevice()) == nullptr)
+			std::cerr << "No sound device; the game will be silent." << std::endl;
+		if (m_sink != nullptr && !m_sink->start(m_mixer))
+			m_sink.reset();
+	}
 
-	void playClip(std::string soundFile)
+	void stop()
 	{
-		char cmd[] = "/usr/bin/afplay";
-		std::unique_ptr<char[]> fileName(new char[soundFile.size()+1]);
-		std::strcpy(fileName.get(), soundFile.c_str());
-		char* argv[] = { cmd, fileName.get(), nullptr };
-		abortClip();  // stop anything currently playing
-		pidValid = (posix_spawn(&pid, argv[0], nullptr, nullptr, argv, nullptr) == 0);
+		if (m_sink != nullptr)
+			m_sink->stop();
+		m_sink.reset();
 	}
 
-	void abortClip()
+	  // The game has played on for elapsed (a tick).
+	void advance(std::chrono::microseconds elapsed)
 	{
-		if (pidValid)
-			kill(pid, SIGINT);
-		pidValid = false;
+		if (m_sink != nullptr)
+			m_sink->advance(elapsed);
 	}
 
 	static SoundFXController& getInstance();
 
   private:
-	pid_t pid;
-	bool pidValid;
-};
+	AudioMixer					m_mixer;
+	std::unique_ptr<AudioSink>	m_sink;
+	std::string					m_outputPath;
 
-#else  // forget about sound
+	SoundFXController() = default;
 
-class SoundFXController
-{
-  public:
-	void playClip(std::string) {}
-	void abortClip() {}
-	static SoundFXController& getInstance();
-};
+	~SoundFXController()
+	{
+		stop();
+	}
 
-#endif
+	SoundFXController(const SoundFXController&);
+	SoundFXController& operator=(const SoundFXController&);
+};
 
   // Meyers singleton pattern
 inline SoundFXController& SoundFXController::getInstance()
@@ -0,0 +1,181 @@
+#include "SpriteLoader.h"
+#include "WorkerPool.h"
+#include <iostream>
+#include <numeric>
+#include <utility>
+using namespace std;
+
+void SpriteLoader::declare(int imageID, int frameNum, const string& pathPrefix, const string& fileName)
+{
+	auto inserted = m_fileIndex.insert(make_pair(pathPrefix + fileName, m_files.size()));
+	if (inserted.second)
+	{
+		m_files.emplace_back();
+		m_files.back().pathPrefix = pathPrefix;
+		m_files.back().name = fileName;
+	}
+
+	Frame frame;
+	frame.imageID = imageID;
+	frame.frameNum = frameNum;
+	frame.file = inserted.first->second;
+	m_frames.push_back(frame);
+
+	File& file = m_files[frame.file];
+	file.frames.push_back(m_frames.size() - 1);
+	file.uncollected++;
+	Image& image = m_images[imageID];
+	image.frames.push_back(m_frames.size() - 1);
+	image.uncollected++;
+}
+
+void SpriteLoader::request(int imageID)
+{
+	  // Only the counts in m_images change after declaring, so finding the
+	  // image needs no lock.
+	auto it = m_images.find(imageID);
+	if (it == m_images.end())
+		return;
+	vector<size_t> toDecode;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		requestLocked(it->second.frames, toDecode);
+	}
+	startDecoding(toDecode);
+}
+
+void SpriteLoader::requestAll()
+{
+	vector<size_t> frames(m_frames.size());
+	iota(frames.begin(), frames.end(), size_t(0));
+	vector<size_t> toDecode;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		requestLocked(frames, toDecode);
+	}
+	startDecoding(toDecode);
+}
+
+void SpriteLoader::wait(int imageID)
+{
+	auto it = m_images.find(imageID);
+	if (it == m_images.end())
+		return;
+	request(imageID);
+	unique_lock<mutex> lock(m_mutex);
+	m_fileDecoded.wait(lock, [&] { return allDecodedLocked(it->second.frames); });
+}
+
+void SpriteLoader::waitAll()
+{
+	requestAll();
+	vector<size_t> frames(m_frames.size());
+	iota(frames.begin(), frames.end(), size_t(0));
+	unique_lock<mutex> lock(m_mutex);
+	m_fileDecoded.wait(lock, [&] { return allDecodedLocked(frames); });
+}
+
+bool SpriteLoader::hasDecoded() const
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_decodedFrames > 0;
+}
+
+size_t SpriteLoader::collect(const AddFunction& add, chrono::microseconds budget)
+{
+	using Clock = chrono::steady_clock;
+	const Clock::time_point start = Clock::now();
+	if (!hasDecoded())
+		return 0;
+
+	size_t added = 0;
+	for (size_t i = m_nextUncollected; i < m_frames.size(); i++)
+	{
+		Frame& frame = m_frames[i];
+		if (frame.collected)
+			continue;
+		File& file = m_files[frame.file];
+		{
+			lock_guard<mutex> lock(m_mutex);
+			if (file.state != decoded)
+				continue;
+			m_decodedFrames--;
+		}
+
+		  // Once a file is decoded, only this thread touches it.
+		if (!file.ok)
+		{
+			if (file.uncollected == file.frames.size())
+				cerr << file.why << ": " << file.pathPrefix << file.name << endl;
+		}
+		else if (add(frame.imageID, frame.frameNum, file.image, file.prepared))
+			added++;
+		else
+			cerr << "Error loading sprite: " << file.pathPrefix << file.name << endl;
+		frame.collected = true;
+		m_images[frame.imageID].uncollected--;
+		if (--file.uncollected == 0)
+		{
+			file.image = TgaImage();
+			file.prepared = vector<char>();
+		}
+
+		if (budget.count() > 0 && Clock::now() - start >= budget)
+			break;
+	}
+
+	while (m_nextUncollected < m_frames.size() && m_frames[m_nextUncollected].collected)
+		m_nextUncollected++;
+	return added;
+}
+
+void SpriteLoader::requestLocked(const vector<size_t>& frames, vector<size_t>& toDecode)
+{
+	for (size_t frame : frames)
+	{
+		File& file = m_files[m_frames[frame].file];
+		if (file.state == idle)
+		{
+			file.state = decoding;
+			toDecode.push_back(m_frames[frame].file);
+		}
+	}
+}
+
+void SpriteLoader::startDecoding(const vector<size_t>& files)
+{
+	for (size_t file : files)
+		Workers().post([this, file] { decode(file); });
+}
+
+  // Runs on a worker thread.
+void SpriteLoader::decode(size_t fileIndex)
+{
+	File& file = m_files[fileIndex];
+	TgaImage image;
+	string why;
+	bool ok = image.loadAsset(file.pathPrefix, file.name, why);
+	vector<char> prepared;
+	if (ok && m_prepare)
+		m_prepare(image, prepared);
+	{
+		lock_guard<mutex> lock(m_mutex);
+		file.image = move(image);
+		file.prepared = move(prepared);
+		file.ok = ok;
+		file.why = move(why);
+		file.state = decoded;
+		m_decodedFrames += file.frames.size();
+	}
+	m_fileDecoded.notify_all();
+}
+
+bool SpriteLoader::allDecodedLocked(const vector<size_t>& frames) const
+{
+	for (size_t frame : frames)
+	{
+		if (m_files[m_frames[frame].file].state != decoded)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,136 @@
+#ifndef SPRITELOADER_H_
+#define SPRITELOADER_H_
+
+#include "TgaImage.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+  // The sprite catalog: which TGA file holds each frame of each image,
+  // with files decoded only once something needs them.  request (safe
+  // from any thread, such as the one creating actors) starts decoding an
+  // image's files on the worker threads; the thread that owns the
+  // renderer then collects decoded frames when it has time for them, or
+  // waits for the ones it can't draw without.  A file shared by several
+  // images is decoded once, and dropped once all its frames are collected.
+  //
+  // Apart from request and hasDecoded, call everything from the owning
+  // thread, and declare every frame (and set any prepare function) before
+  // requesting any.
+
+class SpriteLoader
+{
+  public:
+	  // Given a frame to add to the renderer, with what the prepare
+	  // function made from its file (empty if there is none); false if it
+	  // couldn't be
+	using AddFunction = std::function<bool(int imageID, int frameNum, const TgaImage& image,
+										   const std::vector<char>& prepared)>;
+
+	  // Given a decoded file, on a worker thread, to do whatever work the
+	  // renderer can do before the frame reaches it
+	using PrepareFunction = std::function<void(const TgaImage& image, std::vector<char>& prepared)>;
+
+	SpriteLoader()
+	 : m_nextUncollected(0), m_decodedFrames(0)
+	{
+	}
+
+	  // Frame frameNum of imageID is asset fileName (see
+	  // TgaImage::loadAsset).
+	void declare(int imageID, int frameNum, const std::string& pathPrefix, const std::string& fileName);
+
+	void setPrepare(const PrepareFunction& prepare)
+	{
+		m_prepare = prepare;
+	}
+
+	  // How many frames imageID has, collected or not
+	unsigned int getNumFrames(int imageID) const
+	{
+		auto it = m_images.find(imageID);
+		return it == m_images.end() ? 0 : static_cast<unsigned int>(it->second.frames.size());
+	}
+
+	  // Have all of imageID's frames been collected?  (False if it has none.)
+	bool isCollected(int imageID) const
+	{
+		auto it = m_images.find(imageID);
+		return it != m_images.end() && it->second.uncollected == 0;
+	}
+
+	  // Start decoding imageID's frames, or every frame, unless that has
+	  // already started.
+	void request(int imageID);
+	void requestAll();
+
+	  // Request imageID's frames, or every frame, and block until they are
+	  // decoded.
+	void wait(int imageID);
+	void waitAll();
+
+	  // Are there decoded frames waiting to be collected?
+	bool hasDecoded() const;
+
+	  // Hand each decoded frame not yet collected to add, in the order they
+	  // were declared, until budget has run out (zero means no limit).
+	  // Frames that couldn't be decoded or added are reported on cerr and
+	  // count as collected.  Return how many frames were added.
+	std::size_t collect(const AddFunction& add, std::chrono::microseconds budget = std::chrono::microseconds(0));
+
+  private:
+	enum FileState { idle, decoding, decoded };
+
+	struct File
+	{
+		std::string				pathPrefix;
+		std::string				name;
+		FileState				state = idle;
+		bool					ok = false;
+		std::string				why;
+		TgaImage				image;
+		std::vector<char>		prepared;
+		std::vector<std::size_t>	frames;		// indexes into m_frames
+		std::size_t				uncollected = 0;
+	};
+
+	struct Frame
+	{
+		int				imageID;
+		int				frameNum;
+		std::size_t		file;
+		bool			collected = false;
+	};
+
+	struct Image
+	{
+		std::vector<std::size_t>	frames;		// indexes into m_frames
+		std::size_t				uncollected = 0;
+	};
+
+	std::vector<File>				m_files;
+	std::map<std::string, std::size_t>	m_fileIndex;	// by path
+	std::vector<Frame>				m_frames;		// in the order declared
+	std::map<int, Image>			m_images;
+	std::size_t						m_nextUncollected;	// no frame before it is uncollected
+	PrepareFunction					m_prepare;
+
+	  // Guards each file's state (and what a decoding job fills in before
+	  // marking it decoded) and m_decodedFrames, which the decoding jobs
+	  // share.
+	mutable std::mutex				m_mutex;
+	std::condition_variable			m_fileDecoded;
+	std::size_t						m_decodedFrames;	// decoded but not collected
+
+	void requestLocked(const std::vector<std::size_t>& frames, std::vector<std::size_t>& toDecode);
+	void startDecoding(const std::vector<std::size_t>& files);
+	void decode(std::size_t fileIndex);
+	bool allDecodedLocked(const std::vector<std::size_t>& frames) const;
+};
+
+#endif // SPRITELOADER_H_
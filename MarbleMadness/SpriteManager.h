@@ -16,7 +16,18 @@
 #define GL_BGRA GL_BGRA_EXT
 #endif
 
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+
+#ifndef GL_TEXTURE_MAX_LEVEL
+#define GL_TEXTURE_MAX_LEVEL 0x813D
+#endif
+
 #include "GameConstants.h"
+#include "TgaImage.h"
+#include "MipCache.h"
+#include "GLStats.h"
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -24,13 +35,15 @@
 #include <memory>
 #include <cstring>
 #include <cmath>
+#include <vector>
+#include <algorithm>
 
 class SpriteManager
 {
 public:
 
 	SpriteManager()
-	 : m_mipMapped(true)
+	 : m_mipMapped(true), m_batching(true), m_atlasCells(0)
 	{
 	}
 
@@ -39,108 +52,106 @@ public:
 		m_mipMapped = status;
 	}
 
+	  // When batching, plotSprite only queues the sprite; flushSprites then
+	  // draws everything queued, sorted by depth and texture, from one vertex
+	  // array with one draw call per run of sprites sharing a texture.
+	  // Otherwise each sprite is drawn immediately with its own GL state.
+	void setBatching(bool status)
+	{
+		m_batching = status;
+	}
+
 	bool loadSprite(std::string filename_tga, int imageID, int frameNum)
 	{
 		  // Load Texture Data From TGA File
+		TgaImage image;
+		return image.load(filename_tga) && addSprite(image, imageID, frameNum);
+	}
 
-		unsigned int spriteID = getSpriteID(imageID, frameNum);
-		if (INVALID_SPRITE_ID == spriteID)
-			return false;
-
-		m_frameCountPerSprite[imageID]++;	// keep track of how many frames per sprite we loaded
-
-		std::string line;
-		std::string contents = "";
-		std::ifstream tgaFile(filename_tga, std::ios::in|std::ios::binary);
+	  // Add a frame already decoded (perhaps on another thread); needs the
+	  // GL context.
+	bool addSprite(const TgaImage& image, int imageID, int frameNum)
+	{
+		std::vector<char> cell;
+		prepareCell(image, cell);
+		return addSprite(cell, imageID, frameNum);
+	}
 
-		if (!tgaFile) {
-      std::cerr << "Unable to open file in binary mode\n";
-			return false;
-    }
-
-    TGA_HEADER header;
-    tgaFile.read((char *)&header,sizeof(header));
-    unsigned char byteCount = static_cast<unsigned char>(header.pixel_depth) / 8;
-    const long imageSize = header.width_pixels * header.height_pixels * byteCount;
-
-    unsigned int textureWidth = header.width_pixels;
-    unsigned int textureHeight = header.height_pixels;
-
-    std::unique_ptr<char[]> imageData(new char[imageSize]);
-    tgaFile.seekg(18);
-    // Read image data
-		tgaFile.read(imageData.get(), imageSize);
-		if (!tgaFile) {
-      std::cerr << "Unable to read imageSize bytes: " << imageSize; 
-			return false;
-    }
+	  // Scale a frame to an atlas cell, as BGRA, and build its mip chain
+	  // (see MipCache), unless a previous run already did.  Needs no GL
+	  // context, so frames can be prepared on the threads decoding them.
+	static void prepareCell(const TgaImage& image, std::vector<char>& cell)
+	{
+		const MipCache::Source source = { image.sourceHash(), image.sourceBytes(),
+										  static_cast<std::uint32_t>(image.width()),
+										  static_cast<std::uint32_t>(image.height()) };
+		if (Mips().load(source, ATLAS_CELL_SIZE, cell))
+			return;
+		cell.resize(MipCache::chainBytes(ATLAS_CELL_SIZE));
+		MipCache::scale(reinterpret_cast<const unsigned char*>(image.pixels()), image.width(), image.height(),
+						ATLAS_CELL_SIZE, reinterpret_cast<unsigned char*>(cell.data()));
+		MipCache::buildChain(ATLAS_CELL_SIZE, cell);
+		Mips().store(source, ATLAS_CELL_SIZE, cell);
+	}
 
-		// image type either 2 (color) or 3 (greyscale)
-    if (header.color_map_type != 0 || (header.image_type != 2 && header.image_type != 3)) {
-      std::cerr << "Bad image type\n";
-			return false;
-    }
-  
-		if (byteCount != 3 && byteCount != 4) {
-      std::cerr << "Bad byte count: " << byteCount;
+	  // Add a frame prepared by prepareCell; needs the GL context.
+	  //
+	  // The atlas is a set of pages, each a grid of ATLAS_CELL_SIZE square
+	  // cells in a power-of-two texture, so a cell's mipmaps never mix with
+	  // its neighbors' and sprites sharing a page can be drawn with one
+	  // bind.  Frames fill the pages in the order they are added; only a
+	  // new page is allocated whole, and a frame only uploads its own cell
+	  // at each level.
+	bool addSprite(const std::vector<char>& cell, int imageID, int frameNum)
+	{
+		unsigned int spriteID = getSpriteID(imageID, frameNum);
+		if (INVALID_SPRITE_ID == spriteID || cell.size() != MipCache::chainBytes(ATLAS_CELL_SIZE))
 			return false;
-    }
-
-    if (header.image_descriptor & 0x20) {
-      // image ios flipped vertically
-      flipVertical(imageData.get(),header.width_pixels,header.height_pixels,byteCount);
-    }
-
-		// Transfer Texture To OpenGL
 
-		glEnable(GL_DEPTH_TEST);
-
-		  // allocate a texture handle
-		GLuint glTextureID;
-		glGenTextures(1, &glTextureID);
-
-		  // bind our new texture
-		glBindTexture(GL_TEXTURE_2D, glTextureID);
+		m_frameCountPerSprite[imageID]++;	// keep track of how many frames per sprite we loaded
 
-		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+		const int cellsPerPage = ATLAS_CELLS_ACROSS * ATLAS_CELLS_ACROSS;
+		const int pageSize = ATLAS_CELLS_ACROSS * ATLAS_CELL_SIZE;
+		const int slot = static_cast<int>(m_atlasCells % cellsPerPage);
+		if (slot == 0)
+			m_atlasPages.push_back(createAtlasPage(pageSize));
+		m_atlasCells++;
 
-		if (m_mipMapped)
+		glBindTexture(GL_TEXTURE_2D, m_atlasPages.back());
+		size_t offset = 0;
+		for (int level = 0, cellSize = ATLAS_CELL_SIZE; cellSize >= 1; level++, cellSize /= 2)
 		{
-			  // when texture area is small, bilinear filter the closest mipmap
-			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-			  // when texture area is large, bilinear filter the first mipmap
-			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		}
-		else
-		{
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexSubImage2D(GL_TEXTURE_2D, level, (slot % ATLAS_CELLS_ACROSS) * cellSize,
+							(slot / ATLAS_CELLS_ACROSS) * cellSize, cellSize, cellSize, GL_BGRA, GL_UNSIGNED_BYTE,
+							&cell[offset]);
+			offset += static_cast<size_t>(cellSize) * cellSize * 4;
+			if (!m_mipMapped)
+				break;
 		}
 
-		  // Have the texture wrap both vertically and horizontally.
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, static_cast<GLfloat>(GL_REPEAT));
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, static_cast<GLfloat>(GL_REPEAT));
-
-		if (m_mipMapped)
-		{
-			  // build our texture mipmaps
-			  // byteCount of 3 means that BGR data is being supplied. byteCount of 4 means that BGRA data is being supplied.
-            makeMipmaps(byteCount, textureWidth, textureHeight, imageData.get());
-        }
-		else
-		{
-			  // byteCount of 3 means that BGR data is being supplied. byteCount of 4 means that BGRA data is being supplied.
-			if (3 == byteCount)
-				glTexImage2D(GL_TEXTURE_2D, 0, 3, textureWidth, textureHeight, 0, GL_BGR, GL_UNSIGNED_BYTE, imageData.get());
-			else if (4 == byteCount)
-				glTexImage2D(GL_TEXTURE_2D, 0, 4, textureWidth, textureHeight, 0, GL_BGRA, GL_UNSIGNED_BYTE, imageData.get());
-		}
+		int cellX = (slot % ATLAS_CELLS_ACROSS) * ATLAS_CELL_SIZE;
+		int cellY = (slot / ATLAS_CELLS_ACROSS) * ATLAS_CELL_SIZE;
 
-		m_imageMap[spriteID] = glTextureID;
+		  // inset by half a texel so bilinear filtering stays in the cell
+		AtlasRegion region;
+		region.texture = m_atlasPages.back();
+		region.u0 = (cellX + .5f) / pageSize;
+		region.v0 = (cellY + .5f) / pageSize;
+		region.u1 = (cellX + ATLAS_CELL_SIZE - .5f) / pageSize;
+		region.v1 = (cellY + ATLAS_CELL_SIZE - .5f) / pageSize;
+		if (spriteID >= m_regions.size())
+			m_regions.resize(spriteID + 1);
+		m_regions[spriteID] = region;
 
 		return true;
 	}
 
+	  // Number of atlas textures, for benchmarks
+	size_t getNumAtlasPages() const
+	{
+		return m_atlasPages.size();
+	}
+
 	unsigned int getNumFrames(int imageID) const
 	{
 		auto it = m_frameCountPerSprite.find(imageID);
@@ -151,17 +162,26 @@ public:
 	}
 
 
-	bool plotSprite(int imageID, int frame, double gx, double gy, double gz, int angleDegrees, double size)
+	  // Sprites of greater depth are drawn first (further back); sprites of
+	  // equal depth and texture are drawn in the order they were plotted.
+	bool plotSprite(int imageID, int frame, double gx, double gy, double gz, int angleDegrees, double size,
+					int depth = 0)
 	{
 		unsigned int spriteID = getSpriteID(imageID,frame);
 		if (INVALID_SPRITE_ID == spriteID)
 			return false;
 
-		auto it = m_imageMap.find(spriteID);
-		if (it == m_imageMap.end())
+		if (spriteID >= m_regions.size() || m_regions[spriteID].texture == 0)
 			return false;
+		const AtlasRegion& region = m_regions[spriteID];
+
+		if (m_batching)
+		{
+			queueSprite(region, gx, gy, gz, angleDegrees, size, depth);
+			return true;
+		}
 
-		glPushMatrix();
+		COUNT_GL(glPushMatrix());
 
 		double finalWidth, finalHeight;
 
@@ -172,64 +192,39 @@ public:
 		const double xoffset = 0;// finalWidth / 2;
 		const double yoffset = 0;// finalHeight / 2;
 
-		glTranslatef(static_cast<GLfloat>(gx-xoffset),static_cast<GLfloat>(gy-yoffset),static_cast<GLfloat>(gz));
-		glPushAttrib(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glEnable(GL_TEXTURE_2D);
-		glDisable(GL_DEPTH_TEST);
-		glEnable (GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glBindTexture(GL_TEXTURE_2D, it->second);
+		COUNT_GL(glTranslatef(static_cast<GLfloat>(gx-xoffset),static_cast<GLfloat>(gy-yoffset),static_cast<GLfloat>(gz)));
+		COUNT_GL(glPushAttrib(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+		COUNT_GL(glEnable(GL_TEXTURE_2D));
+		COUNT_GL(glDisable(GL_DEPTH_TEST));
+		COUNT_GL(glEnable (GL_BLEND));
+		COUNT_GL(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+		COUNT_GL(glBindTexture(GL_TEXTURE_2D, region.texture));
 
-		glColor3f(1.0, 1.0, 1.0);
+		COUNT_GL(glColor3f(1.0, 1.0, 1.0));
 
 		double cx1,cx2,cx3,cx4;
 		double cy1,cy2,cy3,cy4;
 
-		cx1 = cy1 = 0;
-		cx2 = 1; cy2 = 0;
-		cx3 = 1; cy3 = 1;
-		cx4 = 0; cy4 = 1;
-
-		double rx1, ry1, rx2, ry2, rx3, ry3, rx4, ry4;
-
-//#define FULL_ROTATION	// for games where you can rotate 360 degrees, not just n/s/e/w
+		cx1 = region.u0; cy1 = region.v0;
+		cx2 = region.u1; cy2 = region.v0;
+		cx3 = region.u1; cy3 = region.v1;
+		cx4 = region.u0; cy4 = region.v1;
 
-#ifndef FULL_ROTATION
-		if (angleDegrees != 180)
-		{
-			rotate(-finalWidth / 2, -finalHeight / 2, angleDegrees, rx1, ry1);
-			rotate(finalWidth / 2, -finalHeight / 2, angleDegrees, rx2, ry2);
-			rotate(finalWidth / 2, finalHeight / 2, angleDegrees, rx3, ry3);
-			rotate(-finalWidth / 2, finalHeight / 2, angleDegrees, rx4, ry4);
-		}
-		else
-		{
-			// Ensure actors rotated to face left aren't upside-down.
-			rotate(-finalWidth / 2, -finalHeight / 2, 0, rx1, ry1);
-			rotate(finalWidth / 2, -finalHeight / 2, 0, rx2, ry2);
-			rotate(finalWidth / 2, finalHeight / 2, 0, rx3, ry3);
-			rotate(-finalWidth / 2, finalHeight / 2, 0, rx4, ry4);
-			std::swap(rx1, rx2);
-			std::swap(rx3, rx4);
-		}
-#else
-		angleDegrees += 90;
-		rotate(-finalWidth / 2, -finalHeight / 2, angleDegrees, rx1, ry1);
-		rotate(finalWidth / 2, -finalHeight / 2, angleDegrees, rx2, ry2);
-		rotate(finalWidth / 2, finalHeight / 2, angleDegrees, rx3, ry3);
-		rotate(-finalWidth / 2, finalHeight / 2, angleDegrees, rx4, ry4);
-#endif  // FULL_ROTATION
+		double rx[4], ry[4];
+		spriteCorners(finalWidth, finalHeight, angleDegrees, rx, ry);
+		double rx1 = rx[0], ry1 = ry[0], rx2 = rx[1], ry2 = ry[1];
+		double rx3 = rx[2], ry3 = ry[2], rx4 = rx[3], ry4 = ry[3];
 
-		glBegin(GL_QUADS);
-		glTexCoord2d(cx1, cy1);
-		glVertex3f(static_cast<GLfloat>(rx1), static_cast<GLfloat>(ry1), 0);
-		glTexCoord2d(cx2, cy2);
-		glVertex3f(static_cast<GLfloat>(rx2), static_cast<GLfloat>(ry2), 0);
-		glTexCoord2d(cx3, cy3);
-		glVertex3f(static_cast<GLfloat>(rx3), static_cast<GLfloat>(ry3), 0);
-		glTexCoord2d(cx4, cy4);
-		glVertex3f(static_cast<GLfloat>(rx4), static_cast<GLfloat>(ry4), 0);
-		glEnd();
+		COUNT_GL(glBegin(GL_QUADS));
+		COUNT_GL(glTexCoord2d(cx1, cy1));
+		COUNT_GL(glVertex3f(static_cast<GLfloat>(rx1), static_cast<GLfloat>(ry1), 0));
+		COUNT_GL(glTexCoord2d(cx2, cy2));
+		COUNT_GL(glVertex3f(static_cast<GLfloat>(rx2), static_cast<GLfloat>(ry2), 0));
+		COUNT_GL(glTexCoord2d(cx3, cy3));
+		COUNT_GL(glVertex3f(static_cast<GLfloat>(rx3), static_cast<GLfloat>(ry3), 0));
+		COUNT_GL(glTexCoord2d(cx4, cy4));
+		COUNT_GL(glVertex3f(static_cast<GLfloat>(rx4), static_cast<GLfloat>(ry4), 0));
+		COUNT_GL(glEnd());
 
 
 		/*
@@ -245,39 +240,218 @@ public:
 		glEnd();
 		*/
 
-		glDisable(GL_TEXTURE_2D);
-		glEnable(GL_DEPTH_TEST);
+		COUNT_GL(glDisable(GL_TEXTURE_2D));
+		COUNT_GL(glEnable(GL_DEPTH_TEST));
 
-		glPopAttrib();
-		glPopMatrix();
+		COUNT_GL(glPopAttrib());
+		COUNT_GL(glPopMatrix());
 
 		return true;
 	}
 
+	  // Draw the sprites queued since the last flush.
+	void flushSprites()
+	{
+		if (m_queue.empty())
+			return;
+
+		m_order.resize(m_queue.size());
+		for (size_t i = 0; i < m_order.size(); i++)
+			m_order[i] = static_cast<unsigned int>(i);
+		std::stable_sort(m_order.begin(), m_order.end(), [this](unsigned int a, unsigned int b) {
+			const QueuedSprite& qa = m_queue[a];
+			const QueuedSprite& qb = m_queue[b];
+			if (qa.depth != qb.depth)
+				return qa.depth > qb.depth;
+			return qa.texture < qb.texture;
+		});
+
+		m_vertices.resize(m_queue.size() * 4);
+		for (size_t i = 0; i < m_order.size(); i++)
+			std::copy(m_queue[m_order[i]].quad, m_queue[m_order[i]].quad + 4, &m_vertices[i * 4]);
+
+		COUNT_GL(glPushAttrib(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+		COUNT_GL(glEnable(GL_TEXTURE_2D));
+		COUNT_GL(glDisable(GL_DEPTH_TEST));
+		COUNT_GL(glEnable(GL_BLEND));
+		COUNT_GL(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+		COUNT_GL(glColor3f(1.0, 1.0, 1.0));
+		COUNT_GL(glInterleavedArrays(GL_T2F_V3F, 0, m_vertices.data()));
+
+		size_t start = 0;
+		while (start < m_order.size())
+		{
+			GLuint texture = m_queue[m_order[start]].texture;
+			size_t end = start + 1;
+			while (end < m_order.size() && m_queue[m_order[end]].texture == texture)
+				end++;
+			COUNT_GL(glBindTexture(GL_TEXTURE_2D, texture));
+			COUNT_GL(glDrawArrays(GL_QUADS, static_cast<GLint>(start * 4), static_cast<GLsizei>((end - start) * 4)));
+			start = end;
+		}
+
+		COUNT_GL(glDisableClientState(GL_VERTEX_ARRAY));
+		COUNT_GL(glDisableClientState(GL_TEXTURE_COORD_ARRAY));
+		COUNT_GL(glDisable(GL_TEXTURE_2D));
+		COUNT_GL(glEnable(GL_DEPTH_TEST));
+		COUNT_GL(glPopAttrib());
+
+		m_queue.clear();
+	}
+
 	~SpriteManager()
 	{
-		for (auto it = m_imageMap.begin(); it != m_imageMap.end(); it++)
-			glDeleteTextures(1, &it->second);
+		for (GLuint page : m_atlasPages)
+			glDeleteTextures(1, &page);
 	}
 
 private:
 
-#pragma pack(1)
-  struct TGA_HEADER {
-    unsigned char id_length;
-    unsigned char color_map_type;
-    unsigned char image_type;
-    unsigned short index_of_first_color_map_entry;
-    unsigned short color_map_length;
-    unsigned char color_map_entry_size;
-    unsigned short x_origin;
-    unsigned short y_origin;
-    unsigned short width_pixels;
-    unsigned short height_pixels;
-    unsigned char pixel_depth;
-    unsigned char image_descriptor; // bits 3-0 give alpha channel depth, and 5-4 give direction.
-  };
-#pragma pack()
+	  // Where a frame is in the atlas; texture 0 if it isn't loaded
+	struct AtlasRegion
+	{
+		GLuint	texture = 0;
+		GLfloat	u0 = 0, v0 = 0, u1 = 0, v1 = 0;
+	};
+
+	  // Layout of glInterleavedArrays' GL_T2F_V3F format
+	struct BatchVertex
+	{
+		GLfloat u, v;
+		GLfloat x, y, z;
+	};
+
+	struct QueuedSprite
+	{
+		GLuint		texture;
+		int			depth;
+		BatchVertex	quad[4];
+	};
+
+	  // The corners of a sprite's quad relative to its position, counter-
+	  // clockwise from the corner that gets texture coordinate 0,0
+	void spriteCorners(double width, double height, int angleDegrees, double rx[4], double ry[4])
+	{
+//#define FULL_ROTATION	// for games where you can rotate 360 degrees, not just n/s/e/w
+
+#ifndef FULL_ROTATION
+		  // Sprites only face right, up, left or down (or have no direction
+		  // and are drawn facing right), so the corners come from a table.
+		const CornerSigns* signs = cornerSigns(angleDegrees);
+		if (signs != nullptr)
+		{
+			  // facing up or down swaps which extent lies along x
+			double ex = (signs->swapExtents ? height : width) / 2;
+			double ey = (signs->swapExtents ? width : height) / 2;
+			for (int i = 0; i < 4; i++)
+			{
+				rx[i] = signs->x[i] * ex;
+				ry[i] = signs->y[i] * ey;
+			}
+			return;
+		}
+#else
+		angleDegrees += 90;
+#endif  // FULL_ROTATION
+		rotate(-width / 2, -height / 2, angleDegrees, rx[0], ry[0]);
+		rotate(width / 2, -height / 2, angleDegrees, rx[1], ry[1]);
+		rotate(width / 2, height / 2, angleDegrees, rx[2], ry[2]);
+		rotate(-width / 2, height / 2, angleDegrees, rx[3], ry[3]);
+	}
+
+	  // The sprite's corners for one direction, as signs of its half extents
+	struct CornerSigns
+	{
+		bool	swapExtents;
+		int		x[4];
+		int		y[4];
+	};
+
+	  // The corners rotate with the direction, except that facing left is
+	  // a mirror image of facing right, so actors facing left aren't
+	  // upside-down.  Null for angles other than the four directions.
+	static const CornerSigns* cornerSigns(int angleDegrees)
+	{
+		static const CornerSigns table[4] = {
+			{ false, { -1,  1,  1, -1 }, { -1, -1,  1,  1 } },	// right (or none)
+			{ true,  {  1,  1, -1, -1 }, { -1,  1,  1, -1 } },	// up
+			{ false, {  1, -1, -1,  1 }, { -1, -1,  1,  1 } },	// left
+			{ true,  { -1, -1,  1,  1 }, {  1, -1, -1,  1 } },	// down
+		};
+		if (angleDegrees < 0)
+			return &table[0];
+		if (angleDegrees % 90 != 0 || angleDegrees >= 360)
+			return nullptr;
+		return &table[angleDegrees / 90];
+	}
+
+	void queueSprite(const AtlasRegion& region, double gx, double gy, double gz, int angleDegrees, double size,
+					 int depth)
+	{
+		const GLfloat texCoords[4][2] = {
+			{ region.u0, region.v0 }, { region.u1, region.v0 }, { region.u1, region.v1 }, { region.u0, region.v1 }
+		};
+
+		double rx[4], ry[4];
+		spriteCorners(SPRITE_WIDTH_GL * size, SPRITE_HEIGHT_GL * size, angleDegrees, rx, ry);
+
+		m_queue.emplace_back();
+		QueuedSprite& q = m_queue.back();
+		q.texture = region.texture;
+		q.depth = depth;
+		for (int i = 0; i < 4; i++)
+		{
+			q.quad[i].u = texCoords[i][0];
+			q.quad[i].v = texCoords[i][1];
+			q.quad[i].x = static_cast<GLfloat>(gx + rx[i]);
+			q.quad[i].y = static_cast<GLfloat>(gy + ry[i]);
+			q.quad[i].z = static_cast<GLfloat>(gz);
+		}
+	}
+
+	  // An empty (transparent) size x size page.  When mipmapping, it has
+	  // only the levels where a cell is still at least a texel, so no level
+	  // mixes cells and adding a frame never touches another frame's texels.
+	GLuint createAtlasPage(int size)
+	{
+		glEnable(GL_DEPTH_TEST);
+
+		  // allocate a texture handle
+		GLuint glTextureID;
+		glGenTextures(1, &glTextureID);
+
+		  // bind our new texture
+		glBindTexture(GL_TEXTURE_2D, glTextureID);
+
+		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+		int levels = 1;
+		if (m_mipMapped)
+		{
+			  // when texture area is small, bilinear filter the closest mipmap
+			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			  // when texture area is large, bilinear filter the first mipmap
+			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			for (int cellSize = ATLAS_CELL_SIZE; cellSize > 1; cellSize /= 2)
+				levels++;
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+		}
+		else
+		{
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		}
+
+		  // Neighboring cells belong to other sprites, so don't wrap.
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, static_cast<GLfloat>(GL_CLAMP_TO_EDGE));
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, static_cast<GLfloat>(GL_CLAMP_TO_EDGE));
+
+		const std::vector<char> empty(static_cast<size_t>(size) * size * 4, 0);
+		for (int level = 0; level < levels; level++, size /= 2)
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, size, size, 0, GL_BGRA, GL_UNSIGNED_BYTE, empty.data());
+
+		return glTextureID;
+	}
 
 	void rotate(double x, double y, double degrees, double &xout, double &yout)
 	{
@@ -285,26 +459,22 @@ private:
 		xout = x * cos(theta) - y * sin(theta);
 		yout = y * cos(theta) + x * sin(theta);
 	}
-  
-  void flipVertical(char *image,unsigned short width,unsigned short height,unsigned int bytes_per_pixel) {
-    int bytes_per_row = width * bytes_per_pixel;
-    std::unique_ptr<char[]> temp(new char[bytes_per_row]);
-    for (unsigned int i=0;i<height/2;++i) {
-      char *src = image + i * bytes_per_row;
-      char *dst = image + (height-i-1) * bytes_per_row;
-      std::memcpy(temp.get(), dst, bytes_per_row);
-      std::memcpy(dst, src, bytes_per_row);
-      std::memcpy(src,temp.get(), bytes_per_row);
-    }
-  }
 
 	bool							m_mipMapped;
-	std::map<unsigned int, GLuint>	m_imageMap;
+	bool							m_batching;
+	size_t							m_atlasCells;	// frames added to the atlas
+	std::vector<GLuint>				m_atlasPages;
+	std::vector<AtlasRegion>		m_regions;		// indexed by sprite ID
+	std::vector<QueuedSprite>		m_queue;
+	std::vector<unsigned int>		m_order;		// m_queue indexes in drawing order
+	std::vector<BatchVertex>		m_vertices;
 	std::map<unsigned int, unsigned int>		m_frameCountPerSprite;
 
 	static const int INVALID_SPRITE_ID = -1;
 	static const int MAX_IMAGES = 1000;
 	static const int MAX_FRAMES_PER_SPRITE = 100;
+	static const int ATLAS_CELL_SIZE = 128;		// texels; a power of two
+	static const int ATLAS_CELLS_ACROSS = 8;
 
 	int getSpriteID(unsigned int imageID, unsigned int frame) const
 	{
@@ -313,18 +483,6 @@ private:
 
 		return imageID * MAX_FRAMES_PER_SPRITE + frame;
 	}
-
-    static void makeMipmaps(unsigned char byteCount, unsigned int textureWidth, unsigned int textureHeight, char* imageData)
-    {
-        int format = (byteCount == 3 ? GL_BGR : GL_BGRA);
-#ifdef __APPLE__
-        int internalFormat = (byteCount == 3 ? GL_RGB : GL_RGBA);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, textureWidth, textureHeight, 0, format, GL_UNSIGNED_BYTE, imageData);
-        glGenerateMipmap(GL_TEXTURE_2D);
-#else
-        gluBuild2DMipmaps(GL_TEXTURE_2D, byteCount, textureWidth, textureHeight, format, GL_UNSIGNED_BYTE, imageData);
-#endif
-    }
 };
 
 #if defined(__APPLE__)
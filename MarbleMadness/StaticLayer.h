@@ -0,0 +1,136 @@
+#ifndef STATICLAYER_H_
+#define STATICLAYER_H_
+
+#include "freeglut.h"
+#include "GLStats.h"
+
+  // A copy of the frame as it looked after drawing the sprites that rarely
+  // change (walls, pits, factories, the exit), so later frames can start
+  // from it with one textured quad instead of drawing them again.  The
+  // copy is tagged with a key (what was drawn and where); when the key
+  // changes, the caller draws the layer again and recaptures it.
+  //
+  // Only uses GL 1.1: the layer is copied out of the framebuffer with
+  // glCopyTexSubImage2D into a power-of-two texture at least as big as
+  // the viewport.
+
+class StaticLayer
+{
+  public:
+	struct Key
+	{
+		unsigned long long	version = 0;
+		int					viewX = 0;
+		int					viewY = 0;
+		int					viewWidth = 0;
+		int					viewHeight = 0;
+		int					pixelWidth = 0;
+		int					pixelHeight = 0;
+
+		bool operator==(const Key& other) const
+		{
+			return version == other.version && viewX == other.viewX && viewY == other.viewY &&
+				   viewWidth == other.viewWidth && viewHeight == other.viewHeight &&
+				   pixelWidth == other.pixelWidth && pixelHeight == other.pixelHeight;
+		}
+	};
+
+	StaticLayer()
+	 : m_texture(0), m_textureWidth(0), m_textureHeight(0), m_valid(false)
+	{
+	}
+
+	~StaticLayer()
+	{
+		if (m_texture != 0)
+			glDeleteTextures(1, &m_texture);
+	}
+
+	  // Is the captured layer the one for key?
+	bool matches(const Key& key) const
+	{
+		return m_valid && m_key == key;
+	}
+
+	void invalidate()
+	{
+		m_valid = false;
+	}
+
+	  // Copy the bottom-left key.pixelWidth x key.pixelHeight pixels of the
+	  // read buffer into the layer.
+	void capture(const Key& key)
+	{
+		int width = nextPowerOfTwo(key.pixelWidth);
+		int height = nextPowerOfTwo(key.pixelHeight);
+		if (m_texture == 0)
+			COUNT_GL(glGenTextures(1, &m_texture));
+		COUNT_GL(glBindTexture(GL_TEXTURE_2D, m_texture));
+		if (width != m_textureWidth || height != m_textureHeight)
+		{
+			COUNT_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+			COUNT_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+			COUNT_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+			m_textureWidth = width;
+			m_textureHeight = height;
+		}
+		COUNT_GL(glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, key.pixelWidth, key.pixelHeight));
+		m_key = key;
+		m_valid = true;
+	}
+
+	  // Cover the viewport with the captured layer, pixel for pixel.
+	void draw() const
+	{
+		GLfloat w = static_cast<GLfloat>(m_key.pixelWidth);
+		GLfloat h = static_cast<GLfloat>(m_key.pixelHeight);
+		GLfloat s = w / m_textureWidth;
+		GLfloat t = h / m_textureHeight;
+
+		COUNT_GL(glMatrixMode(GL_PROJECTION));
+		COUNT_GL(glPushMatrix());
+		COUNT_GL(glLoadIdentity());
+		COUNT_GL(glOrtho(0, w, 0, h, -1, 1));
+		COUNT_GL(glMatrixMode(GL_MODELVIEW));
+		COUNT_GL(glPushMatrix());
+		COUNT_GL(glLoadIdentity());
+		COUNT_GL(glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT));
+		COUNT_GL(glDisable(GL_DEPTH_TEST));
+		COUNT_GL(glDisable(GL_BLEND));
+		COUNT_GL(glEnable(GL_TEXTURE_2D));
+		COUNT_GL(glBindTexture(GL_TEXTURE_2D, m_texture));
+		COUNT_GL(glColor3f(1.0, 1.0, 1.0));
+		COUNT_GL(glBegin(GL_QUADS));
+		COUNT_GL(glTexCoord2f(0, 0));
+		COUNT_GL(glVertex2f(0, 0));
+		COUNT_GL(glTexCoord2f(s, 0));
+		COUNT_GL(glVertex2f(w, 0));
+		COUNT_GL(glTexCoord2f(s, t));
+		COUNT_GL(glVertex2f(w, h));
+		COUNT_GL(glTexCoord2f(0, t));
+		COUNT_GL(glVertex2f(0, h));
+		COUNT_GL(glEnd());
+		COUNT_GL(glPopAttrib());
+		COUNT_GL(glPopMatrix());
+		COUNT_GL(glMatrixMode(GL_PROJECTION));
+		COUNT_GL(glPopMatrix());
+		COUNT_GL(glMatrixMode(GL_MODELVIEW));
+	}
+
+  private:
+	GLuint	m_texture;
+	int		m_textureWidth;
+	int		m_textureHeight;
+	bool	m_valid;
+	Key		m_key;
+
+	static int nextPowerOfTwo(int n)
+	{
+		int p = 1;
+		while (p < n)
+			p *= 2;
+		return p;
+	}
+};
+
+#endif // STATICLAYER_H_
@@ -3,9 +3,13 @@
 #include "GameConstants.h"
 #include "GraphObject.h"
 #include "Level.h"
+#include "Profiler.h"
+#include "Tracer.h"
 #include <string>
 #include <sstream>
-#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
 using namespace std;
 
 GameWorld* createStudentWorld(string assetPath)
@@ -18,10 +22,15 @@ StudentWorld::StudentWorld(string assetPath)
 : GameWorld(assetPath)
 {
     m_player = nullptr;
+    m_core = nullptr;
     calledClean = false;
     levelDone = false;
     m_crystals = 0;
     m_bonus = 1000;
+    m_nextSerial = 1;
+    m_playerChunkX = 0;
+    m_playerChunkY = 0;
+    m_gameTextValid = false;
 }
 
 //Destructor
@@ -31,6 +40,11 @@ StudentWorld::~StudentWorld()
         cleanUp();
 }
 
+//Chunks within this many chunks of the player's are kept live; chunks
+//more than one further away are parked (the gap avoids thrashing when
+//the player walks back and forth over a chunk boundary)
+static const int ACTIVE_CHUNK_RADIUS = 2;
+
 //Loads the current level's maze from a data file
 int StudentWorld::init()
 {
@@ -38,83 +52,382 @@ int StudentWorld::init()
     calledClean = false;
     m_crystals = 0;
     m_bonus = 1000;
+    m_gameTextValid = false;
     
     ostringstream oss;
     oss << "level";
     if (getLevel() < 10)
         oss << "0";
-    oss << getLevel() << ".txt";
+    oss << getLevel();
     string curLevel = oss.str();
+    
+    //Prefer a chunked version of the level, which is streamed in
+    if (getLevel() <= 99)
+    {
+        unique_ptr<ChunkedLevel> chunked(new ChunkedLevel(assetPath()));
+        Level::LoadResult res = chunked->open(curLevel + ".lvc");
+        if (res == Level::load_success)
+            return initChunked(std::move(chunked));
+        if (res == Level::load_fail_bad_format)
+            return GWSTATUS_LEVEL_ERROR;
+    }
+    
     Level lev(assetPath());
-    Level::LoadResult res = lev.loadLevel(curLevel);
+    Level::LoadResult res = lev.loadLevel(curLevel + ".txt");
     
     if (getLevel() > 99 || res == Level::load_fail_file_not_found)
         return GWSTATUS_PLAYER_WON;
     if (res == Level::load_fail_bad_format)
         return GWSTATUS_LEVEL_ERROR;
     
+    //Size the board and its spatial index from the level file
+    setBoardSize(lev.getWidth(), lev.getHeight());
+    resetCore(lev.getWidth(), lev.getHeight(), 0, 0);
+    
     //If an actor exists at location (c,r), create a new actor object
-    Level::MazeEntry item;
-    for (int c = 0; c < VIEW_WIDTH; c++)
+    for (int c = 0; c < lev.getWidth(); c++)
+    {
+        for (int r = 0; r < lev.getHeight(); r++)
+        {
+            Level::MazeEntry item = lev.getContentsOf(c, r);
+            if (item == Level::crystal)
+                m_crystals++;
+            createActor(item, c, r);
+        }
+    }
+    return GWSTATUS_CONTINUE_GAME;
+}
+
+//Create the actor for a level's maze entry at x,y
+void StudentWorld::createActor(Level::MazeEntry item, int c, int r)
+{
+    switch (item)
+    {
+        case Level::empty:
+            break;
+        case Level::exit:
+            addActor(new Exit(this, c, r));
+            break;
+        case Level::player:
+            m_player = new Player(this, c, r);
+            addActor(m_player);
+            break;
+        case Level::horiz_ragebot:
+            addActor(new RageBot(this, c, r, 0));
+            break;
+        case Level::vert_ragebot:
+            addActor(new RageBot(this, c, r, 270));
+            break;
+        case Level::thiefbot_factory:
+            addActor(new ThiefBotFactory(this, c, r, false));
+            break;
+        case Level::mean_thiefbot_factory:
+            addActor(new ThiefBotFactory(this, c, r, true));
+            break;
+        case Level::wall:
+            addActor(new Wall(this, c, r));
+            break;
+        case Level::marble:
+            addActor(new Marble(this, c, r));
+            break;
+        case Level::pit:
+            addActor(new Pit(this, c, r));
+            break;
+        case Level::crystal:
+            addActor(new Crystal(this, c, r));
+            break;
+        case Level::restore_health:
+            addActor(new RestoreHealthGoodie(this, c, r));
+            break;
+        case Level::extra_life:
+            addActor(new ExtraLifeGoodie(this, c, r));
+            break;
+        case Level::ammo:
+            addActor(new AmmoGoodie(this, c, r));
+            break;
+    }
+}
+
+//Set up a chunked level: only the chunks around the player are read
+int StudentWorld::initChunked(unique_ptr<ChunkedLevel> lev)
+{
+    m_chunked = std::move(lev);
+    setBoardSize(m_chunked->getWidth(), m_chunked->getHeight());
+    m_crystals = m_chunked->getCrystals();
+    size_t chunks = static_cast<size_t>(m_chunked->chunksAcross()) * m_chunked->chunksDown();
+    m_chunkState.assign(chunks, chunk_unloaded);
+    m_parked.assign(chunks, vector<ParkedActor>());
+    
+    m_playerChunkX = m_chunked->getPlayerX() / m_chunked->getChunkSize();
+    m_playerChunkY = m_chunked->getPlayerY() / m_chunked->getChunkSize();
+    moveCoreWindow();
+    m_player = new Player(this, m_chunked->getPlayerX(), m_chunked->getPlayerY());
+    addActor(m_player);
+    
+    for (int cy = m_playerChunkY - ACTIVE_CHUNK_RADIUS; cy <= m_playerChunkY + ACTIVE_CHUNK_RADIUS; cy++)
+        for (int cx = m_playerChunkX - ACTIVE_CHUNK_RADIUS; cx <= m_playerChunkX + ACTIVE_CHUNK_RADIUS; cx++)
+            if (cx >= 0 && cx < m_chunked->chunksAcross() && cy >= 0 && cy < m_chunked->chunksDown())
+                activateChunk(cx, cy);
+    return GWSTATUS_CONTINUE_GAME;
+}
+
+//Park chunks the player has moved away from and activate the ones it has
+//moved near
+void StudentWorld::updateStreaming()
+{
+    int size = m_chunked->getChunkSize();
+    int pcx = m_player->getX() / size;
+    int pcy = m_player->getY() / size;
+    if (pcx == m_playerChunkX && pcy == m_playerChunkY)
+        return;
+    m_playerChunkX = pcx;
+    m_playerChunkY = pcy;
+    
+    //Live chunks are all inside the old window, so only look there
+    int across = m_chunked->chunksAcross();
+    int minCX = m_core->originX() / size, maxCX = (m_core->originX() + m_core->width() - 1) / size;
+    int minCY = m_core->originY() / size, maxCY = (m_core->originY() + m_core->height() - 1) / size;
+    vector<int> leaving;
+    for (int cy = minCY; cy <= maxCY; cy++)
+        for (int cx = minCX; cx <= maxCX; cx++)
+            if (m_chunkState[cy * across + cx] == chunk_active &&
+                max(abs(cx - pcx), abs(cy - pcy)) > ACTIVE_CHUNK_RADIUS + 1)
+                leaving.push_back(cy * across + cx);
+    if (!leaving.empty())
+        parkChunks(leaving);
+    
+    moveCoreWindow();
+    
+    for (int cy = pcy - ACTIVE_CHUNK_RADIUS; cy <= pcy + ACTIVE_CHUNK_RADIUS; cy++)
+        for (int cx = pcx - ACTIVE_CHUNK_RADIUS; cx <= pcx + ACTIVE_CHUNK_RADIUS; cx++)
+            if (cx >= 0 && cx < across && cy >= 0 && cy < m_chunked->chunksDown() &&
+                m_chunkState[cy * across + cx] != chunk_active)
+                activateChunk(cx, cy);
+}
+
+//Instantiate a chunk's actors from its parked records or the file
+void StudentWorld::activateChunk(int cx, int cy)
+{
+    int chunk = cy * m_chunked->chunksAcross() + cx;
+    if (m_chunkState[chunk] == chunk_parked)
     {
-        for (int r = 0; r < VIEW_HEIGHT; r++)
+        for (const ParkedActor& p : m_parked[chunk])
         {
-            item = lev.getContentsOf(c, r);
-            switch (item)
+            int dir = p.direction * 90;
+            switch (p.kind)
             {
-                case Level::empty:
-                    break;
-                case Level::exit:
-                    addActor(new Exit(this, c, r));
+                case ParkedActor::wall:
+                    addActor(new Wall(this, p.x, p.y));
                     break;
-                case Level::player:
-                    m_player = new Player(this, c, r);
-                    addActor(m_player);
+                case ParkedActor::pit:
+                    addActor(new Pit(this, p.x, p.y));
                     break;
-                case Level::horiz_ragebot:
-                    addActor(new RageBot(this, c, r, 0));
+                case ParkedActor::thiefbot_factory:
+                case ParkedActor::mean_thiefbot_factory:
+                    addActor(new ThiefBotFactory(this, p.x, p.y, p.kind == ParkedActor::mean_thiefbot_factory));
                     break;
-                case Level::vert_ragebot:
-                    addActor(new RageBot(this, c, r, 270));
+                case ParkedActor::exit:
+                case ParkedActor::revealed_exit:
+                    {
+                        Exit* e = new Exit(this, p.x, p.y);
+                        if (p.kind == ParkedActor::revealed_exit)
+                            e->setRevealed();
+                        addActor(e);
+                    }
                     break;
-                case Level::thiefbot_factory:
-                    addActor(new ThiefBotFactory(this, c, r, false));
+                case ParkedActor::marble:
+                    {
+                        Marble* m = new Marble(this, p.x, p.y);
+                        m->setHitPoints(p.hitPoints);
+                        addActor(m);
+                    }
                     break;
-                case Level::mean_thiefbot_factory:
-                    addActor(new ThiefBotFactory(this, c, r, true));
+                case ParkedActor::crystal:
+                    addActor(new Crystal(this, p.x, p.y));
                     break;
-                case Level::wall:
-                    addActor(new Wall(this, c, r));
+                case ParkedActor::restore_health:
+                    addActor(new RestoreHealthGoodie(this, p.x, p.y));
                     break;
-                case Level::marble:
-                    addActor(new Marble(this, c, r));
+                case ParkedActor::extra_life:
+                    addActor(new ExtraLifeGoodie(this, p.x, p.y));
                     break;
-                case Level::pit:
-                    addActor(new Pit(this, c, r));
+                case ParkedActor::ammo:
+                    addActor(new AmmoGoodie(this, p.x, p.y));
                     break;
-                case Level::crystal:
-                    m_crystals++;
-                    addActor(new Crystal(this, c, r));
+                case ParkedActor::ragebot:
+                    {
+                        RageBot* r = new RageBot(this, p.x, p.y, dir);
+                        r->setHitPoints(p.hitPoints);
+                        addActor(r);
+                    }
                     break;
-                case Level::restore_health:
-                    addActor(new RestoreHealthGoodie(this, c, r));
-                    break;
-                case Level::extra_life:
-                    addActor(new ExtraLifeGoodie(this, c, r));
-                    break;
-                case Level::ammo:
-                    addActor(new AmmoGoodie(this, c, r));
+                case ParkedActor::regular_thiefbot:
+                case ParkedActor::mean_thiefbot:
+                    {
+                        ThiefBot* t;
+                        if (p.kind == ParkedActor::mean_thiefbot)
+                            t = new MeanThiefBot(this, p.x, p.y);
+                        else
+                            t = new RegularThiefBot(this, p.x, p.y);
+                        t->setDirection(dir);
+                        t->setHitPoints(p.hitPoints);
+                        addActor(t);
+                    }
                     break;
             }
         }
+        vector<ParkedActor>().swap(m_parked[chunk]);
+    }
+    else
+    {
+        vector<Level::MazeEntry> cells;
+        if (!m_chunked->loadChunk(cx, cy, cells))
+            cerr << "Level chunk " << cx << "," << cy << " is corrupt; leaving it empty" << endl;
+        int size = m_chunked->getChunkSize();
+        for (int r = 0; r < size && r < int(cells.size()) / size; r++)
+        {
+            for (int c = 0; c < size; c++)
+            {
+                //The player was created from the level's header
+                Level::MazeEntry item = cells[r * size + c];
+                if (item != Level::player)
+                    createActor(item, cx * size + c, cy * size + r);
+            }
+        }
+    }
+    m_chunkState[chunk] = chunk_active;
+}
+
+//Remove every actor in the given chunks, keeping records to restore them
+//from.  Peas in flight are dropped, and a ThiefBot's stolen goodie is put
+//back where it stands.
+void StudentWorld::parkChunks(const vector<int>& chunks)
+{
+    int size = m_chunked->getChunkSize();
+    int across = m_chunked->chunksAcross();
+    for (int chunk : chunks)
+        m_chunkState[chunk] = chunk_parked;
+    
+    list<Actor*>* lists[] = { &m_actors, &m_inertActors };
+    for (list<Actor*>* l : lists)
+    {
+        list<Actor*>::iterator it = l->begin();
+        while (it != l->end())
+        {
+            Actor* a = *it;
+            int chunk = int(a->getY()) / size * across + int(a->getX()) / size;
+            if (a == m_player || m_chunkState[chunk] != chunk_parked)
+            {
+                it++;
+                continue;
+            }
+            
+            ParkedActor p;
+            p.x = static_cast<uint16_t>(a->getX());
+            p.y = static_cast<uint16_t>(a->getY());
+            p.direction = a->getDirection() / 90;
+            p.hitPoints = a->getHitPoints();
+            bool keep = true;
+            if (dynamic_cast<Wall*>(a))
+                p.kind = ParkedActor::wall;
+            else if (dynamic_cast<Pit*>(a))
+                p.kind = ParkedActor::pit;
+            else if (ThiefBotFactory* f = dynamic_cast<ThiefBotFactory*>(a))
+                p.kind = f->makesMeanThiefBots() ? ParkedActor::mean_thiefbot_factory : ParkedActor::thiefbot_factory;
+            else if (dynamic_cast<Exit*>(a))
+                p.kind = a->isVisible() ? ParkedActor::revealed_exit : ParkedActor::exit;
+            else if (dynamic_cast<Marble*>(a))
+                p.kind = ParkedActor::marble;
+            else if (dynamic_cast<Crystal*>(a))
+                p.kind = ParkedActor::crystal;
+            else if (dynamic_cast<RestoreHealthGoodie*>(a))
+                p.kind = ParkedActor::restore_health;
+            else if (dynamic_cast<ExtraLifeGoodie*>(a))
+                p.kind = ParkedActor::extra_life;
+            else if (dynamic_cast<AmmoGoodie*>(a))
+                p.kind = ParkedActor::ammo;
+            else if (dynamic_cast<RageBot*>(a))
+                p.kind = ParkedActor::ragebot;
+            else if (dynamic_cast<MeanThiefBot*>(a))
+                p.kind = ParkedActor::mean_thiefbot;
+            else if (dynamic_cast<RegularThiefBot*>(a))
+                p.kind = ParkedActor::regular_thiefbot;
+            else
+                keep = false;
+            if (keep && a->isAlive())
+                m_parked[chunk].push_back(p);
+            
+            unlinkFromCell(a);
+            delete a;
+            it = l->erase(it);
+        }
+    }
+}
+
+//Re-create the core as the window of chunks around the player's, which
+//covers every chunk that can be live
+void StudentWorld::moveCoreWindow()
+{
+    int size = m_chunked->getChunkSize();
+    int span = (2 * (ACTIVE_CHUNK_RADIUS + 1) + 1) * size;
+    int width = min(getBoardWidth(), span);
+    int height = min(getBoardHeight(), span);
+    int originX = max(0, min((m_playerChunkX - ACTIVE_CHUNK_RADIUS - 1) * size, getBoardWidth() - width));
+    int originY = max(0, min((m_playerChunkY - ACTIVE_CHUNK_RADIUS - 1) * size, getBoardHeight() - height));
+    if (m_core && m_core->originX() == originX && m_core->originY() == originY)
+        return;
+    
+    resetCore(width, height, originX, originY);
+    list<Actor*>* lists[] = { &m_actors, &m_inertActors };
+    for (list<Actor*>* l : lists)
+    {
+        for (Actor* a : *l)
+        {
+            a->m_cell = -1;
+            a->m_cellPrev = a->m_cellNext = nullptr;
+            linkToCell(a);
+        }
+    }
+}
+
+//Is square x,y on the board and in a live chunk?
+bool StudentWorld::isActiveSquare(int x, int y) const
+{
+    if (!m_chunked)
+        return true;
+    if (x < 0 || x >= getBoardWidth() || y < 0 || y >= getBoardHeight())
+        return false;
+    int size = m_chunked->getChunkSize();
+    return m_chunkState[y / size * m_chunked->chunksAcross() + x / size] == chunk_active;
+}
+
+//Are all squares from x0,y0 to x1,y1 (on one row or column) live?
+bool StudentWorld::isActiveSpan(int x0, int y0, int x1, int y1) const
+{
+    if (!m_chunked)
+        return true;
+    //Checking one square per chunk is enough
+    int size = m_chunked->getChunkSize();
+    int dx = (x1 > x0) - (x1 < x0);
+    int dy = (y1 > y0) - (y1 < y0);
+    if (dx == 0 && dy == 0)
+        return isActiveSquare(x0, y0);
+    for (int x = x0, y = y0; ; x += dx * size, y += dy * size)
+    {
+        if ((x - x1) * dx > 0 || (y - y1) * dy > 0)
+            return isActiveSquare(x1, y1);
+        if (!isActiveSquare(x, y))
+            return false;
     }
-    return GWSTATUS_CONTINUE_GAME;
 }
 
 //Make the actor do something
 int StudentWorld::doSomething(Actor* a)
 {
-    a->doSomething();
+    {
+        ScopedTimer timer(Profile().actorType(typeid(*a)));
+        a->doSomething();
+    }
     //Player died (decrement lives)
     if (!m_player->isAlive())
     {
@@ -133,74 +446,294 @@ int StudentWorld::doSomething(Actor* a)
     return GWSTATUS_CONTINUE_GAME;
 }
 
+//Append value to s right-aligned in a field of width characters padded
+//with fill (like setw), without allocating once s has grown to size
+static void appendNumber(string& s, int value, int width, char fill)
+{
+    char digits[12];
+    int n = 0;
+    unsigned int v = (value < 0 ? 0u - static_cast<unsigned int>(value) : value);
+    do
+    {
+        digits[n++] = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    if (value < 0)
+        digits[n++] = '-';
+    for (int i = n; i < width; i++)
+        s += fill;
+    while (n > 0)
+        s += digits[--n];
+}
+
 //Updates the game text header
 void StudentWorld::updateGameText()
 {
-    ostringstream oss;
-    oss << "Score: ";
-    oss.fill('0');
-    oss << setw(7) << getScore();
-    oss.fill('0');
-    oss << "  Level: " << setw(2) << getLevel();
-    oss.fill(' ');
-    oss << "  Lives: " << setw(2) << getLives();
-    oss << "  Health: " << setw(3) << m_player->getHealthPct();
-    oss << "%  Ammo: " << setw(3) << m_player->getAmmo();
-    oss << "  Bonus: " << setw(4) << m_bonus;
-    string s = oss.str();
-    setGameStatText(s);
+    int values[NUM_GAME_TEXT_VALUES] = {
+        getScore(), getLevel(), getLives(),
+        m_player->getHealthPct(), m_player->getAmmo(), m_bonus
+    };
+    //Most ticks nothing on the status line changes
+    if (m_gameTextValid && equal(values, values + NUM_GAME_TEXT_VALUES, m_gameTextValues))
+        return;
+    copy(values, values + NUM_GAME_TEXT_VALUES, m_gameTextValues);
+    m_gameTextValid = true;
+    
+    m_gameText.clear();
+    m_gameText += "Score: ";
+    appendNumber(m_gameText, values[0], 7, '0');
+    m_gameText += "  Level: ";
+    appendNumber(m_gameText, values[1], 2, '0');
+    m_gameText += "  Lives: ";
+    appendNumber(m_gameText, values[2], 2, ' ');
+    m_gameText += "  Health: ";
+    appendNumber(m_gameText, values[3], 3, ' ');
+    m_gameText += "%  Ammo: ";
+    appendNumber(m_gameText, values[4], 3, ' ');
+    m_gameText += "  Bonus: ";
+    appendNumber(m_gameText, values[5], 4, ' ');
+    setGameStatText(m_gameText);
 }
 
 int StudentWorld::move()
 {
-    //Update the game text header every tick
-    updateGameText();
+    //Update the game text header if anything on it changed
+    {
+        ScopedTimer timer(Profile().phase(phase_hud_formatting));
+        updateGameText();
+    }
     list<Actor*>::iterator itr;
     
     //Make actors that don't shoot do something
-    for (itr = m_actors.begin(); itr != m_actors.end(); itr++)
     {
-        //Skip the player and robots that shoot (fixes the pea problem)
-        if ((*itr) == m_player || (*itr)->needsClearShot())
-            continue;
-        int res = doSomething((*itr));
-        //Return if the player dies or the level is finished
-        if (res != GWSTATUS_CONTINUE_GAME)
-            return res;
+        ScopedTimer timer(Profile().phase(phase_non_shooter_updates));
+        for (itr = m_actors.begin(); itr != m_actors.end(); itr++)
+        {
+            //Skip the player and robots that shoot (fixes the pea problem)
+            if ((*itr) == m_player || (*itr)->needsClearShot())
+                continue;
+            int res = doSomething((*itr));
+            //Return if the player dies or the level is finished
+            if (res != GWSTATUS_CONTINUE_GAME)
+                return res;
+        }
     }
     
     //Make robots that shoot do something
-    for (itr = m_actors.begin(); itr != m_actors.end(); itr++)
     {
-        //Skip the player and actors that don't shoot
-        if ((*itr) == m_player || !(*itr)->needsClearShot())
-            continue;
-        int res = doSomething((*itr));
-        //Return if the player dies or the level is finished
-        if (res != GWSTATUS_CONTINUE_GAME)
-            return res;
+        ScopedTimer timer(Profile().phase(phase_shooter_updates));
+        for (itr = m_actors.begin(); itr != m_actors.end(); itr++)
+        {
+            //Skip the player and actors that don't shoot
+            if ((*itr) == m_player || !(*itr)->needsClearShot())
+                continue;
+            int res = doSomething((*itr));
+            //Return if the player dies or the level is finished
+            if (res != GWSTATUS_CONTINUE_GAME)
+                return res;
+        }
     }
     
     //Make the player do something
-    m_player->doSomething();
+    {
+        ScopedTimer timer(Profile().phase(phase_player_update));
+        ScopedTimer typeTimer(Profile().actorType(typeid(*m_player)));
+        m_player->doSomething();
+    }
     
     //Delete any dead actors
-    list<Actor*>::iterator deadItr = m_actors.begin();
-    while (deadItr != m_actors.end())
     {
-        if (!(*deadItr)->isAlive())
+        ScopedTimer timer(Profile().phase(phase_dead_actor_sweep));
+        list<Actor*>::iterator deadItr = m_actors.begin();
+        while (deadItr != m_actors.end())
         {
-            delete (*deadItr);
-            deadItr = m_actors.erase(deadItr);
-        } else
-            deadItr++;
+            if (!(*deadItr)->isAlive())
+            {
+                if (Trace().isEnabled())
+                    Trace().instant("death", "actor", Trace().internTypeName(typeid(**deadItr)),
+                                    (*deadItr)->getX(), (*deadItr)->getY());
+                unlinkFromCell(*deadItr);
+                delete (*deadItr);
+                deadItr = m_actors.erase(deadItr);
+            } else
+                deadItr++;
+        }
     }
+    //Stream chunks in and out as the player moves around a chunked level
+    if (m_chunked)
+        updateStreaming();
+    
     //Decrement the bonus by one every tick
     if (m_bonus > 0)
         m_bonus--;
 	return GWSTATUS_CONTINUE_GAME;
 }
 
+// Add an actor to the world
+void StudentWorld::addActor(Actor* a)
+{
+    if (Trace().isEnabled())
+        Trace().instant("spawn", "actor", Trace().internTypeName(typeid(*a)), a->getX(), a->getY());
+    a->m_serial = m_nextSerial++;
+    a->m_layers = layersOf(a);
+    linkToCell(a);
+    if (a->isInert())
+        m_inertActors.push_back(a);
+    else
+        m_actors.push_back(a);
+}
+
+// Add the actors on squares in the rectangle (from the spatial index)
+void StudentWorld::getGraphObjectsIn(int minX, int minY, int maxX, int maxY,
+                                     vector<GraphObject*>& objects) const
+{
+    if (!m_core)
+        return;
+    //Only squares in the core can have actors
+    minX = max(minX, m_core->originX());
+    minY = max(minY, m_core->originY());
+    maxX = min(maxX, m_core->originX() + m_core->width() - 1);
+    maxY = min(maxY, m_core->originY() + m_core->height() - 1);
+    withCore([&](const auto& core) {
+        for (int y = minY; y <= maxY; y++)
+            for (int x = minX; x <= maxX; x++)
+                for (Actor* p = firstActorAt(core, x, y); p != nullptr; p = p->m_cellNext)
+                    objects.push_back(p);
+    });
+}
+
+// The camera follows the player
+bool StudentWorld::getCameraFocus(double& x, double& y) const
+{
+    if (m_player == nullptr)
+        return false;
+    x = m_player->getX();
+    y = m_player->getY();
+    return true;
+}
+
+// Update the spatial index after an actor changed squares
+void StudentWorld::actorMoved(Actor* a)
+{
+    //Actors still being constructed aren't indexed yet
+    if (a->m_serial == 0)
+        return;
+    withCore([a](auto& core) {
+        if (core.cellIndex(a->getX(), a->getY()) == a->m_cell)
+            return;
+        unlinkFromCell(core, a);
+        linkToCell(core, a);
+    });
+}
+
+// Update the spatial index after an actor died
+void StudentWorld::actorDied(Actor* a)
+{
+    //Dead actors stay listed on their square until they're deleted, but
+    //no longer block anything
+    if (a->m_cell >= 0)
+        withCore([a](auto& core) {
+            core.remove(core.cellX(a->m_cell), core.cellY(a->m_cell), a->m_layers);
+        });
+}
+
+//The core layers a live actor occupies
+unsigned int StudentWorld::layersOf(const Actor* a)
+{
+    unsigned int layers = 0;
+    if (!a->allowsAgentColocation())
+        layers |= WorldCore::layerBit(WorldCore::agent_blockers);
+    if (!a->allowsMarble())
+        layers |= WorldCore::layerBit(WorldCore::marble_blockers);
+    if (a->stopsPea() || a->isDamageable())
+        layers |= WorldCore::layerBit(WorldCore::pea_blockers);
+    if (a->countsInFactoryCensus())
+        layers |= WorldCore::layerBit(WorldCore::census_members);
+    return layers;
+}
+
+//Replace the core with an empty width x height one whose bottom-left
+//square is originX,originY
+void StudentWorld::resetCore(int width, int height, int originX, int originY)
+{
+    m_fixedCore.reset();
+    m_genericCore.reset();
+    if (fixedSizeWorldCoresEnabled() && width == VIEW_WIDTH && height == VIEW_HEIGHT)
+    {
+        m_fixedCore.reset(new FixedCore);
+        m_core = m_fixedCore.get();
+    }
+    else
+    {
+        m_genericCore.reset(new GenericCore(width, height));
+        m_core = m_genericCore.get();
+    }
+    m_core->setOrigin(originX, originY);
+}
+
+//The first actor on square x,y, in the order actors were added
+template <typename Core>
+Actor* StudentWorld::firstActorAt(const Core& core, int x, int y)
+{
+    int cell = core.cellIndex(x, y);
+    return cell < 0 ? nullptr : core.head(cell);
+}
+
+//Insert a into its square's list, keeping the list in serial order
+template <typename Core>
+void StudentWorld::linkToCell(Core& core, Actor* a)
+{
+    int cell = core.cellIndex(a->getX(), a->getY());
+    a->m_cell = cell;
+    if (cell < 0)
+        return;
+    if (a->isAlive())
+        core.add(a->getX(), a->getY(), a->m_layers);
+    Actor* prev = nullptr;
+    Actor* next = core.head(cell);
+    while (next != nullptr && next->m_serial < a->m_serial)
+    {
+        prev = next;
+        next = next->m_cellNext;
+    }
+    a->m_cellPrev = prev;
+    a->m_cellNext = next;
+    if (next != nullptr)
+        next->m_cellPrev = a;
+    if (prev != nullptr)
+        prev->m_cellNext = a;
+    else
+        core.head(cell) = a;
+}
+
+template <typename Core>
+void StudentWorld::unlinkFromCell(Core& core, Actor* a)
+{
+    if (a->m_cell < 0)
+        return;
+    //a is still counted on the square it was linked to, not where it is now
+    if (a->isAlive())
+        core.remove(core.cellX(a->m_cell), core.cellY(a->m_cell), a->m_layers);
+    if (a->m_cellPrev != nullptr)
+        a->m_cellPrev->m_cellNext = a->m_cellNext;
+    else
+        core.head(a->m_cell) = a->m_cellNext;
+    if (a->m_cellNext != nullptr)
+        a->m_cellNext->m_cellPrev = a->m_cellPrev;
+    a->m_cellPrev = a->m_cellNext = nullptr;
+    a->m_cell = -1;
+}
+
+void StudentWorld::linkToCell(Actor* a)
+{
+    withCore([a](auto& core) { linkToCell(core, a); });
+}
+
+void StudentWorld::unlinkFromCell(Actor* a)
+{
+    withCore([a](auto& core) { unlinkFromCell(core, a); });
+}
+
 void StudentWorld::cleanUp()
 {
     //Delete all remaining actors currently in the game
@@ -211,6 +744,15 @@ void StudentWorld::cleanUp()
         delete (*it);
         it = m_actors.erase(it);
     }
+    for (it = m_inertActors.begin(); it != m_inertActors.end(); it = m_inertActors.erase(it))
+        delete (*it);
+    m_player = nullptr;
+    m_fixedCore.reset();
+    m_genericCore.reset();
+    m_core = nullptr;
+    m_chunked.reset();
+    m_chunkState.clear();
+    m_parked.clear();
     calledClean = true;
 }
 
@@ -229,25 +771,28 @@ void StudentWorld::increaseAmmo()
 // Can an agent move to x,y?
 bool StudentWorld::canAgentMoveTo(Agent* agent, int x, int y) const
 {
-    list<Actor*>::const_iterator it;
-    for (it = m_actors.begin(); it != m_actors.end(); it++)
-    {
-        if ((*it)->isAlive() && !(*it)->allowsAgentColocation() && (*it)->getX() == x && (*it)->getY() == y)
-            return (*it)->bePushedBy(agent);
-    }
-    return true;
+    //Squares that aren't streamed in block everything
+    if (!isActiveSquare(x, y))
+        return false;
+    return withCore([=](const auto& core) {
+        //Most squares hold nothing that blocks agents
+        if (!core.any(WorldCore::agent_blockers, x, y))
+            return true;
+        for (Actor* p = firstActorAt(core, x, y); p != nullptr; p = p->m_cellNext)
+        {
+            if (p->isAlive() && !p->allowsAgentColocation())
+                return p->bePushedBy(agent);
+        }
+        return true;
+    });
 }
 
 // Can a marble move to x,y?
 bool StudentWorld::canMarbleMoveTo(int x, int y) const
 {
-    list<Actor*>::const_iterator it;
-    for (it = m_actors.begin(); it != m_actors.end(); it++)
-    {
-        if ((*it)->isAlive() && !(*it)->allowsMarble() && (*it)->getX() == x && (*it)->getY() == y)
-            return false;
-    }
-    return true;
+    return isActiveSquare(x, y) && withCore([=](const auto& core) {
+        return !core.any(WorldCore::marble_blockers, x, y);
+    });
 }
 
 // Is the player on the same square as an actor?
@@ -261,46 +806,53 @@ bool StudentWorld::isPlayerColocatedWith(int x, int y) const
 // at this location prevents a pea from continuing.
 bool StudentWorld::damageSomething(Actor* a, int damageAmt)
 {
-    bool res = false;
-    list<Actor*>::iterator it;
-    for (it = m_actors.begin(); it != m_actors.end(); it++)
+    if (!isActiveSquare(a->getX(), a->getY()))
     {
-        if ((*it)->isAlive() && (*it)->getX() == a->getX() && (*it)->getY() == a->getY())
+        a->setDead();
+        return true;
+    }
+    return withCore([=](const auto& core) {
+        if (!core.any(WorldCore::pea_blockers, a->getX(), a->getY()))
+            return false;
+        bool res = false;
+        for (Actor* p = firstActorAt(core, a->getX(), a->getY()); p != nullptr; p = p->m_cellNext)
         {
-            //If the obstruction is damageable, damage it and set the pea's state to dead
-            if ((*it)->isDamageable())
+            if (p->isAlive())
             {
-                (*it)->damage(damageAmt);
-                a->setDead();
-                return true;
-            }
-            //If the obstruction stops peas, set the pea's state to dead
-            else if ((*it)->stopsPea())
-            {
-                a->setDead();
-                res = true;
+                //If the obstruction is damageable, damage it and set the pea's state to dead
+                if (p->isDamageable())
+                {
+                    p->damage(damageAmt);
+                    a->setDead();
+                    return true;
+                }
+                //If the obstruction stops peas, set the pea's state to dead
+                else if (p->stopsPea())
+                {
+                    a->setDead();
+                    res = true;
+                }
             }
         }
-    }
-    return res;
+        return res;
+    });
 }
 
 // Swallow any swallowable object at a's location.  (a is only ever
 // going to be a pit.)
 bool StudentWorld::swallowSwallowable(Actor* a)
 {
-    int x = a->getX();
-    int y = a->getY();
-    list<Actor*>::iterator it;
-    for (it = m_actors.begin(); it != m_actors.end(); it++)
-    {
-        if ((*it)->isAlive() && (*it)->isSwallowable() && (*it)->getX() == x && (*it)->getY() == y)
+    return withCore([a](const auto& core) {
+        for (Actor* p = firstActorAt(core, a->getX(), a->getY()); p != nullptr; p = p->m_cellNext)
         {
-            (*it)->setDead();
-            return true;
+            if (p->isAlive() && p->isSwallowable())
+            {
+                p->setDead();
+                return true;
+            }
         }
-    }
-    return false;
+        return false;
+    });
 }
 
 // If a pea were at x,y moving in direction dx,dy, could it hit the
@@ -311,35 +863,25 @@ bool StudentWorld::existsClearShotToPlayer(int x, int y, int dir) const
         return false;
     
     //Pea is either on the same row or column of the player
-    int currX = x;
-    int currY = y;
+    int px = m_player->getX();
+    int py = m_player->getY();
+    if (x == px && y == py)
+        return true;
     int dx = 0;
     int dy = 0;
     oneStep(dir, dx, dy);
     
-    list<Actor*>::const_iterator it;
-    while (currX != m_player->getX() || currY != m_player->getY())
-    {
-        //Move the pea one square in its current direction
-        currX += dx;
-        currY += dy;
-        // Return true if the pea's position matches the player's position
-        if (currX == m_player->getX() && currY == m_player->getY())
-            return true;
-        //Return false if the pea is on the same square as an obstruction (i.e. any agent or wall or factory)
-        for (it = m_actors.begin(); it != m_actors.end(); it++)
-        {
-            if ((*it)->isAlive() && (*it)->getX() == currX && (*it)->getY() == currY)
-            {
-                if ((*it)->stopsPea() || (*it)->isDamageable())
-                    return false;
-            }
-        }
-        //Bounds check
-        if (currX > VIEW_HEIGHT || currX < 0 || currY > VIEW_WIDTH || currY < 0)
-            return false;
-    }
-    return true;
+    //A pea heading away from the player would leave the board first
+    if ((px - x) * dx + (py - y) * dy <= 0)
+        return false;
+    
+    //Return false if an obstruction (i.e. any agent or wall or factory) is
+    //on a square between the pea and the player
+    if (!isActiveSpan(x, y, px, py))
+        return false;
+    return withCore([=](const auto& core) {
+        return !core.anyBetween(WorldCore::pea_blockers, x, y, px, py);
+    });
 }
 
 // If an item that can be stolen is at x,y, return a pointer to it;
@@ -347,13 +889,14 @@ bool StudentWorld::existsClearShotToPlayer(int x, int y, int dir) const
 // going be goodies.)
 Actor* StudentWorld::getColocatedStealable(int x, int y) const
 {
-    list<Actor*>::const_iterator it;
-    for (it = m_actors.begin(); it != m_actors.end(); it++)
-    {
-        if ((*it)->isStealable() && (*it)->getX() == x && (*it)->getY() == y)
-            return (*it);
-    }
-    return nullptr;
+    return withCore([=](const auto& core) {
+        for (Actor* p = firstActorAt(core, x, y); p != nullptr; p = p->m_cellNext)
+        {
+            if (p->isStealable())
+                return p;
+        }
+        return static_cast<Actor*>(nullptr);
+    });
 }
 
 // If a factory is at x,y, how many items of the type that should be
@@ -365,18 +908,12 @@ Actor* StudentWorld::getColocatedStealable(int x, int y) const
 bool StudentWorld::doFactoryCensus(int x, int y, int distance, int& count) const
 {
     count = 0;
-    list<Actor*>::const_iterator it;
-    for (it = m_actors.begin(); it != m_actors.end(); it++)
-    {
-        if ((*it)->isAlive() && (*it)->countsInFactoryCensus())
-        {
-            //Return false if a thiefbot is on the same square as the factory
-            if ((*it)->getX() == x && (*it)->getY())
-                return false;
-            //Increment count if the thiefbot is in the specified area of the factory
-            else if (abs((*it)->getX() - x) <= 3 && abs((*it)->getY() - y) <= 3)
-                count++;
-        }
-    }
-    return true;
+    return withCore([&](const auto& core) {
+        //Return false if a thiefbot is on the same square as the factory
+        if (core.any(WorldCore::census_members, x, y))
+            return false;
+        //Count the thiefbots in the specified area of the factory
+        count = core.countIn(WorldCore::census_members, x - distance, y - distance, x + distance, y + distance);
+        return true;
+    });
 }
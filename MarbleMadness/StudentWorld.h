@@ -2,7 +2,11 @@
 #define STUDENTWORLD_H_
 
 #include "GameWorld.h"
+#include "WorldCore.h"
+#include "ChunkedLevel.h"
 #include <list>
+#include <memory>
+#include <vector>
 
 class Actor;
 class Agent;
@@ -83,15 +87,113 @@ public:
     void setLevelFinished() { levelDone = true; };
     
     // Add an actor to the world
-    void addActor(Actor* a) { m_actors.push_back(a); };
+    void addActor(Actor* a);
+    
+    // Add the actors on squares in the rectangle (from the spatial index)
+    virtual void getGraphObjectsIn(int minX, int minY, int maxX, int maxY,
+                                   std::vector<GraphObject*>& objects) const;
+    
+    // The camera follows the player
+    virtual bool getCameraFocus(double& x, double& y) const;
+    
+    // Update the spatial index after an actor changed squares
+    void actorMoved(Actor* a);
+    
+    // Update the spatial index after an actor died
+    void actorDied(Actor* a);
     
   private:
     Player* m_player;
     std::list<Actor*> m_actors;
+    //Actors that never do anything on their turn (walls), kept out of
+    //the per-tick loops
+    std::list<Actor*> m_inertActors;
+    //Per-square actor lists (linked through the actors themselves) and
+    //bitboards of what blocks what, so lookups don't scan every actor.
+    //While a level is loaded exactly one core exists: the compile-time
+    //one for standard 15x15 boards, the runtime-sized one otherwise.
+    //m_core is whichever it is, for code that only needs its extent
+    std::unique_ptr<FixedCore> m_fixedCore;
+    std::unique_ptr<GenericCore> m_genericCore;
+    WorldCore* m_core;
+    long long m_nextSerial;
     bool calledClean;
     bool levelDone;
     int m_crystals;
     int m_bonus;
+    
+    //The values the game text was last built from (score, level, lives,
+    //health, ammo, bonus), so the text is only rebuilt when one changes
+    static const int NUM_GAME_TEXT_VALUES = 6;
+    int m_gameTextValues[NUM_GAME_TEXT_VALUES];
+    bool m_gameTextValid;
+    std::string m_gameText;
+    
+    //Streaming state for chunked (.lvc) levels: only chunks near the
+    //player have live actors; chunks the player has left are parked as
+    //compact records, and chunks never visited are still in the file
+    enum ChunkState { chunk_unloaded, chunk_active, chunk_parked };
+    std::unique_ptr<ChunkedLevel> m_chunked;
+    std::vector<unsigned char> m_chunkState;
+    std::vector<std::vector<ParkedActor>> m_parked;
+    int m_playerChunkX;
+    int m_playerChunkY;
+    
+    //Create the actor for a level's maze entry at x,y
+    void createActor(Level::MazeEntry item, int x, int y);
+    
+    //Set up a chunked level around the player
+    int initChunked(std::unique_ptr<ChunkedLevel> lev);
+    
+    //Park chunks the player has moved away from and activate the ones
+    //it has moved near
+    void updateStreaming();
+    
+    //Instantiate a chunk's actors from its parked records or the file
+    void activateChunk(int cx, int cy);
+    
+    //Remove every actor in the marked chunks, keeping records to restore
+    //them from
+    void parkChunks(const std::vector<int>& chunks);
+    
+    //Re-create the core as the window of chunks around the player's
+    void moveCoreWindow();
+    
+    //Is square x,y on the board and in a live chunk?
+    bool isActiveSquare(int x, int y) const;
+    
+    //Are all squares from x0,y0 to x1,y1 (on one row or column) live?
+    bool isActiveSpan(int x0, int y0, int x1, int y1) const;
+    
+    //Replace the core with an empty width x height one whose bottom-left
+    //square is originX,originY
+    void resetCore(int width, int height, int originX, int originY);
+    
+    //Return f(core) for the concrete core, so code written against it is
+    //compiled, and inlined, once per core type.  A level's core type
+    //never changes, so the one branch is always predicted
+    template <typename Function>
+    auto withCore(Function f) const
+    {
+        if (m_fixedCore)
+            return f(*m_fixedCore);
+        return f(*m_genericCore);
+    }
+    
+    //The first actor on square x,y, in the order actors were added
+    template <typename Core>
+    static Actor* firstActorAt(const Core& core, int x, int y);
+    
+    template <typename Core>
+    static void linkToCell(Core& core, Actor* a);
+    template <typename Core>
+    static void unlinkFromCell(Core& core, Actor* a);
+    
+    void linkToCell(Actor* a);
+    void unlinkFromCell(Actor* a);
+    
+    //The core layers a live actor occupies
+    static unsigned int layersOf(const Actor* a);
 };
 
 #endif // STUDENTWORLD_H_
@@ -0,0 +1,324 @@
+#ifndef TGAIMAGE_H_
+#define TGAIMAGE_H_
+
+#include "AssetArchive.h"
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+  // A TGA file decoded to 32-bit BGRA with the bottom row first (as
+  // OpenGL wants it).  Reads true-color images with or without alpha and
+  // 8-bit greyscale images, uncompressed (types 2 and 3) or run-length
+  // encoded (types 10 and 11); needs no GL context, so files can be
+  // decoded on any thread (see SpriteLoader).
+
+class TgaImage
+{
+  public:
+	TgaImage()
+	 : m_width(0), m_height(0), m_sourceHash(0), m_sourceBytes(0)
+	{
+	}
+
+	  // On failure, say why on cerr and return false.
+	bool load(const std::string& filename)
+	{
+		std::string why;
+		if (load(filename, why))
+			return true;
+		std::cerr << why << ": " << filename << std::endl;
+		return false;
+	}
+
+	  // Decode asset name straight from the asset archive if it has it,
+	  // otherwise from the file in the asset directory (pathPrefix, with a
+	  // trailing '/', or empty).  On failure set why instead of writing to
+	  // cerr, so this can run on any thread.
+	bool loadAsset(const std::string& pathPrefix, const std::string& name, std::string& why)
+	{
+		const unsigned char* data;
+		std::size_t size;
+		if (Assets().find(name, data, size))
+			return decode(data, size, why);
+		return load(pathPrefix + name, why);
+	}
+
+	  // Write the image as a run-length encoded 32-bit TGA file (type 10).
+	bool saveRle(const std::string& filename) const
+	{
+		TGA_HEADER header = TGA_HEADER();
+		header.image_type = 10;
+		header.width_pixels = static_cast<unsigned short>(m_width);
+		header.height_pixels = static_cast<unsigned short>(m_height);
+		header.pixel_depth = 32;
+		header.image_descriptor = 8;	// 8 alpha bits, bottom row first
+
+		std::vector<char> out(reinterpret_cast<const char*>(&header),
+							  reinterpret_cast<const char*>(&header) + sizeof(header));
+		  // Packets don't cross rows.  A repeated pixel is worth a run
+		  // packet; anything else goes in raw packets.
+		for (int y = 0; y < m_height; y++)
+		{
+			const std::uint32_t* row = &m_pixels[static_cast<std::size_t>(y) * m_width];
+			int x = 0;
+			while (x < m_width)
+			{
+				int run = 1;
+				while (x + run < m_width && run < 128 && row[x + run] == row[x])
+					run++;
+				if (run > 1)
+				{
+					out.push_back(static_cast<char>(0x80 | (run - 1)));
+					appendPixels(out, &row[x], 1);
+					x += run;
+					continue;
+				}
+				int raw = 1;
+				while (x + raw < m_width && raw < 128 &&
+					   (x + raw + 1 >= m_width || row[x + raw] != row[x + raw + 1]))
+					raw++;
+				out.push_back(static_cast<char>(raw - 1));
+				appendPixels(out, &row[x], raw);
+				x += raw;
+			}
+		}
+
+		std::ofstream tgaFile(filename, std::ios::out|std::ios::binary);
+		tgaFile.write(out.data(), out.size());
+		return static_cast<bool>(tgaFile);
+	}
+
+	int width() const
+	{
+		return m_width;
+	}
+
+	int height() const
+	{
+		return m_height;
+	}
+
+	  // BGRA, bottom row first
+	const char* pixels() const
+	{
+		return reinterpret_cast<const char*>(m_pixels.data());
+	}
+
+	  // A hash of the file the image was decoded from, and the file's
+	  // length, which together identify anything derived from it (see
+	  // MipCache)
+	std::uint64_t sourceHash() const
+	{
+		return m_sourceHash;
+	}
+
+	std::uint64_t sourceBytes() const
+	{
+		return m_sourceBytes;
+	}
+
+  private:
+
+#pragma pack(1)
+  struct TGA_HEADER {
+    unsigned char id_length;
+    unsigned char color_map_type;
+    unsigned char image_type;
+    unsigned short index_of_first_color_map_entry;
+    unsigned short color_map_length;
+    unsigned char color_map_entry_size;
+    unsigned short x_origin;
+    unsigned short y_origin;
+    unsigned short width_pixels;
+    unsigned short height_pixels;
+    unsigned char pixel_depth;
+    unsigned char image_descriptor; // bits 3-0 give alpha channel depth, and 5-4 give direction.
+  };
+#pragma pack()
+
+	int							m_width;
+	int							m_height;
+	std::vector<std::uint32_t>	m_pixels;	// each pixel's bytes in BGRA order
+	std::uint64_t				m_sourceHash;
+	std::uint64_t				m_sourceBytes;
+
+	  // Read the whole file with one read, then decode it; on failure set
+	  // why instead of writing to cerr (this may run on a worker thread).
+	bool load(const std::string& filename, std::string& why)
+	{
+		std::ifstream tgaFile(filename, std::ios::in|std::ios::binary|std::ios::ate);
+		if (!tgaFile) {
+			why = "Unable to open file in binary mode";
+			return false;
+		}
+		std::vector<unsigned char> data(static_cast<std::size_t>(tgaFile.tellg()));
+		tgaFile.seekg(0);
+		tgaFile.read(reinterpret_cast<char*>(data.data()), data.size());
+		if (!tgaFile) {
+			why = "Unable to read file";
+			return false;
+		}
+		return decode(data.data(), data.size(), why);
+	}
+
+	bool decode(const unsigned char* data, std::size_t size, std::string& why)
+	{
+		TGA_HEADER header;
+		if (size < sizeof(header)) {
+			why = "Truncated header";
+			return false;
+		}
+		std::memcpy(&header, data, sizeof(header));
+		m_sourceHash = hashBytes(data, size);
+		m_sourceBytes = size;
+
+		  // image type 2 (color) or 3 (greyscale), or 10 and 11 for the
+		  // same run-length encoded
+		const int baseType = header.image_type & ~8;
+		if (header.color_map_type != 0 || (baseType != 2 && baseType != 3)) {
+			why = "Bad image type";
+			return false;
+		}
+
+		const int byteCount = header.pixel_depth / 8;
+		if (byteCount != 3 && byteCount != 4 && !(baseType == 3 && byteCount == 1)) {
+			why = "Bad byte count " + std::to_string(byteCount);
+			return false;
+		}
+
+		m_width = header.width_pixels;
+		m_height = header.height_pixels;
+		m_pixels.resize(static_cast<std::size_t>(m_width) * m_height);
+		const bool topFirst = (header.image_descriptor & 0x20) != 0;
+		std::size_t pos = sizeof(header) + header.id_length;
+
+		  // Rows are written straight to where they belong, so images
+		  // stored top row first need no separate flip.
+		auto destRow = [&](int row) {
+			return &m_pixels[static_cast<std::size_t>(topFirst ? m_height - 1 - row : row) * m_width];
+		};
+
+		if (!(header.image_type & 8))
+		{
+			const std::size_t rowBytes = static_cast<std::size_t>(m_width) * byteCount;
+			if (pos > size || (size - pos) / std::max<std::size_t>(rowBytes, 1) < static_cast<std::size_t>(m_height)) {
+				why = "Truncated image data";
+				return false;
+			}
+			for (int row = 0; row < m_height; row++, pos += rowBytes)
+				convertPixels(data + pos, destRow(row), m_width, byteCount);
+			return true;
+		}
+
+		  // Each packet is a count byte and either one pixel to repeat (high
+		  // bit set) or that many literal pixels.  Packets may run on from
+		  // one row into the next.
+		int row = 0;
+		int x = 0;
+		while (row < m_height && m_width > 0)
+		{
+			if (pos >= size) {
+				why = "Truncated run-length data";
+				return false;
+			}
+			const unsigned char packet = data[pos++];
+			int count = (packet & 0x7f) + 1;
+			const bool repeat = (packet & 0x80) != 0;
+			const std::size_t packetBytes = static_cast<std::size_t>(repeat ? 1 : count) * byteCount;
+			if (size - pos < packetBytes) {
+				why = "Truncated run-length data";
+				return false;
+			}
+			const unsigned char* src = data + pos;
+			pos += packetBytes;
+
+			std::uint32_t value = 0;
+			if (repeat)
+				convertPixels(src, &value, 1, byteCount);
+			while (count > 0 && row < m_height)
+			{
+				int n = std::min(count, m_width - x);
+				std::uint32_t* dst = destRow(row) + x;
+				if (repeat)
+					std::fill(dst, dst + n, value);
+				else
+				{
+					convertPixels(src, dst, n, byteCount);
+					src += static_cast<std::size_t>(n) * byteCount;
+				}
+				count -= n;
+				x += n;
+				if (x == m_width)
+				{
+					x = 0;
+					row++;
+				}
+			}
+		}
+		return true;
+	}
+
+	static void convertPixels(const unsigned char* src, std::uint32_t* dst, int count, int byteCount)
+	{
+		if (byteCount == 4)
+		{
+			std::memcpy(dst, src, static_cast<std::size_t>(count) * 4);
+			return;
+		}
+		unsigned char* out = reinterpret_cast<unsigned char*>(dst);
+		for (int i = 0; i < count; i++, out += 4, src += byteCount)
+		{
+			out[0] = src[0];
+			out[1] = src[byteCount == 1 ? 0 : 1];
+			out[2] = src[byteCount == 1 ? 0 : 2];
+			out[3] = 255;
+		}
+	}
+
+	  // 8 bytes at a time (a byte at a time is needlessly slow for whole
+	  // files), each word scrambled before it is folded in and the result
+	  // finalized, as in MurmurHash3, so every input bit reaches every bit
+	  // of the hash
+	static std::uint64_t hashBytes(const unsigned char* data, std::size_t size)
+	{
+		const std::uint64_t C1 = 0x87c37b91114253d5ULL;
+		const std::uint64_t C2 = 0x4cf5ad432745937fULL;
+		std::uint64_t hash = 0xcbf29ce484222325ULL;
+		std::size_t i = 0;
+		for ( ; i + 8 <= size; i += 8)
+		{
+			std::uint64_t word;
+			std::memcpy(&word, data + i, 8);
+			hash ^= rotl(word * C1, 31) * C2;
+			hash = rotl(hash, 27) * 5 + 0x52dce729;
+		}
+		std::uint64_t tail = 0;
+		for (std::size_t shift = 0; i < size; i++, shift += 8)
+			tail |= static_cast<std::uint64_t>(data[i]) << shift;
+		hash ^= rotl(tail * C1, 31) * C2;
+		hash ^= size;
+
+		hash ^= hash >> 33;
+		hash *= 0xff51afd7ed558ccdULL;
+		hash ^= hash >> 33;
+		hash *= 0xc4ceb9fe1a85ec53ULL;
+		return hash ^ (hash >> 33);
+	}
+
+	static std::uint64_t rotl(std::uint64_t x, int bits)
+	{
+		return (x << bits) | (x >> (64 - bits));
+	}
+
+	static void appendPixels(std::vector<char>& out, const std::uint32_t* pixels, int count)
+	{
+		const char* bytes = reinterpret_cast<const char*>(pixels);
+		out.insert(out.end(), bytes, bytes + static_cast<std::size_t>(count) * 4);
+	}
+};
+
+#endif // TGAIMAGE_H_
@@ -0,0 +1,129 @@
+#ifndef TICKSCHEDULER_H_
+#define TICKSCHEDULER_H_
+
+#include <chrono>
+#include <cmath>
+#include <ostream>
+#include <algorithm>
+
+  // Schedules simulation ticks against absolute deadlines on a monotonic
+  // clock, so the time spent simulating and rendering a tick doesn't
+  // stretch the tick period.  When the caller falls behind, up to
+  // maxCatchUp overdue ticks are reported as due at once (the caller runs
+  // them back to back and renders only the last); anything beyond that is
+  // dropped and the schedule skips ahead to the next future deadline.
+
+class TickScheduler
+{
+  public:
+	using Clock = std::chrono::steady_clock;
+
+	TickScheduler()
+	 : m_period(std::chrono::milliseconds(10)), m_maxCatchUp(5)
+	{
+		start(Clock::now());
+	}
+
+	void setPeriod(Clock::duration period)
+	{
+		m_period = std::max(period, Clock::duration(1));
+	}
+
+	Clock::duration getPeriod() const
+	{
+		return m_period;
+	}
+
+	void setMaxCatchUp(int ticks)
+	{
+		m_maxCatchUp = std::max(ticks, 1);
+	}
+
+	void start(Clock::time_point now)
+	{
+		m_startTime = now;
+		m_deadline = now;
+		m_ticks = 0;
+		m_catchUpTicks = 0;
+		m_droppedTicks = 0;
+		m_samples = 0;
+		m_latenessMean = 0;
+		m_latenessM2 = 0;
+		m_latenessMax = 0;
+	}
+
+	Clock::time_point nextDeadline() const
+	{
+		return m_deadline;
+	}
+
+	  // Restart the deadline sequence from now without resetting statistics,
+	  // e.g. after the period changed or after ticks ran unscheduled.
+	void resync(Clock::time_point now)
+	{
+		m_deadline = now;
+	}
+
+	  // Count a tick the caller ran without waiting for a deadline.
+	void countUnscheduledTick()
+	{
+		m_ticks++;
+	}
+
+	  // Return how many ticks should be run now (0 if the next deadline
+	  // hasn't arrived yet), and advance the deadline past them.
+	int ticksDue(Clock::time_point now)
+	{
+		if (now < m_deadline)
+			return 0;
+
+		Clock::duration late = now - m_deadline;
+		recordLateness(std::chrono::duration<double, std::milli>(late).count());
+
+		long long overdue = late / m_period + 1;
+		int due = static_cast<int>(std::min<long long>(overdue, m_maxCatchUp));
+		m_deadline += overdue * m_period;
+		m_ticks += due;
+		m_catchUpTicks += due - 1;
+		m_droppedTicks += overdue - due;
+		return due;
+	}
+
+	void report(std::ostream& os) const
+	{
+		double elapsed = std::chrono::duration<double>(Clock::now() - m_startTime).count();
+		double stddev = (m_samples > 1 ? std::sqrt(m_latenessM2 / (m_samples - 1)) : 0);
+		os << "Tick scheduler: " << m_ticks << " ticks in " << elapsed << "s ("
+		   << (elapsed > 0 ? m_ticks / elapsed : 0) << " Hz, target "
+		   << 1 / std::chrono::duration<double>(m_period).count() << " Hz)" << std::endl;
+		os << "  wakeup jitter: mean " << m_latenessMean << "ms, stddev " << stddev
+		   << "ms, max " << m_latenessMax << "ms" << std::endl;
+		os << "  " << m_catchUpTicks << " catch-up ticks (frames skipped), "
+		   << m_droppedTicks << " ticks dropped" << std::endl;
+	}
+
+  private:
+	Clock::duration		m_period;
+	int					m_maxCatchUp;
+	Clock::time_point	m_startTime;
+	Clock::time_point	m_deadline;
+	long long			m_ticks;
+	long long			m_catchUpTicks;
+	long long			m_droppedTicks;
+	long long			m_samples;
+	double				m_latenessMean;
+	double				m_latenessM2;
+	double				m_latenessMax;
+
+	void recordLateness(double ms)
+	{
+		  // Welford's running mean/variance
+		m_samples++;
+		double delta = ms - m_latenessMean;
+		m_latenessMean += delta / m_samples;
+		m_latenessM2 += delta * (ms - m_latenessMean);
+		m_latenessMax = std::max(m_latenessMax, ms);
+	}
+};
+
+#endif // TICKSCHEDULER_H_
@@ -0,0 +1,169 @@
+#include "Tracer.h"
+#include "Profiler.h"
+#include <iostream>
+using namespace std;
+
+  // How often the flusher drains the rings
+static const chrono::milliseconds FLUSH_INTERVAL(20);
+
+bool Tracer::start(const string& path)
+{
+	if (m_enabled)
+		return true;
+
+	m_out.open(path);
+	if (!m_out)
+		return false;
+	m_out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	m_firstEvent = true;
+	m_stopping = false;
+	m_startTime = chrono::steady_clock::now();
+	m_flusher = thread(&Tracer::flusherLoop, this);
+	m_enabled = true;
+	return true;
+}
+
+void Tracer::stop()
+{
+	if (!m_enabled)
+		return;
+	m_enabled = false;
+
+	{
+		lock_guard<mutex> lock(m_flushMutex);
+		m_stopping = true;
+	}
+	m_flushWakeup.notify_one();
+	m_flusher.join();
+
+	drainRings();
+	m_out << "\n]}\n";
+	m_out.close();
+
+	uint64_t dropped = 0;
+	for (const auto& r : m_rings)
+		dropped += r->dropped;
+	if (dropped > 0)
+		cerr << "Tracer: " << dropped << " events dropped because a ring was full" << endl;
+}
+
+Tracer::Ring* Tracer::ringForThisThread()
+{
+	static thread_local Ring* ring = nullptr;
+	if (ring == nullptr)
+	{
+		lock_guard<mutex> lock(m_ringsMutex);
+		m_rings.emplace_back(new Ring(static_cast<int>(m_rings.size()) + 1));
+		ring = m_rings.back().get();
+	}
+	return ring;
+}
+
+void Tracer::push(const Event& e)
+{
+	Ring* ring = ringForThisThread();
+	size_t head = ring->head.load(memory_order_relaxed);
+	if (head - ring->tail.load(memory_order_acquire) == Ring::CAPACITY)
+	{
+		ring->dropped.store(ring->dropped.load(memory_order_relaxed) + 1, memory_order_relaxed);
+		return;
+	}
+	ring->events[head & (Ring::CAPACITY - 1)] = e;
+	ring->head.store(head + 1, memory_order_release);
+}
+
+void Tracer::complete(const char* name, const char* category, uint64_t startNs, uint64_t durationNs)
+{
+	if (!isEnabled())
+		return;
+	Event e = { name, category, nullptr, startNs, durationNs, NO_POSITION, NO_POSITION, 'X' };
+	push(e);
+}
+
+void Tracer::instant(const char* name, const char* category, const char* detail, int x, int y)
+{
+	if (!isEnabled())
+		return;
+	Event e = { name, category, detail, now(), 0, x, y, 'i' };
+	push(e);
+}
+
+void Tracer::nameThisThread(const char* name)
+{
+	if (isEnabled())
+		ringForThisThread()->threadName = name;
+}
+
+const char* Tracer::internTypeName(const type_info& type)
+{
+	lock_guard<mutex> lock(m_namesMutex);
+	string& name = m_typeNames[type_index(type)];
+	if (name.empty())
+		name = readableTypeName(type.name());
+	return name.c_str();
+}
+
+void Tracer::flusherLoop()
+{
+	unique_lock<mutex> lock(m_flushMutex);
+	while (!m_stopping)
+	{
+		m_flushWakeup.wait_for(lock, FLUSH_INTERVAL);
+		drainRings();
+	}
+}
+
+void Tracer::drainRings()
+{
+	vector<Ring*> rings;
+	{
+		lock_guard<mutex> lock(m_ringsMutex);
+		for (const auto& r : m_rings)
+			rings.push_back(r.get());
+	}
+
+	for (Ring* ring : rings)
+	{
+		const char* threadName = ring->threadName;
+		if (threadName != nullptr && !ring->nameWritten)
+		{
+			m_out << (m_firstEvent ? "\n" : ",\n")
+				  << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->tid
+				  << ",\"args\":{\"name\":\"" << threadName << "\"}}";
+			m_firstEvent = false;
+			ring->nameWritten = true;
+		}
+
+		size_t tail = ring->tail.load(memory_order_relaxed);
+		size_t head = ring->head.load(memory_order_acquire);
+		for ( ; tail != head; tail++)
+			writeEvent(ring->events[tail & (Ring::CAPACITY - 1)], ring->tid);
+		ring->tail.store(tail, memory_order_release);
+	}
+	m_out.flush();
+}
+
+void Tracer::writeEvent(const Event& e, int tid)
+{
+	m_out << (m_firstEvent ? "\n" : ",\n");
+	m_firstEvent = false;
+
+	m_out << "{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category
+		  << "\",\"ph\":\"" << e.phase << "\",\"pid\":1,\"tid\":" << tid
+		  << ",\"ts\":" << e.start / 1000 << '.' << (e.start % 1000) / 100 << (e.start % 100) / 10 << e.start % 10;
+	if (e.phase == 'X')
+		m_out << ",\"dur\":" << e.duration / 1000 << '.' << (e.duration % 1000) / 100 << (e.duration % 100) / 10 << e.duration % 10;
+	else if (e.phase == 'i')
+		m_out << ",\"s\":\"t\"";
+
+	if (e.detail != nullptr || e.x != NO_POSITION)
+	{
+		m_out << ",\"args\":{";
+		if (e.detail != nullptr)
+			m_out << "\"detail\":\"" << e.detail << '"' << (e.x != NO_POSITION ? "," : "");
+		if (e.x != NO_POSITION)
+			m_out << "\"x\":" << e.x << ",\"y\":" << e.y;
+		m_out << '}';
+	}
+	m_out << '}';
+}
@@ -0,0 +1,165 @@
+#ifndef TRACER_H_
+#define TRACER_H_
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+  // Records a timeline of the game in Chrome trace-event JSON, viewable in
+  // chrome://tracing or Perfetto.  Each thread appends fixed-size events to
+  // its own lock-free ring; a background thread drains the rings and writes
+  // them out, so recording an event costs a clock read and a few stores.
+  // If a ring fills up before it is drained, further events from that
+  // thread are dropped (and counted) rather than blocking.
+  //
+  // Names, categories and details must be string literals or otherwise
+  // outlive the tracer (see internTypeName).
+
+class Tracer
+{
+  public:
+	static const int NO_POSITION = INT_MIN;
+
+	  // Start writing a trace to path.  Return false if it can't be opened.
+	bool start(const std::string& path);
+
+	  // Write out everything recorded so far and close the trace.
+	void stop();
+
+	bool isEnabled() const
+	{
+		return m_enabled.load(std::memory_order_relaxed);
+	}
+
+	  // Nanoseconds since tracing started
+	std::uint64_t now() const
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now() - m_startTime).count();
+	}
+
+	  // Record a span that started at startNs and lasted durationNs.
+	void complete(const char* name, const char* category, std::uint64_t startNs, std::uint64_t durationNs);
+
+	  // Record a point event, optionally with a detail string and position.
+	void instant(const char* name, const char* category, const char* detail = nullptr,
+				 int x = NO_POSITION, int y = NO_POSITION);
+
+	  // Label the calling thread in the trace viewer.
+	void nameThisThread(const char* name);
+
+	  // Return a readable type name that lives as long as the tracer.
+	const char* internTypeName(const std::type_info& type);
+
+	static Tracer& getInstance()
+	{
+		static Tracer instance;
+		return instance;
+	}
+
+  private:
+	struct Event
+	{
+		const char*		name;
+		const char*		category;
+		const char*		detail;
+		std::uint64_t	start;
+		std::uint64_t	duration;
+		int				x;
+		int				y;
+		char			phase;
+	};
+
+	struct Ring
+	{
+		static const std::size_t CAPACITY = 1 << 16;	// power of two
+
+		Event						events[CAPACITY];
+		std::atomic<std::size_t>	head;		// written by the owning thread
+		std::atomic<std::size_t>	tail;		// written by the flusher
+		std::atomic<std::uint64_t>	dropped;
+		int							tid;
+		std::atomic<const char*>	threadName;
+		bool						nameWritten;
+
+		Ring(int id)
+		 : head(0), tail(0), dropped(0), tid(id), threadName(nullptr), nameWritten(false)
+		{}
+	};
+
+	std::atomic<bool>		m_enabled;
+	std::chrono::steady_clock::time_point m_startTime;
+	std::ofstream			m_out;
+	bool					m_firstEvent;
+	std::mutex				m_ringsMutex;
+	std::vector<std::unique_ptr<Ring>> m_rings;
+	std::mutex				m_namesMutex;
+	std::unordered_map<std::type_index, std::string> m_typeNames;
+	std::thread				m_flusher;
+	std::mutex				m_flushMutex;
+	std::condition_variable	m_flushWakeup;
+	bool					m_stopping;
+
+	Tracer()
+	 : m_enabled(false), m_firstEvent(true), m_stopping(false)
+	{}
+
+	~Tracer()
+	{
+		stop();
+	}
+
+	Ring* ringForThisThread();
+	void push(const Event& e);
+	void flusherLoop();
+	void drainRings();
+	void writeEvent(const Event& e, int tid);
+
+	Tracer(const Tracer&);
+	Tracer& operator=(const Tracer&);
+};
+
+inline Tracer& Trace()
+{
+	return Tracer::getInstance();
+}
+
+  // Record the lifetime of a scope as a complete event, if tracing is on.
+class ScopedTrace
+{
+  public:
+	ScopedTrace(const char* name, const char* category)
+	 : m_name(name), m_category(category), m_enabled(Trace().isEnabled())
+	{
+		if (m_enabled)
+			m_start = Trace().now();
+	}
+
+	~ScopedTrace()
+	{
+		if (m_enabled)
+			Trace().complete(m_name, m_category, m_start, Trace().now() - m_start);
+	}
+
+  private:
+	const char*		m_name;
+	const char*		m_category;
+	bool			m_enabled;
+	std::uint64_t	m_start;
+
+	ScopedTrace(const ScopedTrace&);
+	ScopedTrace& operator=(const ScopedTrace&);
+};
+
+#endif // TRACER_H_
@@ -0,0 +1,59 @@
+#ifndef TRIPLEBUFFER_H_
+#define TRIPLEBUFFER_H_
+
+#include <atomic>
+
+  // Lock-free single-producer/single-consumer triple buffer.  The writer
+  // fills writeBuffer() and publish()es it; the reader calls update() to
+  // pick up the most recently published buffer (if any) and then reads
+  // readBuffer().  Neither side ever waits for the other, and buffers the
+  // reader never got around to are simply overwritten.
+
+template <typename T>
+class TripleBuffer
+{
+  public:
+	TripleBuffer()
+	 : m_back(0), m_middle(1), m_front(2)
+	{
+	}
+
+	T& writeBuffer()
+	{
+		return m_buffers[m_back];
+	}
+
+	void publish()
+	{
+		m_back = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	  // Return true if a newer buffer than the current read buffer was published.
+	bool update()
+	{
+		if ((m_middle.load(std::memory_order_relaxed) & FRESH) == 0)
+			return false;
+		m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+
+	const T& readBuffer() const
+	{
+		return m_buffers[m_front];
+	}
+
+  private:
+	static const unsigned int INDEX_MASK = 0x3;
+	static const unsigned int FRESH = 0x4;
+
+	T							m_buffers[3];
+	unsigned int				m_back;		// writer only
+	std::atomic<unsigned int>	m_middle;	// shared; FRESH set if unread
+	unsigned int				m_front;	// reader only
+
+	  // Prevent copying or assigning TripleBuffers
+	TripleBuffer(const TripleBuffer&);
+	TripleBuffer& operator=(const TripleBuffer&);
+};
+
+#endif // TRIPLEBUFFER_H_
@@ -0,0 +1,97 @@
+#include "WorkerPool.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+using namespace std;
+
+WorkerPool::~WorkerPool()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_jobPosted.notify_all();
+	for (thread& t : m_threads)
+		t.join();
+}
+
+void WorkerPool::post(function<void()> job)
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		startLocked();
+		m_jobs.push_back(std::move(job));
+	}
+	m_jobPosted.notify_one();
+}
+
+void WorkerPool::parallelFor(size_t count, const function<void(size_t)>& job)
+{
+	if (count == 0)
+		return;
+
+	  // Every participant takes the next index until there are none left,
+	  // so uneven jobs balance themselves.
+	struct Batch
+	{
+		atomic<size_t>		next{ 0 };
+		size_t				helpersLeft = 0;
+		mutex				m;
+		condition_variable	helpersDone;
+	};
+	shared_ptr<Batch> batch = make_shared<Batch>();
+	auto work = [batch, count, &job] {
+		for (size_t i; (i = batch->next++) < count; )
+			job(i);
+	};
+
+	size_t helpers = min(numThreads(), count - 1);
+	batch->helpersLeft = helpers;
+	for (size_t h = 0; h < helpers; h++)
+	{
+		post([batch, work] {
+			work();
+			lock_guard<mutex> lock(batch->m);
+			if (--batch->helpersLeft == 0)
+				batch->helpersDone.notify_one();
+		});
+	}
+	work();
+
+	unique_lock<mutex> lock(batch->m);
+	batch->helpersDone.wait(lock, [&batch] { return batch->helpersLeft == 0; });
+}
+
+size_t WorkerPool::numThreads()
+{
+	lock_guard<mutex> lock(m_mutex);
+	startLocked();
+	return m_threads.size();
+}
+
+void WorkerPool::startLocked()
+{
+	if (!m_threads.empty())
+		return;
+	unsigned int cores = thread::hardware_concurrency();
+	size_t count = max(cores, 2u) - 1;
+	for (size_t i = 0; i < count; i++)
+		m_threads.emplace_back(&WorkerPool::workLoop, this);
+}
+
+void WorkerPool::workLoop()
+{
+	for (;;)
+	{
+		function<void()> job;
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_jobPosted.wait(lock, [this] { return !m_jobs.empty() || m_stopping; });
+			if (m_jobs.empty())
+				return;
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+		}
+		job();
+	}
+}
@@ -0,0 +1,58 @@
+#ifndef WORKERPOOL_H_
+#define WORKERPOOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+  // A fixed set of worker threads (one fewer than the number of cores,
+  // but at least one) for work that can be spread across cores, such as
+  // decoding assets.  The threads are started the first time work is
+  // posted and live until the program exits.
+
+class WorkerPool
+{
+  public:
+	~WorkerPool();
+
+	static WorkerPool& getInstance()
+	{
+		static WorkerPool instance;
+		return instance;
+	}
+
+	  // Run job on a worker thread some time soon.
+	void post(std::function<void()> job);
+
+	  // Call job(i) for every i in [0, count), spread over the workers and
+	  // the calling thread, and return once every call has returned.  Jobs
+	  // must not call parallelFor themselves.
+	void parallelFor(std::size_t count, const std::function<void(std::size_t)>& job);
+
+	std::size_t numThreads();
+
+  private:
+	WorkerPool() = default;
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	std::mutex							m_mutex;
+	std::condition_variable				m_jobPosted;
+	std::deque<std::function<void()>>	m_jobs;
+	std::vector<std::thread>			m_threads;
+	bool								m_stopping = false;
+
+	void startLocked();
+	void workLoop();
+};
+
+inline WorkerPool& Workers()
+{
+	return WorkerPool::getInstance();
+}
+
+#endif // WORKERPOOL_H_
@@ -0,0 +1,304 @@
+#ifndef WORLDCORE_H_
+#define WORLDCORE_H_
+
+#include "GameConstants.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+class Actor;
+
+  // The board-shaped part of a StudentWorld: the head of each square's
+  // actor list, plus a bitboard per layer (what blocks agents, marbles and
+  // peas, and what a factory census counts) so that most questions about
+  // a square, a line of squares or a rectangle are answered by masking a
+  // few words instead of walking actor lists.  Each layer keeps a count
+  // per square; the square's bit is set while the count is nonzero.
+  // Rows are also kept transposed so column scans are word masks too.
+  // A core may cover just a window of a bigger board (when the level is
+  // streamed); its origin is the board square its bottom-left square is
+  // on, and all coordinates passed to it are board coordinates.
+
+class WorldCore
+{
+  public:
+	enum Layer {
+		agent_blockers, marble_blockers, pea_blockers, census_members,
+		NUM_LAYERS
+	};
+
+	static unsigned int layerBit(Layer layer)
+	{
+		return 1u << layer;
+	}
+
+	void setOrigin(int x, int y)
+	{
+		m_originX = x;
+		m_originY = y;
+	}
+
+	int originX() const
+	{
+		return m_originX;
+	}
+
+	int originY() const
+	{
+		return m_originY;
+	}
+
+	int width() const
+	{
+		return m_width;
+	}
+
+	int height() const
+	{
+		return m_height;
+	}
+
+  protected:
+	int	m_originX;
+	int	m_originY;
+	int	m_width;
+	int	m_height;
+
+	WorldCore(int width, int height)
+	 : m_originX(0), m_originY(0), m_width(width), m_height(height)
+	{
+	}
+};
+
+  // BoardCore<W, H> is sized at compile time, so its storage is std::array
+  // and every scan has constant bounds the compiler can unroll; a board
+  // up to 64 squares wide keeps each row of a layer in a single word.
+  // BoardCore<0, 0> is the same code sized at run time, for any board.
+  // Nothing is virtual: callers are written against the concrete core
+  // (see StudentWorld::withCore), so queries on either one inline.
+
+template <int W, int H>
+class BoardCore : public WorldCore
+{
+	static const bool FIXED = (W > 0 && H > 0);
+	static const int FIXED_ROW_WORDS = (W + 63) / 64;
+	static const int FIXED_COL_WORDS = (H + 63) / 64;
+
+	template <typename T, size_t N>
+	using Storage = typename std::conditional<FIXED, std::array<T, N>, std::vector<T>>::type;
+
+  public:
+	explicit BoardCore(int width = W, int height = H)
+	 : WorldCore(FIXED ? W : width, FIXED ? H : height)
+	{
+		clear(m_heads, cells());
+		for (int l = 0; l < NUM_LAYERS; l++)
+		{
+			clear(m_counts[l], cells());
+			clear(m_rows[l], static_cast<size_t>(h()) * rowWords());
+			clear(m_cols[l], static_cast<size_t>(w()) * colWords());
+		}
+	}
+
+	  // Index of square x,y in the core (row-major), or -1 if it is off
+	  // the core
+	int cellIndex(int x, int y) const
+	{
+		x -= m_originX;
+		y -= m_originY;
+		return onBoard(x, y) ? static_cast<int>(cell(x, y)) : -1;
+	}
+
+	  // Board coordinates of square number cell
+	int cellX(int cell) const
+	{
+		return m_originX + cell % w();
+	}
+
+	int cellY(int cell) const
+	{
+		return m_originY + cell / w();
+	}
+
+	  // First actor on square number cell
+	Actor*& head(int cell)
+	{
+		return m_heads[cell];
+	}
+
+	Actor* head(int cell) const
+	{
+		return m_heads[cell];
+	}
+
+	  // Add or remove one actor's worth of the given layers at x,y
+	void add(int x, int y, unsigned int layers)
+	{
+		x -= m_originX;
+		y -= m_originY;
+		if (!onBoard(x, y))
+			return;
+		for (int l = 0; l < NUM_LAYERS; l++)
+		{
+			if ((layers & layerBit(Layer(l))) && m_counts[l][cell(x, y)]++ == 0)
+			{
+				m_rows[l][rowWord(x, y)] |= bit(x);
+				m_cols[l][colWord(x, y)] |= bit(y);
+			}
+		}
+	}
+
+	void remove(int x, int y, unsigned int layers)
+	{
+		x -= m_originX;
+		y -= m_originY;
+		if (!onBoard(x, y))
+			return;
+		for (int l = 0; l < NUM_LAYERS; l++)
+		{
+			if ((layers & layerBit(Layer(l))) && --m_counts[l][cell(x, y)] == 0)
+			{
+				m_rows[l][rowWord(x, y)] &= ~bit(x);
+				m_cols[l][colWord(x, y)] &= ~bit(y);
+			}
+		}
+	}
+
+	  // Is anything in the layer at x,y?  (Nothing is off the board.)
+	bool any(Layer layer, int x, int y) const
+	{
+		x -= m_originX;
+		y -= m_originY;
+		return onBoard(x, y) && (m_rows[layer][rowWord(x, y)] & bit(x)) != 0;
+	}
+
+	  // Is anything in the layer strictly between x0,y0 and x1,y1, which
+	  // must be on the same row or column?
+	bool anyBetween(Layer layer, int x0, int y0, int x1, int y1) const
+	{
+		x0 -= m_originX, x1 -= m_originX;
+		y0 -= m_originY, y1 -= m_originY;
+		if (y0 == y1)
+		{
+			if (y0 < 0 || y0 >= h())
+				return false;
+			int lo = std::max(std::min(x0, x1) + 1, 0);
+			int hi = std::min(std::max(x0, x1) - 1, w() - 1);
+			return anyInRange(&m_rows[layer][static_cast<size_t>(y0) * rowWords()], lo, hi);
+		}
+		if (x0 < 0 || x0 >= w())
+			return false;
+		int lo = std::max(std::min(y0, y1) + 1, 0);
+		int hi = std::min(std::max(y0, y1) - 1, h() - 1);
+		return anyInRange(&m_cols[layer][static_cast<size_t>(x0) * colWords()], lo, hi);
+	}
+
+	  // How much of the layer is in the rectangle, clipped to the board?
+	int countIn(Layer layer, int minX, int minY, int maxX, int maxY) const
+	{
+		minX = std::max(minX - m_originX, 0);
+		minY = std::max(minY - m_originY, 0);
+		maxX = std::min(maxX - m_originX, w() - 1);
+		maxY = std::min(maxY - m_originY, h() - 1);
+		int count = 0;
+		for (int y = minY; y <= maxY; y++)
+		{
+			  // only rows with something in range need their counts summed
+			if (!anyInRange(&m_rows[layer][static_cast<size_t>(y) * rowWords()], minX, maxX))
+				continue;
+			for (int x = minX; x <= maxX; x++)
+				count += m_counts[layer][cell(x, y)];
+		}
+		return count;
+	}
+
+  private:
+	Storage<Actor*, size_t(W) * H>							m_heads;
+	Storage<std::uint16_t, size_t(W) * H>					m_counts[NUM_LAYERS];
+	Storage<std::uint64_t, size_t(H) * FIXED_ROW_WORDS>		m_rows[NUM_LAYERS];
+	Storage<std::uint64_t, size_t(W) * FIXED_COL_WORDS>		m_cols[NUM_LAYERS];
+
+	  // Compile-time constants for fixed boards, members otherwise
+	int w() const { return FIXED ? W : m_width; }
+	int h() const { return FIXED ? H : m_height; }
+	int rowWords() const { return FIXED ? FIXED_ROW_WORDS : (m_width + 63) / 64; }
+	int colWords() const { return FIXED ? FIXED_COL_WORDS : (m_height + 63) / 64; }
+	size_t cells() const { return static_cast<size_t>(w()) * h(); }
+
+	bool onBoard(int x, int y) const
+	{
+		return x >= 0 && x < w() && y >= 0 && y < h();
+	}
+
+	size_t cell(int x, int y) const
+	{
+		return static_cast<size_t>(y) * w() + x;
+	}
+
+	size_t rowWord(int x, int y) const
+	{
+		return static_cast<size_t>(y) * rowWords() + (x >> 6);
+	}
+
+	size_t colWord(int x, int y) const
+	{
+		return static_cast<size_t>(x) * colWords() + (y >> 6);
+	}
+
+	static std::uint64_t bit(int i)
+	{
+		return std::uint64_t(1) << (i & 63);
+	}
+
+	static bool anyInRange(const std::uint64_t* words, int lo, int hi)
+	{
+		if (lo > hi)
+			return false;
+		int first = lo >> 6;
+		int last = hi >> 6;
+		for (int i = first; i <= last; i++)
+		{
+			std::uint64_t mask = ~std::uint64_t(0);
+			if (i == first)
+				mask &= ~std::uint64_t(0) << (lo & 63);
+			if (i == last)
+				mask &= ~std::uint64_t(0) >> (63 - (hi & 63));
+			if (words[i] & mask)
+				return true;
+		}
+		return false;
+	}
+
+	  // Zero the storage, sizing it first if it's a vector
+	template <typename T, size_t N>
+	static void clear(std::array<T, N>& a, size_t)
+	{
+		a.fill(T());
+	}
+
+	template <typename T>
+	static void clear(std::vector<T>& v, size_t n)
+	{
+		v.assign(n, T());
+	}
+};
+
+  // The standard campaign board gets its own specialization; anything
+  // else uses the runtime-sized core.
+using FixedCore = BoardCore<VIEW_WIDTH, VIEW_HEIGHT>;
+using GenericCore = BoardCore<0, 0>;
+
+  // Whether StudentWorld may use FixedCore for a board that size (turned
+  // off to compare against the general core)
+
+inline
+bool& fixedSizeWorldCoresEnabled()
+{
+	static bool enabled = true;
+	return enabled;
+}
+
+#endif // WORLDCORE_H_
@@ -1,9 +1,23 @@
 #include "GameController.h"
+#include "Profiler.h"
+#include "Tracer.h"
+#include "Benchmark.h"
+#include "RenderBenchmark.h"
+#include "WorldCore.h"
+#include "ChunkedLevel.h"
+#include "ReplayExport.h"
+#include "TgaImage.h"
+#include "AssetArchive.h"
+#include "MipCache.h"
+#include "SoundFX.h"
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <cstdlib>
 #include <ctime>
+#include <cstring>
+#include <algorithm>
+#include <vector>
 using namespace std;
 
   // If your program is having trouble finding the Assets directory,
@@ -12,6 +26,7 @@ using namespace std;
 
 const string assetDirectory = "INSERT PATH";
 const int msPerTick = 10;  // 10ms per tick; increase this if game moves too fast
+const int maxCatchUpTicks = 5;  // overdue ticks run back to back before ticks are dropped
 
 #ifdef _MSC_VER
 #include <windows.h>
@@ -33,8 +48,254 @@ class GameWorld;
 
 GameWorld* createStudentWorld(string assetPath = "");
 
+  // Command line options:
+  //   --tick-ms=N   run at N ms per tick instead of msPerTick
+  //   --turbo       run gameplay uncapped, drawing at display refresh rate
+  //   --turbo=N     run gameplay uncapped, drawing every Nth tick
+  //   --viewport=N  on boards bigger than NxN, show NxN squares around the
+  //                 player (default 15); 0 shows the whole board shrunk to fit
+  //   --unbatched-sprites  draw each sprite with its own GL state and draw
+  //                 call instead of batching them (for comparison)
+  //   --headless[=DIR]  play with no window or GL, drawing frames in memory
+  //                 with the software renderer (and saving some in DIR);
+  //                 prompts are answered with Enter
+  //   --headless-ticks=N  stop a headless game after N ticks (default 2000)
+  //   --headless-every=N  save the frame of every Nth tick (default 100)
+  //   --record=FILE  save the game's seed and input to FILE when it ends
+  //   --replay=FILE  play back a recorded game instead of taking input
+  //   --capture=PATH  write the frames drawn to PATH, a .y4m video file or
+  //                 otherwise a directory of PNG files (with --headless,
+  //                 one frame per tick; in a window, one per redraw)
+  //   --export-replays=DIR  render each replay file named after the other
+  //                 options to DIR/<name>.y4m, several at once
+  //   --export-jobs=N  replays exported at a time (default: one per core)
+  //   --profile     time tick phases and actor updates; dumped on exit or 'p'
+  //   --trace=FILE  write a Chrome/Perfetto trace-event timeline to FILE
+  //   --generic-core  use the runtime-sized world core even for 15x15
+  //                 boards (to compare against the specialized one)
+  //   --bench-sim[=NAME]  run the simulation benchmarks (those whose name
+  //                 contains NAME) instead of the game
+  //   --bench-ticks=N, --bench-seed=N  benchmark length and random seed
+  //   --bench-render     run the render benchmarks instead of the game
+  //   --bench-frames=N   frames per render benchmark
+  //   --bench-shots=DIR  save the last frame of each render benchmark in DIR
+  //   --chunk-level=IN[,OUT]  convert text level IN to the chunked format
+  //                 (OUT defaults to IN with .lvc in place of .txt)
+  //   --compress-tga=IN[,OUT]  rewrite TGA image IN run-length encoded
+  //                 (OUT defaults to IN)
+  //   --pack-assets=DIR[,OUT]  pack the sprites, sounds and levels in DIR
+  //                 into one archive (OUT defaults to DIR/assets.pak)
+  //   --assets=FILE  read assets from archive FILE (by default, assets.pak
+  //                 in the asset directory is used if it's there)
+  //   --mip-cache=DIR  keep scaled, mipmapped sprites in DIR (by default a
+  //                 directory in the user's cache directory); empty turns
+  //                 the cache off
+  //   --audio-out=FILE  record the game's sound to WAV file FILE (in step
+  //                 with the game's ticks) instead of playing it
+  // Recognized options are removed from argv; the rest are left for GLUT.
+
+struct HeadlessOptions
+{
+	bool			run = false;
+	string			frameDir;
+	long long		ticks = 2000;
+	int				every = 100;
+};
+
+struct ExportOptions
+{
+	string				outDir;
+	unsigned int		jobs = 0;
+	vector<string>		passOn;		// options each exported replay is run with
+};
+
+struct BenchOptions
+{
+	bool			run = false;
+	string			filter;
+	int				ticks = 2000;
+	unsigned int	seed = 12345;
+	bool			render = false;
+	int				frames = 100;
+	string			shotDir;
+};
+
+static bool parseOptions(int& argc, char* argv[], int& tickMs, BenchOptions& bench, HeadlessOptions& headless,
+						 ExportOptions& exporting, string& chunkLevel, string& compressTga, string& packAssets,
+						 string& archive)
+{
+	int kept = 1;
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		if (strncmp(arg, "--tick-ms=", 10) == 0)
+			tickMs = max(atoi(arg + 10), 1);
+		else if (strcmp(arg, "--turbo") == 0)
+			Game().setTurbo(true);
+		else if (strncmp(arg, "--turbo=", 8) == 0)
+			Game().setTurbo(true, atoi(arg + 8));
+		else if (strncmp(arg, "--viewport=", 11) == 0)
+			Game().setViewport(atoi(arg + 11));
+		else if (strcmp(arg, "--unbatched-sprites") == 0)
+			Game().setSpriteBatching(false);
+		else if (strcmp(arg, "--headless") == 0)
+			headless.run = true;
+		else if (strncmp(arg, "--headless=", 11) == 0)
+			headless.run = true, headless.frameDir = arg + 11;
+		else if (strncmp(arg, "--headless-ticks=", 17) == 0)
+			headless.ticks = max(atoll(arg + 17), 1LL);
+		else if (strncmp(arg, "--headless-every=", 17) == 0)
+			headless.every = max(atoi(arg + 17), 1);
+		else if (strncmp(arg, "--record=", 9) == 0)
+		{
+			if (!Game().setRecording(arg + 9))
+			{
+				cerr << "Cannot write " << (arg + 9) << endl;
+				return false;
+			}
+		}
+		else if (strncmp(arg, "--replay=", 9) == 0)
+		{
+			if (!Game().setReplay(arg + 9))
+			{
+				cerr << "Cannot read replay " << (arg + 9) << endl;
+				return false;
+			}
+		}
+		else if (strncmp(arg, "--capture=", 10) == 0)
+			Game().setCapture(arg + 10);
+		else if (strncmp(arg, "--export-replays=", 17) == 0)
+			exporting.outDir = arg + 17;
+		else if (strncmp(arg, "--export-jobs=", 14) == 0)
+			exporting.jobs = static_cast<unsigned int>(max(atoi(arg + 14), 1));
+		else if (strcmp(arg, "--profile") == 0)
+			Profile().setEnabled(true);
+		else if (strcmp(arg, "--generic-core") == 0)
+			fixedSizeWorldCoresEnabled() = false;
+		else if (strcmp(arg, "--bench-sim") == 0)
+			bench.run = true;
+		else if (strncmp(arg, "--bench-sim=", 12) == 0)
+			bench.run = true, bench.filter = arg + 12;
+		else if (strcmp(arg, "--bench-render") == 0)
+			bench.render = true;
+		else if (strncmp(arg, "--bench-frames=", 15) == 0)
+			bench.frames = max(atoi(arg + 15), 1);
+		else if (strncmp(arg, "--bench-shots=", 14) == 0)
+			bench.shotDir = arg + 14;
+		else if (strncmp(arg, "--bench-ticks=", 14) == 0)
+			bench.ticks = max(atoi(arg + 14), 1);
+		else if (strncmp(arg, "--bench-seed=", 13) == 0)
+			bench.seed = static_cast<unsigned int>(strtoul(arg + 13, nullptr, 10));
+		else if (strncmp(arg, "--chunk-level=", 14) == 0)
+			chunkLevel = arg + 14;
+		else if (strncmp(arg, "--compress-tga=", 15) == 0)
+			compressTga = arg + 15;
+		else if (strncmp(arg, "--pack-assets=", 14) == 0)
+			packAssets = arg + 14;
+		else if (strncmp(arg, "--assets=", 9) == 0)
+			archive = arg + 9;
+		else if (strncmp(arg, "--mip-cache=", 12) == 0)
+			Mips().setDirectory(arg + 12);
+		else if (strncmp(arg, "--audio-out=", 12) == 0)
+			SoundFX().setOutputFile(arg + 12);
+		else if (strncmp(arg, "--trace=", 8) == 0)
+		{
+			if (!Trace().start(arg + 8))
+				cerr << "Cannot open trace file " << (arg + 8) << endl;
+		}
+		else
+			argv[kept++] = argv[i];
+
+		if (strncmp(arg, "--tick-ms=", 10) == 0 || strncmp(arg, "--viewport=", 11) == 0 ||
+			strncmp(arg, "--assets=", 9) == 0)
+			exporting.passOn.push_back(arg);
+	}
+	argc = kept;
+	argv[argc] = nullptr;
+	return true;
+}
+
+  // Rewrite a TGA image ("IN[,OUT]") with run-length encoding.
+static int compressImage(const string& spec)
+{
+	string in = spec.substr(0, spec.find(','));
+	string out = (spec.find(',') != string::npos ? spec.substr(spec.find(',') + 1) : in);
+	TgaImage image;
+	if (!image.load(in))
+		return 1;
+	if (!image.saveRle(out))
+	{
+		cerr << "Cannot write " << out << endl;
+		return 1;
+	}
+	ifstream written(out, ios::binary|ios::ate);
+	cout << "Wrote " << image.width() << "x" << image.height() << " image to " << out << " ("
+		 << written.tellg() << " bytes)" << endl;
+	return 0;
+}
+
+  // Convert a text level ("IN[,OUT]") to the chunked format that is
+  // streamed in as the player moves.
+static int convertLevel(const string& spec)
+{
+	string in = spec.substr(0, spec.find(','));
+	string out = (spec.find(',') != string::npos ? spec.substr(spec.find(',') + 1) : "");
+	if (out.empty())
+	{
+		out = in;
+		if (out.size() > 4 && out.compare(out.size() - 4, 4, ".txt") == 0)
+			out.erase(out.size() - 4);
+		out += ".lvc";
+	}
+
+	Level lev("");
+	Level::LoadResult res = lev.loadLevel(in);
+	if (res != Level::load_success)
+	{
+		cerr << (res == Level::load_fail_file_not_found ? "Cannot find " : "Bad level format in ") << in << endl;
+		return 1;
+	}
+	if (!ChunkedLevel::convert(lev, out))
+	{
+		cerr << "Cannot write " << out << endl;
+		return 1;
+	}
+	cout << "Wrote " << lev.getWidth() << "x" << lev.getHeight() << " level to " << out
+		 << " in " << ChunkedLevel::DEFAULT_CHUNK_SIZE << "x" << ChunkedLevel::DEFAULT_CHUNK_SIZE
+		 << " chunks" << endl;
+	return 0;
+}
+
 int main(int argc, char* argv[])
 {
+    int tickMs = msPerTick;
+    BenchOptions bench;
+    HeadlessOptions headless;
+    string chunkLevel;
+    string compressTga;
+    string packAssets;
+    string archive;
+    ExportOptions exporting;
+    if (!parseOptions(argc, argv, tickMs, bench, headless, exporting, chunkLevel, compressTga, packAssets,
+                      archive))
+        return 1;
+    if (!chunkLevel.empty())
+        return convertLevel(chunkLevel);
+    if (!compressTga.empty())
+        return compressImage(compressTga);
+    if (!packAssets.empty())
+    {
+        string dir = packAssets.substr(0, packAssets.find(','));
+        string out = (packAssets.find(',') != string::npos ? packAssets.substr(packAssets.find(',') + 1)
+                                                           : dir + '/' + AssetArchive::DEFAULT_NAME);
+        return AssetArchive::pack(dir, out) ? 0 : 1;
+    }
+    if (!exporting.outDir.empty())
+        return exportReplays(argv[0], exporting.passOn, exporting.outDir, vector<string>(argv + 1, argv + argc),
+                             exporting.jobs);
+    if (bench.run)
+        return runSimulationBenchmarks(bench.filter, bench.ticks, bench.seed);
+
     string assetPath = assetDirectory;
     if (!assetPath.empty())
     {
@@ -45,10 +306,14 @@ int main(int argc, char* argv[])
         }
         assetPath += '/';
     }
+    if (archive.empty() && ifstream(assetPath + AssetArchive::DEFAULT_NAME))
+        archive = assetPath + AssetArchive::DEFAULT_NAME;
+    if (!archive.empty() && !Assets().open(archive))
+        return 1;
     {
 		const string someAsset = "pit.tga";
-		ifstream ifs(assetPath + someAsset);
-		if (!ifs)
+		AssetStream ifs;
+		if (!ifs.open(assetPath, someAsset))
 		{
 			cout << "Cannot find " << someAsset << " in ";
 			cout << (assetDirectory.empty() ? "current directory" : assetDirectory) << endl;
@@ -56,6 +321,17 @@ int main(int argc, char* argv[])
 		}
 	}
 
+	if (bench.render)
+		return RenderBenchmark::run(argc, argv, assetPath, bench.frames, bench.shotDir);
+
 	GameWorld* gw = createStudentWorld(assetPath);
-	Game().run(argc, argv, gw, "Marble Madness", msPerTick);
+	if (headless.run)
+	{
+		Game().runHeadless(gw, tickMs, headless.frameDir, headless.every, headless.ticks);
+		Trace().stop();
+		return 0;
+	}
+	Game().setMaxCatchUpTicks(maxCatchUpTicks);
+	Game().run(argc, argv, gw, "Marble Madness", tickMs);
+	Trace().stop();
 }